@@ -0,0 +1,207 @@
+#include <qp_wrappers/qps_reader.hpp>
+#include <qp_wrappers/sparse_problem.hpp>
+#include <qp_wrappers/types.hpp>
+
+#ifdef QPWRAPPERS_BENCHMARK_WITH_OSQP
+#include <qp_wrappers/osqp.hpp>
+#endif
+#ifdef QPWRAPPERS_BENCHMARK_WITH_QPOASES
+#include <qp_wrappers/qpoases.hpp>
+#endif
+#ifdef QPWRAPPERS_BENCHMARK_WITH_GUROBI
+#include <qp_wrappers/gurobi.hpp>
+#endif
+#ifdef QPWRAPPERS_BENCHMARK_WITH_CPLEX
+#include <qp_wrappers/cplex.hpp>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+    Solves every .QPS and .SIF file of a directory, e.g. the Maros-Meszaros
+    test set, with each compiled in engine and prints one line per problem
+    and engine with the status, setup and solve times, iterations, objective
+    and, if reference optima are given, the relative error of the objective.
+
+    usage: maros_meszaros <directory> [reference_optima]
+
+    reference_optima is a text file with a "NAME value" line per problem,
+    where NAME is the NAME of the QPS file or the file name without its
+    extension. Lines starting with # are skipped.
+*/
+
+using Problem = QPWrappers::SparseProblem<double>;
+using Vector = Problem::Vector;
+
+struct Summary {
+    std::size_t problems = 0;
+    std::size_t optimal = 0;
+    std::size_t accurate = 0;
+    double log_time_sum = 0;
+};
+
+std::map<std::string, double> read_reference_optima(const std::string& path) {
+    std::ifstream file(path);
+    if(!file) {
+        throw std::runtime_error(std::string("could not open ") + path);
+    }
+
+    std::map<std::string, double> optima;
+    std::string line;
+    while(std::getline(file, line)) {
+        std::istringstream line_stream(line);
+        std::string name;
+        double value;
+        if(line_stream >> name && name[0] != '#' && line_stream >> value) {
+            optima[name] = value;
+        }
+    }
+    return optima;
+}
+
+std::string upper_case(std::string name) {
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) {
+        return std::toupper(c);
+    });
+    return name;
+}
+
+template<typename Engine>
+void run(const std::string& engine_name, Engine& engine, const Problem& problem,
+         const QPWrappers::QPSInfo<double>& info, const double* reference,
+         Summary& summary) {
+    Vector result;
+    QPWrappers::OptReturnType status;
+    try {
+        status = engine.init(problem, result);
+    } catch(const std::exception& e) {
+        std::cout << info.name << '\t' << engine_name << "\texception: "
+                  << e.what() << std::endl;
+        summary.problems++;
+        return;
+    }
+
+    const QPWrappers::SolveStatistics& statistics = engine.statistics();
+    double total_time = statistics.setup_time + statistics.solve_time;
+
+    std::cout << info.name << '\t' << engine_name << '\t' << status
+              << '\t' << statistics.setup_time
+              << '\t' << statistics.solve_time
+              << '\t' << statistics.iterations;
+
+    summary.problems++;
+    if(status == QPWrappers::OptReturnType::Optimal) {
+        Vector Q_result = problem.Q().selfadjointView<Eigen::Upper>() * result;
+        double objective = 0.5 * result.dot(Q_result) + problem.c().dot(result)
+                           + info.objective_constant;
+        if(info.maximize) {
+            objective = -objective;
+        }
+        std::cout << '\t' << objective;
+
+        summary.optimal++;
+        // shifted by 1ms so that the mean is not dominated by tiny problems
+        summary.log_time_sum += std::log(total_time + 1e-3);
+        if(reference) {
+            double error = std::abs(objective - *reference)
+                           / std::max(1.0, std::abs(*reference));
+            std::cout << '\t' << error;
+            summary.accurate += error <= 1e-4;
+        }
+    }
+    std::cout << std::endl;
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <directory> [reference_optima]" << std::endl;
+        return 1;
+    }
+
+    std::map<std::string, double> reference_optima;
+    if(argc > 2) {
+        reference_optima = read_reference_optima(argv[2]);
+    }
+
+    std::vector<std::filesystem::path> files;
+    for(const auto& entry: std::filesystem::directory_iterator(argv[1])) {
+        std::string extension = upper_case(entry.path().extension().string());
+        if(entry.is_regular_file() && (extension == ".QPS" || extension == ".SIF")) {
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    std::map<std::string, Summary> summaries;
+    std::cout << std::setprecision(10)
+              << "problem\tengine\tstatus\tsetup_time\tsolve_time\titerations"
+                 "\tobjective\trelative_error" << std::endl;
+
+    for(const std::filesystem::path& path: files) {
+        Problem problem(0);
+        QPWrappers::QPSInfo<double> info;
+        try {
+            info = QPWrappers::read_qps(path.string(), problem);
+        } catch(const std::exception& e) {
+            std::cerr << path << ": " << e.what() << std::endl;
+            continue;
+        }
+        if(info.name.empty()) {
+            info.name = upper_case(path.stem().string());
+        }
+
+        const double* reference = nullptr;
+        auto it = reference_optima.find(info.name);
+        if(it == reference_optima.end()) {
+            it = reference_optima.find(upper_case(path.stem().string()));
+        }
+        if(it != reference_optima.end()) {
+            reference = &it->second;
+        }
+
+#ifdef QPWRAPPERS_BENCHMARK_WITH_OSQP
+        {
+            QPWrappers::OSQP::Engine<double> engine;
+            run("osqp", engine, problem, info, reference, summaries["osqp"]);
+        }
+#endif
+#ifdef QPWRAPPERS_BENCHMARK_WITH_QPOASES
+        {
+            QPWrappers::qpOASES::Engine<double> engine;
+            run("qpoases", engine, problem, info, reference, summaries["qpoases"]);
+        }
+#endif
+#ifdef QPWRAPPERS_BENCHMARK_WITH_GUROBI
+        {
+            QPWrappers::GUROBI::Engine<double> engine;
+            run("gurobi", engine, problem, info, reference, summaries["gurobi"]);
+        }
+#endif
+#ifdef QPWRAPPERS_BENCHMARK_WITH_CPLEX
+        {
+            QPWrappers::CPLEX::Engine<double> engine;
+            run("cplex", engine, problem, info, reference, summaries["cplex"]);
+        }
+#endif
+    }
+
+    std::cout << std::endl << "engine\tproblems\toptimal\taccurate\tgeometric_mean_time" << std::endl;
+    for(const auto& [engine_name, summary]: summaries) {
+        double mean_time = summary.optimal
+                           ? std::exp(summary.log_time_sum / summary.optimal) - 1e-3
+                           : 0.0;
+        std::cout << engine_name << '\t' << summary.problems << '\t' << summary.optimal
+                  << '\t' << summary.accurate << '\t' << mean_time << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+# Builds a second copy of third_party/osqp with DFLOAT ON as the imported
+# static library osqp_float, with its symbols prefixed by osqpf_ so that it
+# links next to the double osqp target. Its headers are installed under
+# osqp_float/ in QPWRAPPERS_OSQP_FLOAT_INCLUDE_DIR, see osqp.hpp for how they
+# are included. Renaming the symbols needs GNU nm and objcopy; without them
+# a warning is given and osqp_float is not defined.
+find_program(QPWRAPPERS_NM NAMES ${CMAKE_NM} nm)
+find_program(QPWRAPPERS_OBJCOPY NAMES ${CMAKE_OBJCOPY} objcopy)
+if(NOT QPWRAPPERS_NM OR NOT QPWRAPPERS_OBJCOPY)
+    message(WARNING "QPWRAPPERS_WITH_OSQP_FLOAT needs nm and objcopy, building without the single precision osqp")
+    return()
+endif()
+
+include(ExternalProject)
+
+set(osqp_float_prefix ${CMAKE_CURRENT_BINARY_DIR}/osqp_float)
+set(QPWRAPPERS_OSQP_FLOAT_INCLUDE_DIR ${osqp_float_prefix}/qpwrappers/include)
+set(QPWRAPPERS_OSQP_FLOAT_LIBRARY ${osqp_float_prefix}/qpwrappers/lib/${CMAKE_STATIC_LIBRARY_PREFIX}osqp_float${CMAKE_STATIC_LIBRARY_SUFFIX})
+
+# OSQP generates osqp_configure.h, which defines DFLOAT, into its source
+# tree, so the float build works on a copy of it.
+ExternalProject_Add(
+        osqp_float_build
+        PREFIX ${osqp_float_prefix}
+        DOWNLOAD_COMMAND ${CMAKE_COMMAND} -E copy_directory ${CMAKE_CURRENT_SOURCE_DIR}/third_party/osqp <SOURCE_DIR>
+        CMAKE_ARGS
+            -DCMAKE_C_COMPILER=${CMAKE_C_COMPILER}
+            -DCMAKE_BUILD_TYPE=${CMAKE_BUILD_TYPE}
+            -DCMAKE_INSTALL_PREFIX=<INSTALL_DIR>
+            -DCMAKE_INSTALL_LIBDIR=lib
+            -DCMAKE_POSITION_INDEPENDENT_CODE=ON
+            -DDFLOAT=ON
+            -DDLONG=OFF
+            -DUNITTESTS=OFF
+        BUILD_BYPRODUCTS ${QPWRAPPERS_OSQP_FLOAT_LIBRARY}
+)
+ExternalProject_Get_Property(osqp_float_build SOURCE_DIR INSTALL_DIR)
+ExternalProject_Add_Step(
+        osqp_float_build
+        prefix_symbols
+        COMMAND ${CMAKE_COMMAND}
+            -DLIBRARY=${INSTALL_DIR}/lib/${CMAKE_STATIC_LIBRARY_PREFIX}osqp${CMAKE_STATIC_LIBRARY_SUFFIX}
+            -DHEADERS=${SOURCE_DIR}/include
+            -DPREFIX=osqpf_
+            -DOUTPUT_LIBRARY=${QPWRAPPERS_OSQP_FLOAT_LIBRARY}
+            -DOUTPUT_HEADERS=${QPWRAPPERS_OSQP_FLOAT_INCLUDE_DIR}/osqp_float
+            -DNM=${QPWRAPPERS_NM}
+            -DOBJCOPY=${QPWRAPPERS_OBJCOPY}
+            -P ${CMAKE_CURRENT_LIST_DIR}/OSQPPrefixSymbols.cmake
+        DEPENDEES install
+        DEPENDS ${CMAKE_CURRENT_LIST_DIR}/OSQPPrefixSymbols.cmake
+)
+
+# the include directory of an imported target has to exist at configure time
+file(MAKE_DIRECTORY ${QPWRAPPERS_OSQP_FLOAT_INCLUDE_DIR})
+
+add_library(osqp_float STATIC IMPORTED GLOBAL)
+set_target_properties(
+        osqp_float
+        PROPERTIES
+        IMPORTED_LOCATION ${QPWRAPPERS_OSQP_FLOAT_LIBRARY}
+        INTERFACE_INCLUDE_DIRECTORIES ${QPWRAPPERS_OSQP_FLOAT_INCLUDE_DIR}
+        INTERFACE_COMPILE_DEFINITIONS QPWRAPPERS_WITH_OSQP_FLOAT
+)
+if(UNIX)
+    set_property(TARGET osqp_float PROPERTY INTERFACE_LINK_LIBRARIES m)
+endif()
+add_dependencies(osqp_float osqp_float_build)
@@ -0,0 +1,69 @@
+# cmake -DLIBRARY=<archive> -DHEADERS=<include directory> -DPREFIX=<prefix>
+#       -DOUTPUT_LIBRARY=<archive> -DOUTPUT_HEADERS=<directory>
+#       -DNM=<nm> -DOBJCOPY=<objcopy> -P OSQPPrefixSymbols.cmake
+#
+# Renames every global symbol defined in the OSQP archive LIBRARY to
+# PREFIX<symbol>, so that it can be linked next to another OSQP built with
+# a different c_float, and writes the renamed archive to OUTPUT_LIBRARY.
+#
+# The headers in HEADERS are copied to OUTPUT_HEADERS with their include
+# guards suffixed by _FLOAT, so that they can be included after the headers
+# of the other OSQP. symbols.h defines every renamed symbol to its new name
+# and undef_symbols.h undefines them again, along with DFLOAT.
+foreach(variable LIBRARY HEADERS PREFIX OUTPUT_LIBRARY OUTPUT_HEADERS NM OBJCOPY)
+    if(NOT DEFINED ${variable})
+        message(FATAL_ERROR "OSQPPrefixSymbols.cmake needs ${variable}")
+    endif()
+endforeach()
+
+execute_process(
+        COMMAND ${NM} -g --defined-only ${LIBRARY}
+        OUTPUT_VARIABLE nm_output
+        RESULT_VARIABLE nm_result
+)
+if(NOT nm_result EQUAL 0)
+    message(FATAL_ERROR "${NM} failed on ${LIBRARY}")
+endif()
+
+string(REGEX MATCHALL "[0-9a-fA-F]+ [A-Z] [A-Za-z_][A-Za-z0-9_]*" entries "${nm_output}")
+set(symbols)
+foreach(entry ${entries})
+    string(REGEX REPLACE "^[0-9a-fA-F]+ [A-Z] " "" symbol "${entry}")
+    list(APPEND symbols ${symbol})
+endforeach()
+list(REMOVE_DUPLICATES symbols)
+
+set(redefinitions "")
+set(defines "")
+set(undefines "#undef DFLOAT\n")
+foreach(symbol ${symbols})
+    string(APPEND redefinitions "${symbol} ${PREFIX}${symbol}\n")
+    string(APPEND defines "#define ${symbol} ${PREFIX}${symbol}\n")
+    string(APPEND undefines "#undef ${symbol}\n")
+endforeach()
+
+get_filename_component(output_dir ${OUTPUT_LIBRARY} DIRECTORY)
+file(MAKE_DIRECTORY ${output_dir} ${OUTPUT_HEADERS})
+file(WRITE ${output_dir}/redefine_symbols.txt "${redefinitions}")
+execute_process(
+        COMMAND ${OBJCOPY} --redefine-syms=${output_dir}/redefine_symbols.txt ${LIBRARY} ${OUTPUT_LIBRARY}
+        RESULT_VARIABLE objcopy_result
+)
+if(NOT objcopy_result EQUAL 0)
+    message(FATAL_ERROR "${OBJCOPY} failed on ${LIBRARY}")
+endif()
+
+file(WRITE ${OUTPUT_HEADERS}/symbols.h "${defines}")
+file(WRITE ${OUTPUT_HEADERS}/undef_symbols.h "${undefines}")
+
+file(GLOB headers ${HEADERS}/*.h)
+foreach(header ${headers})
+    file(READ ${header} content)
+    string(REGEX MATCH "#ifndef[ \t]+([A-Za-z0-9_]+)[ \t]*\r?\n[ \t]*#[ \t]*define[ \t]+([A-Za-z0-9_]+)" guard "${content}")
+    if(guard AND CMAKE_MATCH_1 STREQUAL CMAKE_MATCH_2)
+        set(name ${CMAKE_MATCH_1})
+        string(REGEX REPLACE "([ \t])${name}([ \t\r\n])" "\\1${name}_FLOAT\\2" content "${content}")
+    endif()
+    get_filename_component(header_name ${header} NAME)
+    file(WRITE ${OUTPUT_HEADERS}/${header_name} "${content}")
+endforeach()
@@ -0,0 +1,52 @@
+# qpwrappers_add_generated_solver(<target>
+#         GENERATOR <executable target or path>
+#         PREFIX <prefix>
+#         [ARGS <arguments>...]
+#         [DEPENDS <files>...])
+#
+# Runs the generator as
+#     <generator> <output directory> <prefix> <arguments>...
+# at build time, which is expected to write <prefix>.h and <prefix>.c with
+# QPWrappers::OSQP::CodeGenerator, and builds them into the static library
+# <target>. The output directory is added to the include directories of
+# <target>, so that users of the target can include <prefix>.h. The solver
+# is generated again when the generator or the files in DEPENDS change.
+function(qpwrappers_add_generated_solver target)
+    cmake_parse_arguments(QPWRAPPERS_CODEGEN "" "GENERATOR;PREFIX" "ARGS;DEPENDS" ${ARGN})
+
+    if(NOT QPWRAPPERS_CODEGEN_GENERATOR OR NOT QPWRAPPERS_CODEGEN_PREFIX)
+        message(FATAL_ERROR "qpwrappers_add_generated_solver needs GENERATOR and PREFIX")
+    endif()
+
+    set(output_dir ${CMAKE_CURRENT_BINARY_DIR}/${target})
+    set(outputs
+            ${output_dir}/${QPWRAPPERS_CODEGEN_PREFIX}.h
+            ${output_dir}/${QPWRAPPERS_CODEGEN_PREFIX}.c)
+
+    add_custom_command(
+            OUTPUT ${outputs}
+            COMMAND ${CMAKE_COMMAND} -E make_directory ${output_dir}
+            COMMAND ${QPWRAPPERS_CODEGEN_GENERATOR} ${output_dir} ${QPWRAPPERS_CODEGEN_PREFIX} ${QPWRAPPERS_CODEGEN_ARGS}
+            DEPENDS ${QPWRAPPERS_CODEGEN_GENERATOR} ${QPWRAPPERS_CODEGEN_DEPENDS}
+            COMMENT "Generating solver ${QPWRAPPERS_CODEGEN_PREFIX} for ${target}"
+            VERBATIM
+    )
+
+    add_library(
+            ${target}
+            STATIC
+            ${output_dir}/${QPWRAPPERS_CODEGEN_PREFIX}.c
+    )
+    target_include_directories(
+            ${target}
+            PUBLIC
+            ${output_dir}
+    )
+    if(UNIX)
+        target_link_libraries(
+                ${target}
+                PUBLIC
+                m
+        )
+    endif()
+endfunction()
@@ -0,0 +1,40 @@
+#include <qp_wrappers/binary_format.hpp>
+
+#include <iostream>
+#include <string>
+
+/*
+    Converts a problem read from standard input between the text format
+    and the binary format, and writes it to standard output.
+
+    usage: binary_format_convert to-binary [automatic|dense|sparse]
+           binary_format_convert to-text
+*/
+int main(int argc, char** argv) {
+    std::ios::sync_with_stdio(false);
+
+    std::string direction = argc > 1 ? argv[1] : "";
+    std::string layout_name = argc > 2 ? argv[2] : "automatic";
+
+    QPWrappers::BinaryLayout layout = QPWrappers::BinaryLayout::Automatic;
+    if(layout_name == "dense") {
+        layout = QPWrappers::BinaryLayout::Dense;
+    } else if(layout_name == "sparse") {
+        layout = QPWrappers::BinaryLayout::Sparse;
+    } else if(layout_name != "automatic") {
+        std::cerr << "unknown layout " << layout_name << std::endl;
+        return 1;
+    }
+
+    if(direction == "to-binary") {
+        QPWrappers::text_to_binary(std::cin, std::cout, layout);
+    } else if(direction == "to-text") {
+        QPWrappers::binary_to_text(std::cin, std::cout);
+    } else {
+        std::cerr << "usage: " << argv[0] << " to-binary [automatic|dense|sparse]" << std::endl
+                  << "       " << argv[0] << " to-text" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+#ifndef QPWRAPPERS_EXAMPLE_DEADLINE_HPP
+#define QPWRAPPERS_EXAMPLE_DEADLINE_HPP
+
+#include <qp_wrappers/problem.hpp>
+#include <qp_wrappers/types.hpp>
+
+#include <iostream>
+#include <limits>
+
+/*
+    Returns a problem made of copies copies of problem on the diagonal,
+    which has copies times as many variables and constraints.
+*/
+inline QPWrappers::Problem<double> replicate(const QPWrappers::Problem<double>& problem, int copies) {
+    using Index = QPWrappers::Problem<double>::Index;
+    Index n = problem.num_vars(), m = problem.num_constraints();
+
+    QPWrappers::Problem<double> result(n * copies);
+    result.reserve(m * copies);
+    for(int k = 0; k < copies; k++) {
+        result.add_Q_block(k * n, k * n, problem.Q());
+        result.add_c_block(k * n, problem.c());
+        for(Index i = 0; i < n; i++) {
+            result.set_var_limits(k * n + i, problem.lbx()(i), problem.ubx()(i));
+        }
+        for(Index i = 0; i < m; i++) {
+            QPWrappers::Problem<double>::RowVector coeff = QPWrappers::Problem<double>::RowVector::Zero(n * copies);
+            coeff.segment(k * n, n) = problem.A().row(i);
+            result.add_constraint(coeff, problem.lb()(i), problem.ub()(i));
+        }
+    }
+    return result;
+}
+
+/*
+    Solves problem with engine, whose time budget is already set, and checks
+    that the call overruns the budget by at most tolerance seconds and that
+    a TimeLimit status comes with the iterate the engine stopped at: a
+    result of the size of the problem with finite entries. Engines that
+    finish within the budget pass the second check as well. Returns false
+    if a check fails.
+*/
+template<typename Engine>
+bool check_time_limit(Engine& engine, const QPWrappers::Problem<double>& problem, double tolerance) {
+    QPWrappers::Problem<double>::Vector result = QPWrappers::Problem<double>::Vector::Constant(
+            problem.num_vars(), std::numeric_limits<double>::quiet_NaN());
+    QPWrappers::OptReturnType status = engine.init(problem, result);
+    std::cout << problem.num_vars() << " variables: " << status
+              << ", overrun: " << engine.statistics().overrun << " s" << std::endl;
+
+    bool in_time = engine.statistics().overrun <= tolerance;
+    if(!in_time) {
+        std::cout << "overrun above the tolerance of " << tolerance << " s" << std::endl;
+    }
+    if(status != QPWrappers::OptReturnType::TimeLimit) {
+        return in_time;
+    }
+
+    bool has_iterate = result.rows() == problem.num_vars() && result.allFinite();
+    if(has_iterate) {
+        std::cout << "iterate objective: " << problem.objective(result)
+                  << ", feasible: " << problem.verify(result, 1e-6) << std::endl;
+    } else {
+        std::cout << "TimeLimit without an iterate" << std::endl;
+    }
+    return in_time && has_iterate;
+}
+
+#endif
@@ -0,0 +1,26 @@
+#include <qp_wrappers/osqp_codegen.hpp>
+#include "codegen_mpc.hpp"
+
+#include <iostream>
+
+/*
+    Generates the solver of the double integrator MPC problems into the
+    directory given as the first argument, with the prefix given as the
+    second one.
+*/
+int main(int argc, char** argv) {
+    if(argc < 3) {
+        std::cerr << "usage: " << argv[0] << " <directory> <prefix>" << std::endl;
+        return 1;
+    }
+
+    QPWrappers::OSQP::CodegenSettings settings;
+    settings.eps_abs = 1e-5;
+    settings.eps_rel = 1e-5;
+
+    QPWrappers::OSQP::CodeGenerator<QPWrappers::Problem<double>> generator(mpc_problem(1, 0), settings);
+    generator.write(argv[1], argv[2]);
+
+    std::cout << "L nonzeros: " << generator.factor_nonzeros() << std::endl;
+    return 0;
+}
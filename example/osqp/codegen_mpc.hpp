@@ -0,0 +1,61 @@
+#ifndef QPWRAPPERS_EXAMPLE_CODEGEN_MPC_HPP
+#define QPWRAPPERS_EXAMPLE_CODEGEN_MPC_HPP
+
+#include <qp_wrappers/problem.hpp>
+
+/*
+    Model predictive control of a double integrator with position p,
+    velocity v and acceleration u over horizon steps of dt seconds, driving
+    p and v to 0 with |v| <= 2 and |u| <= 1. The variables are the states
+    (p, v) of steps 0 to horizon followed by the inputs of steps 0 to
+    horizon - 1. Constraints 0 and 1 fix the state of step 0 to the current
+    state, the rest are the dynamics.
+*/
+const int horizon = 20;
+const double dt = 0.1;
+
+inline QPWrappers::Problem<double> mpc_problem(double p, double v) {
+    const int states = 2 * (horizon + 1), n = states + horizon;
+    QPWrappers::Problem<double> problem(n);
+    problem.reserve(states);
+
+    QPWrappers::Problem<double>::Vector weights(n);
+    for(int k = 0; k <= horizon; k++) {
+        weights(2 * k) = 1;
+        weights(2 * k + 1) = 0.1;
+    }
+    weights.tail(horizon).setConstant(0.01);
+    problem.add_Q(weights.asDiagonal().toDenseMatrix());
+
+    QPWrappers::Problem<double>::RowVector row = QPWrappers::Problem<double>::RowVector::Zero(n);
+    row(0) = 1;
+    problem.add_constraint(row, p, p);
+    row.setZero();
+    row(1) = 1;
+    problem.add_constraint(row, v, v);
+
+    for(int k = 0; k < horizon; k++) {
+        // p' = p + dt v + dt^2 / 2 u, v' = v + dt u
+        row.setZero();
+        row(2 * (k + 1)) = 1;
+        row(2 * k) = -1;
+        row(2 * k + 1) = -dt;
+        row(states + k) = -dt * dt / 2;
+        problem.add_constraint(row, 0, 0);
+        row.setZero();
+        row(2 * (k + 1) + 1) = 1;
+        row(2 * k + 1) = -1;
+        row(states + k) = -dt;
+        problem.add_constraint(row, 0, 0);
+    }
+
+    for(int k = 0; k <= horizon; k++) {
+        problem.set_var_limits(2 * k + 1, -2, 2);
+    }
+    for(int k = 0; k < horizon; k++) {
+        problem.set_var_limits(states + k, -1, 1);
+    }
+    return problem;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#include "mpc_solver.h"
+#include "codegen_mpc.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+/*
+    Drives the double integrator from p = 5 to rest with the generated
+    solver. Each cycle only updates the limits fixing the current state.
+*/
+int main() {
+    QPWrappers::Problem<double> problem = mpc_problem(5, 0);
+    std::vector<double> lb(problem.lb().data(), problem.lb().data() + MPC_SOLVER_NUM_CONSTRAINTS);
+    std::vector<double> ub(problem.ub().data(), problem.ub().data() + MPC_SOLVER_NUM_CONSTRAINTS);
+
+    double p = 5, v = 0, max_time = 0;
+    for(int cycle = 0; cycle < 100; cycle++) {
+        auto start = std::chrono::steady_clock::now();
+        lb[0] = ub[0] = p;
+        lb[1] = ub[1] = v;
+        mpc_solver_update_limits(lb.data(), ub.data());
+        int status = mpc_solver_solve();
+        max_time = std::max(max_time, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+        if(status != MPC_SOLVER_SOLVED) {
+            std::cout << "cycle " << cycle << ": status " << status << std::endl;
+        }
+
+        double u = mpc_solver_solution()[2 * (horizon + 1)];
+        p += dt * v + dt * dt / 2 * u;
+        v += dt * u;
+    }
+
+    std::cout << "final state: p = " << p << ", v = " << v << std::endl;
+    std::cout << "max cycle time: " << max_time << " s" << std::endl;
+    return 0;
+}
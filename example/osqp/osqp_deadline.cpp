@@ -0,0 +1,55 @@
+#include <qp_wrappers/osqp.hpp>
+#include <qp_wrappers/problem.hpp>
+#include "../common/deadline.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+/*
+    Solves the problem read from standard input, e.g. the ex1 problem of
+    the general QP solver example, and a problem 10 times its size under the
+    time budget given in seconds as the first argument, 20 ms by default.
+    Exits with a failure if a next call overruns the budget by more than
+    the tolerance given as the second argument, 1 ms by default. The
+    overrun of the init call, which sets up the OSQP workspace, is only
+    reported.
+*/
+int main(int argc, char** argv) {
+    double budget = argc > 1 ? std::atof(argv[1]) : 0.02;
+    double tolerance = argc > 2 ? std::atof(argv[2]) : 0.001;
+
+    QPWrappers::Problem<double> problem(0);
+    std::cin >> problem;
+    problem.regularize_Q(1e-6);
+
+    bool held = true;
+    for(int copies : {1, 10}) {
+        QPWrappers::Problem<double> scaled = replicate(problem, copies);
+
+        QPWrappers::OSQP::Engine<double> osqpEngine;
+        osqpEngine.setFeasibilityTolerance(1e-8);
+        osqpEngine.setTimeBudget(budget);
+
+        QPWrappers::Problem<double>::Vector result;
+        QPWrappers::OptReturnType status = osqpEngine.init(scaled, result);
+        std::cout << scaled.num_vars() << " variables, " << scaled.num_constraints() << " constraints" << std::endl;
+        std::cout << "init: " << status << ", overrun: " << osqpEngine.statistics().overrun << " s" << std::endl;
+
+        int cnt = 100, time_limited = 0;
+        double max_overrun = 0;
+        for(int i = 0; i < cnt; i++) {
+            status = osqpEngine.next(scaled, result);
+            if(status == QPWrappers::OptReturnType::TimeLimit) {
+                time_limited++;
+            }
+            max_overrun = std::max(max_overrun, osqpEngine.statistics().overrun);
+        }
+
+        std::cout << "next: " << time_limited << "/" << cnt << " stopped by the budget, "
+                  << "max overrun: " << max_overrun << " s" << std::endl;
+        held = held && max_overrun <= tolerance;
+    }
+
+    return held ? 0 : 1;
+}
@@ -0,0 +1,45 @@
+#include <qp_wrappers/osqp.hpp>
+#include <qp_wrappers/problem.hpp>
+#include <qp_wrappers/problem_reader.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+/*
+    Solves every problem in a log of problems written one after the other
+    in the text format, read from the file given as the first argument or
+    from standard input. The next problem is parsed while the current one
+    is solved.
+*/
+int main(int argc, char** argv) {
+    std::unique_ptr<QPWrappers::ProblemReader<double>> reader;
+    if(argc > 1) {
+        reader.reset(new QPWrappers::ProblemReader<double>(std::string(argv[1])));
+    } else {
+        reader.reset(new QPWrappers::ProblemReader<double>(std::cin));
+    }
+
+    QPWrappers::OSQP::Engine<double> osqpEngine;
+    osqpEngine.setFeasibilityTolerance(1e-8);
+
+    QPWrappers::Problem<double> problem(0);
+    QPWrappers::Problem<double>::Vector result;
+
+    auto start = std::chrono::steady_clock::now();
+    std::size_t verified = 0;
+    while(reader->next(problem)) {
+        problem.regularize_Q(1e-6);
+        QPWrappers::OptReturnType status = osqpEngine.init(problem, result);
+        if(status == QPWrappers::OptReturnType::Optimal && problem.verify(result, 1e-6)) {
+            verified++;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::cout << "problems: " << reader->count() << std::endl;
+    std::cout << "verified: " << verified << std::endl;
+    std::cout << "duration: " << std::chrono::duration<double>(end - start).count() << std::endl;
+
+    return 0;
+}
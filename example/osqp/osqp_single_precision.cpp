@@ -0,0 +1,38 @@
+#include <qp_wrappers/osqp.hpp>
+#include <qp_wrappers/mixed_precision.hpp>
+#include <qp_wrappers/problem.hpp>
+
+#include <iostream>
+
+/*
+    Solves the problem read from standard input, e.g. the ex1 problem of
+    the general QP solver example, with the double and the float OSQP in the
+    same binary, and with the float OSQP refined to double accuracy.
+*/
+int main() {
+    QPWrappers::Problem<double> problem(0);
+    std::cin >> problem;
+    problem.regularize_Q(1e-6);
+    QPWrappers::Problem<float> float_problem = problem.cast<float>();
+
+    QPWrappers::OSQP::Engine<double> double_engine;
+    double_engine.setFeasibilityTolerance(1e-8);
+    QPWrappers::Problem<double>::Vector result;
+    QPWrappers::OptReturnType status = double_engine.init(problem, result);
+    std::cout << "double: " << status << ", objective: " << problem.objective(result)
+              << ", solve time: " << double_engine.statistics().solve_time << " s" << std::endl;
+
+    QPWrappers::OSQP::Engine<float> float_engine;
+    float_engine.setFeasibilityTolerance(1e-4f);
+    QPWrappers::Problem<float>::Vector float_result;
+    status = float_engine.init(float_problem, float_result);
+    std::cout << "float: " << status << ", objective: " << float_problem.objective(float_result)
+              << ", solve time: " << float_engine.statistics().solve_time << " s" << std::endl;
+
+    QPWrappers::MixedPrecision<QPWrappers::Problem<double>> refinement;
+    status = refinement.init(float_engine, problem, result);
+    std::cout << "float refined: " << status << ", objective: " << problem.objective(result)
+              << ", verification: " << problem.verify(result, 1e-8) << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,32 @@
+#include <qp_wrappers/qpoases.hpp>
+#include <qp_wrappers/problem.hpp>
+#include "../common/deadline.hpp"
+
+#include <cstdlib>
+
+/*
+    Solves the problem read from standard input, e.g. the ex1 problem of
+    the general QP solver example, and a problem 10 times its size under the
+    time budget given in seconds as the first argument, 0.1 ms by default,
+    and exits with a failure if a call overruns the budget by more than the
+    tolerance given as the second argument, 1 ms by default, or if a
+    TimeLimit status comes without an iterate.
+*/
+int main(int argc, char** argv) {
+    double budget = argc > 1 ? std::atof(argv[1]) : 1e-4;
+    double tolerance = argc > 2 ? std::atof(argv[2]) : 0.001;
+
+    QPWrappers::Problem<double> problem(0);
+    std::cin >> problem;
+    problem.regularize_Q(1e-6);
+
+    bool held = true;
+    for(int copies : {1, 10}) {
+        QPWrappers::qpOASES::Engine<double> qpoasesEngine;
+        qpoasesEngine.setPSDCheckEigenvalueTolerance(1e-6);
+        qpoasesEngine.setTimeBudget(budget);
+        held = check_time_limit(qpoasesEngine, replicate(problem, copies), tolerance) && held;
+    }
+
+    return held ? 0 : 1;
+}
@@ -0,0 +1,32 @@
+#include <qp_wrappers/problem.hpp>
+#include <qp_wrappers/soft_conversion.hpp>
+
+#include <iostream>
+#include <limits>
+
+/*
+    Converts a fixed size problem with soft constraints, which gives a
+    dynamic size problem with the slack variables after the original ones.
+*/
+int main() {
+    using FixedProblem = QPWrappers::Problem<double, 2, 3>;
+
+    FixedProblem problem(2);
+    problem.add_Q(FixedProblem::Matrix::Identity());
+
+    // x0 + x1 = 1 as a penalty, x0 >= 2 with a slack, x1 <= 0.5 kept hard
+    problem.add_constraint(FixedProblem::RowVector(1, 1), 1, 1, true, 10);
+    problem.add_constraint(FixedProblem::RowVector(1, 0), 2,
+                           std::numeric_limits<double>::max(), true, 5);
+    problem.add_constraint(FixedProblem::RowVector(0, 1),
+                           std::numeric_limits<double>::lowest(), 0.5);
+
+    QPWrappers::Problem<double> soft = problem.convert_to_soft();
+    std::cout << soft.num_vars() << " variables, " << soft.num_constraints() << " constraints" << std::endl;
+
+    QPWrappers::SoftConversion<FixedProblem> conversion(problem);
+    std::cout << "slack of x0 >= 2: variable " << conversion.lower_slack_index(1)
+              << ", row " << conversion.lower_row(1) << std::endl;
+
+    return soft.num_vars() == conversion.problem().num_vars() ? 0 : 1;
+}
@@ -0,0 +1,821 @@
+#ifndef QPWRAPPERS_BINARY_FORMAT_HPP
+#define QPWRAPPERS_BINARY_FORMAT_HPP
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "problem.hpp"
+#include "sparse_problem.hpp"
+
+
+namespace QPWrappers {
+
+/*
+    Binary problem format, version 1.
+
+    A file starts with a BinaryHeader, followed by the sections listed in
+    BinarySection. Every section starts at an offset, from the start of the
+    file, that is a multiple of binary_alignment, so that the sections of a
+    memory mapped file can be used in place. All numbers are little-endian,
+    scalars are float or double as given by scalar_size, and indices are
+    64 bit signed integers.
+
+    Q is stored either dense, as the full symmetric num_vars x num_vars
+    matrix in row major order in Q_values, or sparse, as its upper triangle
+    in compressed sparse column format in Q_values, Q_outer, and Q_inner.
+    A is stored either dense, in row major order in A_values, or sparse in
+    compressed sparse column format. Unused sections have offset 0.
+    soft_convertible holds one byte per constraint.
+*/
+constexpr std::uint32_t binary_format_version = 1;
+constexpr std::uint64_t binary_alignment = 64;
+constexpr char binary_magic[8] = {'Q', 'P', 'W', 'P', 'R', 'O', 'B', '\0'};
+
+struct BinarySection {
+    enum : int {
+        Q_values,
+        Q_outer,
+        Q_inner,
+        A_values,
+        A_outer,
+        A_inner,
+        c_values,
+        lb_values,
+        ub_values,
+        lbx_values,
+        ubx_values,
+        soft_weight_values,
+        soft_convertible_values,
+        count
+    };
+};
+
+enum BinaryFlags : std::uint32_t {
+    binary_Q_sparse = 1,
+    binary_A_sparse = 2
+};
+
+struct BinaryHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t scalar_size;
+    std::uint32_t flags;
+    std::uint32_t reserved;
+    std::int64_t num_vars;
+    std::int64_t num_constraints;
+    std::int64_t Q_nonzeros;
+    std::int64_t A_nonzeros;
+    std::uint64_t offsets[BinarySection::count];
+    std::uint64_t file_size;
+};
+
+/*
+    How Q and A are stored when a problem is written. Automatic picks, for
+    each of them, whichever takes less space.
+*/
+enum class BinaryLayout {
+    Automatic,
+    Dense,
+    Sparse
+};
+
+namespace binary_format_detail {
+
+inline bool is_host_little_endian() {
+    const std::uint16_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+inline void check_host_endianness() {
+    if(!is_host_little_endian()) {
+        throw std::runtime_error(
+            "binary problem format is only supported on little-endian hosts"
+        );
+    }
+}
+
+inline std::uint64_t align(std::uint64_t offset) {
+    return (offset + binary_alignment - 1) / binary_alignment * binary_alignment;
+}
+
+template<typename T>
+using FileSparseMatrix = Eigen::SparseMatrix<T, Eigen::ColMajor, std::int64_t>;
+
+/*
+    Section contents to be written, and where they go in the file.
+*/
+struct SectionData {
+    const void* data = nullptr;
+    std::uint64_t bytes = 0;
+};
+
+inline void write_sections(std::ostream& os, BinaryHeader& header,
+                           const SectionData (&sections)[BinarySection::count]) {
+    std::uint64_t offset = align(sizeof(BinaryHeader));
+    for(int s = 0; s < BinarySection::count; s++) {
+        if(sections[s].data == nullptr) {
+            header.offsets[s] = 0;
+            continue;
+        }
+        header.offsets[s] = offset;
+        offset = align(offset + sections[s].bytes);
+    }
+    header.file_size = offset;
+
+    static const char padding[binary_alignment] = {};
+    os.write(reinterpret_cast<const char*>(&header), sizeof(BinaryHeader));
+    std::uint64_t written = sizeof(BinaryHeader);
+    for(int s = 0; s < BinarySection::count; s++) {
+        if(sections[s].data == nullptr) {
+            continue;
+        }
+        os.write(padding, header.offsets[s] - written);
+        os.write(static_cast<const char*>(sections[s].data), sections[s].bytes);
+        written = header.offsets[s] + sections[s].bytes;
+    }
+    os.write(padding, header.file_size - written);
+
+    if(!os) {
+        throw std::runtime_error("could not write binary problem");
+    }
+}
+
+template<typename T>
+bool prefer_sparse(BinaryLayout layout, Eigen::Index rows, Eigen::Index cols,
+                   Eigen::Index nonzeros) {
+    if(layout != BinaryLayout::Automatic) {
+        return layout == BinaryLayout::Sparse;
+    }
+    std::uint64_t sparse_bytes = nonzeros * (sizeof(T) + sizeof(std::int64_t))
+                                 + (cols + 1) * sizeof(std::int64_t);
+    std::uint64_t dense_bytes = rows * cols * sizeof(T);
+    return sparse_bytes < dense_bytes;
+}
+
+/*
+    Writes the parts of the problem that are stored the same way for
+    Problem and SparseProblem, given Q and A in both forms.
+*/
+template<typename T, typename ProblemType>
+void write_problem(std::ostream& os, const ProblemType& problem,
+                   const T* dense_Q, const FileSparseMatrix<T>* sparse_Q,
+                   const T* dense_A, const FileSparseMatrix<T>* sparse_A) {
+    check_host_endianness();
+
+    std::int64_t n = problem.num_vars(), m = problem.num_constraints();
+
+    BinaryHeader header = {};
+    std::memcpy(header.magic, binary_magic, sizeof(binary_magic));
+    header.version = binary_format_version;
+    header.scalar_size = sizeof(T);
+    header.num_vars = n;
+    header.num_constraints = m;
+
+    SectionData sections[BinarySection::count];
+    if(sparse_Q != nullptr) {
+        header.flags |= binary_Q_sparse;
+        header.Q_nonzeros = sparse_Q->nonZeros();
+        sections[BinarySection::Q_values] = {sparse_Q->valuePtr(), header.Q_nonzeros * sizeof(T)};
+        sections[BinarySection::Q_outer] = {sparse_Q->outerIndexPtr(), (n + 1) * sizeof(std::int64_t)};
+        sections[BinarySection::Q_inner] = {sparse_Q->innerIndexPtr(), header.Q_nonzeros * sizeof(std::int64_t)};
+    } else {
+        header.Q_nonzeros = n * n;
+        sections[BinarySection::Q_values] = {dense_Q, n * n * sizeof(T)};
+    }
+
+    if(sparse_A != nullptr) {
+        header.flags |= binary_A_sparse;
+        header.A_nonzeros = sparse_A->nonZeros();
+        sections[BinarySection::A_values] = {sparse_A->valuePtr(), header.A_nonzeros * sizeof(T)};
+        sections[BinarySection::A_outer] = {sparse_A->outerIndexPtr(), (n + 1) * sizeof(std::int64_t)};
+        sections[BinarySection::A_inner] = {sparse_A->innerIndexPtr(), header.A_nonzeros * sizeof(std::int64_t)};
+    } else {
+        header.A_nonzeros = m * n;
+        sections[BinarySection::A_values] = {dense_A, m * n * sizeof(T)};
+    }
+
+    typename ProblemType::Vector lb = problem.lb(), ub = problem.ub();
+    typename ProblemType::Vector soft_weights(m);
+    std::vector<std::uint8_t> soft_convertible(m);
+    for(std::int64_t i = 0; i < m; i++) {
+        soft_weights(i) = problem.soft_weight(i);
+        soft_convertible[i] = problem.is_soft_convertible(i);
+    }
+
+    sections[BinarySection::c_values] = {problem.c().data(), n * sizeof(T)};
+    sections[BinarySection::lb_values] = {lb.data(), m * sizeof(T)};
+    sections[BinarySection::ub_values] = {ub.data(), m * sizeof(T)};
+    sections[BinarySection::lbx_values] = {problem.lbx().data(), n * sizeof(T)};
+    sections[BinarySection::ubx_values] = {problem.ubx().data(), n * sizeof(T)};
+    sections[BinarySection::soft_weight_values] = {soft_weights.data(), m * sizeof(T)};
+    sections[BinarySection::soft_convertible_values] = {soft_convertible.data(), m * sizeof(std::uint8_t)};
+
+    write_sections(os, header, sections);
+}
+
+/*
+    Reads the header of a binary problem to find its scalar size.
+*/
+inline std::uint32_t peek_scalar_size(const void* data, std::size_t size) {
+    if(size < sizeof(BinaryHeader)) {
+        throw std::domain_error("binary problem is shorter than its header");
+    }
+    BinaryHeader header;
+    std::memcpy(&header, data, sizeof(BinaryHeader));
+    return header.scalar_size;
+}
+
+/*
+    Reads the whole stream into memory aligned to binary_alignment.
+*/
+inline std::vector<std::uint64_t> read_aligned(std::istream& is, std::size_t& size) {
+    std::vector<std::uint64_t> buffer(align(sizeof(BinaryHeader)) / sizeof(std::uint64_t));
+    is.read(reinterpret_cast<char*>(buffer.data()), sizeof(BinaryHeader));
+    if(!is) {
+        throw std::domain_error("could not read the header of binary problem");
+    }
+
+    BinaryHeader header;
+    std::memcpy(&header, buffer.data(), sizeof(BinaryHeader));
+    if(std::memcmp(header.magic, binary_magic, sizeof(binary_magic)) != 0) {
+        throw std::domain_error("stream does not hold a binary problem");
+    }
+
+    size = header.file_size;
+    buffer.resize((size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t));
+    is.read(reinterpret_cast<char*>(buffer.data()) + sizeof(BinaryHeader),
+            size - sizeof(BinaryHeader));
+    if(!is) {
+        throw std::domain_error("binary problem is truncated");
+    }
+    return buffer;
+}
+
+}
+
+/**
+    Read only view of a problem in the binary format. Nothing is copied,
+    the accessors map the sections of the given memory in place, which
+    must stay valid and unchanged while the view is used.
+    T must match the scalar type the problem is written with.
+*/
+template<typename T>
+class ProblemView {
+    public:
+        using Matrix = typename Problem<T>::Matrix;
+        using Vector = typename Problem<T>::Vector;
+        using Index = Eigen::Index;
+        using SparseMatrix = binary_format_detail::FileSparseMatrix<T>;
+        using MatrixMap = Eigen::Map<const Matrix>;
+        using VectorMap = Eigen::Map<const Vector>;
+        using SparseMatrixMap = Eigen::Map<const SparseMatrix>;
+
+        ProblemView(const void* data, std::size_t size):
+                base(static_cast<const char*>(data)) {
+            binary_format_detail::check_host_endianness();
+
+            if(size < sizeof(BinaryHeader)) {
+                throw std::domain_error("binary problem is shorter than its header");
+            }
+            std::memcpy(&header, base, sizeof(BinaryHeader));
+            validate(size);
+        }
+
+        inline Index num_vars() const {
+            return header.num_vars;
+        }
+
+        inline Index num_constraints() const {
+            return header.num_constraints;
+        }
+
+        inline bool is_Q_sparse() const {
+            return header.flags & binary_Q_sparse;
+        }
+
+        inline bool is_A_sparse() const {
+            return header.flags & binary_A_sparse;
+        }
+
+        /*
+            Q of a problem whose Q is stored dense.
+        */
+        MatrixMap Q() const {
+            if(is_Q_sparse()) {
+                throw std::domain_error("Q is stored sparse, use Q_upper_sparse");
+            }
+            return MatrixMap(section<T>(BinarySection::Q_values), num_vars(), num_vars());
+        }
+
+        /*
+            Upper triangle of Q of a problem whose Q is stored sparse.
+        */
+        SparseMatrixMap Q_upper_sparse() const {
+            if(!is_Q_sparse()) {
+                throw std::domain_error("Q is stored dense, use Q");
+            }
+            return SparseMatrixMap(num_vars(), num_vars(), header.Q_nonzeros,
+                                   section<std::int64_t>(BinarySection::Q_outer),
+                                   section<std::int64_t>(BinarySection::Q_inner),
+                                   section<T>(BinarySection::Q_values));
+        }
+
+        /*
+            A of a problem whose A is stored dense.
+        */
+        MatrixMap A() const {
+            if(is_A_sparse()) {
+                throw std::domain_error("A is stored sparse, use A_sparse");
+            }
+            return MatrixMap(section<T>(BinarySection::A_values), num_constraints(), num_vars());
+        }
+
+        /*
+            A of a problem whose A is stored sparse.
+        */
+        SparseMatrixMap A_sparse() const {
+            if(!is_A_sparse()) {
+                throw std::domain_error("A is stored dense, use A");
+            }
+            return SparseMatrixMap(num_constraints(), num_vars(), header.A_nonzeros,
+                                   section<std::int64_t>(BinarySection::A_outer),
+                                   section<std::int64_t>(BinarySection::A_inner),
+                                   section<T>(BinarySection::A_values));
+        }
+
+        VectorMap c() const {
+            return VectorMap(section<T>(BinarySection::c_values), num_vars());
+        }
+
+        VectorMap lb() const {
+            return VectorMap(section<T>(BinarySection::lb_values), num_constraints());
+        }
+
+        VectorMap ub() const {
+            return VectorMap(section<T>(BinarySection::ub_values), num_constraints());
+        }
+
+        VectorMap lbx() const {
+            return VectorMap(section<T>(BinarySection::lbx_values), num_vars());
+        }
+
+        VectorMap ubx() const {
+            return VectorMap(section<T>(BinarySection::ubx_values), num_vars());
+        }
+
+        inline bool is_soft_convertible(Index constraint_idx) const {
+            return section<std::uint8_t>(BinarySection::soft_convertible_values)[constraint_idx] != 0;
+        }
+
+        inline T soft_weight(Index constraint_idx) const {
+            return section<T>(BinarySection::soft_weight_values)[constraint_idx];
+        }
+
+        /*
+            Copies the viewed problem into a Problem.
+        */
+        Problem<T> to_problem() const {
+            Problem<T> problem(num_vars());
+
+            if(is_Q_sparse()) {
+                Matrix Q_full = Matrix::Zero(num_vars(), num_vars());
+                SparseMatrixMap Q_upper = Q_upper_sparse();
+                for(Index k = 0; k < Q_upper.outerSize(); k++) {
+                    for(typename SparseMatrixMap::InnerIterator it(Q_upper, k); it; ++it) {
+                        Q_full(it.row(), it.col()) = Q_full(it.col(), it.row()) = it.value();
+                    }
+                }
+                problem.add_Q(Q_full);
+            } else {
+                problem.add_Q(Q());
+            }
+
+            problem.reserve(num_constraints());
+            if(is_A_sparse()) {
+                problem.add_constraints(Matrix(A_sparse().toDense()), lb(), ub());
+            } else {
+                problem.add_constraints(A(), lb(), ub());
+            }
+            set_soft_constraints(problem);
+
+            problem.add_c(c());
+            for(Index i = 0; i < num_vars(); i++) {
+                problem.set_var_limits(i, lbx()(i), ubx()(i));
+            }
+
+            return problem;
+        }
+
+        /*
+            Copies the viewed problem into a SparseProblem.
+        */
+        SparseProblem<T> to_sparse_problem() const {
+            using ProblemMatrix = typename SparseProblem<T>::SparseMatrix;
+
+            SparseProblem<T> problem(num_vars());
+
+            if(is_Q_sparse()) {
+                // entries of the upper triangle are split between Q(i, j) and
+                // Q(j, i) by add_Q_entry, hence the full value is given twice.
+                SparseMatrixMap Q_upper = Q_upper_sparse();
+                for(Index k = 0; k < Q_upper.outerSize(); k++) {
+                    for(typename SparseMatrixMap::InnerIterator it(Q_upper, k); it; ++it) {
+                        problem.add_Q_entry(it.row(), it.col(),
+                                            it.row() == it.col() ? it.value() : 2 * it.value());
+                    }
+                }
+            } else {
+                problem.add_Q(Q());
+            }
+
+            problem.reserve(num_constraints());
+            if(is_A_sparse()) {
+                problem.add_constraints(ProblemMatrix(A_sparse()), lb(), ub());
+            } else {
+                problem.add_constraints(ProblemMatrix(A().sparseView()), lb(), ub());
+            }
+            set_soft_constraints(problem);
+
+            problem.add_c(c());
+            for(Index i = 0; i < num_vars(); i++) {
+                problem.set_var_limits(i, lbx()(i), ubx()(i));
+            }
+
+            return problem;
+        }
+
+    private:
+        const char* base;
+        BinaryHeader header;
+
+        template<typename ProblemType>
+        void set_soft_constraints(ProblemType& problem) const {
+            for(Index i = 0; i < num_constraints(); i++) {
+                problem.set_soft_convertible(i, is_soft_convertible(i), soft_weight(i));
+            }
+        }
+
+        template<typename S>
+        const S* section(int s) const {
+            return reinterpret_cast<const S*>(base + header.offsets[s]);
+        }
+
+        void validate(std::size_t size) const {
+            if(std::memcmp(header.magic, binary_magic, sizeof(binary_magic)) != 0) {
+                throw std::domain_error("memory does not hold a binary problem");
+            }
+
+            if(header.version != binary_format_version) {
+                throw std::domain_error(
+                    std::string("unsupported binary problem version ")
+                    + std::to_string(header.version)
+                );
+            }
+
+            if(header.scalar_size != sizeof(T)) {
+                throw std::domain_error(
+                    std::string("binary problem has scalars of size ")
+                    + std::to_string(header.scalar_size)
+                    + std::string(" but the view has scalars of size ")
+                    + std::to_string(sizeof(T))
+                );
+            }
+
+            // every count bounds the size of a section of scalars, so counts that
+            // do not fit in the file are rejected before the sizes are computed
+            std::uint64_t max_count = header.file_size / sizeof(T);
+            auto fits = [max_count](std::int64_t count) {
+                return count >= 0 && static_cast<std::uint64_t>(count) <= max_count;
+            };
+            if(header.file_size > size || !fits(header.num_vars) || !fits(header.num_constraints)
+               || !fits(header.Q_nonzeros) || !fits(header.A_nonzeros)) {
+                throw std::domain_error("binary problem is truncated or corrupt");
+            }
+
+            // true if count is rows * cols, without computing the product
+            auto is_product = [](std::int64_t count, std::int64_t rows, std::int64_t cols) {
+                return cols == 0 ? count == 0 : count % cols == 0 && count / cols == rows;
+            };
+            std::uint64_t n = header.num_vars, m = header.num_constraints;
+            std::uint64_t index_size = sizeof(std::int64_t);
+            std::uint64_t expected[BinarySection::count] = {};
+            expected[BinarySection::Q_values] = header.Q_nonzeros * sizeof(T);
+            expected[BinarySection::A_values] = header.A_nonzeros * sizeof(T);
+            if(is_Q_sparse()) {
+                expected[BinarySection::Q_outer] = (n + 1) * index_size;
+                expected[BinarySection::Q_inner] = header.Q_nonzeros * index_size;
+            } else if(!is_product(header.Q_nonzeros, header.num_vars, header.num_vars)) {
+                throw std::domain_error("dense Q section of binary problem has wrong size");
+            }
+            if(is_A_sparse()) {
+                expected[BinarySection::A_outer] = (n + 1) * index_size;
+                expected[BinarySection::A_inner] = header.A_nonzeros * index_size;
+            } else if(!is_product(header.A_nonzeros, header.num_constraints, header.num_vars)) {
+                throw std::domain_error("dense A section of binary problem has wrong size");
+            }
+            expected[BinarySection::c_values] = n * sizeof(T);
+            expected[BinarySection::lbx_values] = n * sizeof(T);
+            expected[BinarySection::ubx_values] = n * sizeof(T);
+            expected[BinarySection::lb_values] = m * sizeof(T);
+            expected[BinarySection::ub_values] = m * sizeof(T);
+            expected[BinarySection::soft_weight_values] = m * sizeof(T);
+            expected[BinarySection::soft_convertible_values] = m;
+
+            for(int s = 0; s < BinarySection::count; s++) {
+                bool used = expected[s] > 0
+                            || (s == BinarySection::Q_outer && is_Q_sparse())
+                            || (s == BinarySection::A_outer && is_A_sparse());
+                if(!used) {
+                    continue;
+                }
+                if(header.offsets[s] % binary_alignment != 0
+                   || header.offsets[s] < sizeof(BinaryHeader)
+                   || header.offsets[s] > header.file_size
+                   || expected[s] > header.file_size - header.offsets[s]) {
+                    throw std::domain_error(
+                        std::string("section ")
+                        + std::to_string(s)
+                        + std::string(" of binary problem is out of bounds or misaligned")
+                    );
+                }
+            }
+
+            check_outer(BinarySection::Q_outer, is_Q_sparse(), header.Q_nonzeros);
+            check_outer(BinarySection::A_outer, is_A_sparse(), header.A_nonzeros);
+            check_inner(BinarySection::Q_outer, BinarySection::Q_inner, is_Q_sparse(), true,
+                        header.num_vars);
+            check_inner(BinarySection::A_outer, BinarySection::A_inner, is_A_sparse(), false,
+                        header.num_constraints);
+        }
+
+        /*
+            Column pointers must be nondecreasing from 0 to the number of
+            nonzeros, so that sparse maps never index out of their sections.
+        */
+        void check_outer(int s, bool used, std::int64_t nonzeros) const {
+            if(!used) {
+                return;
+            }
+            const std::int64_t* outer = section<std::int64_t>(s);
+            bool valid = outer[0] == 0 && outer[header.num_vars] == nonzeros;
+            for(Index k = 0; valid && k < header.num_vars; k++) {
+                valid = outer[k] <= outer[k + 1];
+            }
+            if(!valid) {
+                throw std::domain_error("column pointers of binary problem are corrupt");
+            }
+        }
+
+        /*
+            Row indices must be increasing within each column and below
+            rows, and at most the column for the upper triangle of Q, so
+            that copying the matrices never indexes out of them. Expects
+            valid column pointers.
+        */
+        void check_inner(int outer_section, int inner_section, bool used, bool upper,
+                         std::int64_t rows) const {
+            if(!used) {
+                return;
+            }
+            const std::int64_t* outer = section<std::int64_t>(outer_section);
+            const std::int64_t* inner = section<std::int64_t>(inner_section);
+            for(std::int64_t col = 0; col < header.num_vars; col++) {
+                std::int64_t limit = upper ? std::min(col + 1, rows) : rows;
+                std::int64_t previous = -1;
+                for(std::int64_t k = outer[col]; k < outer[col + 1]; k++) {
+                    if(inner[k] <= previous || inner[k] >= limit) {
+                        throw std::domain_error("row indices of binary problem are corrupt");
+                    }
+                    previous = inner[k];
+                }
+            }
+        }
+};
+
+namespace binary_format_detail {
+
+/*
+    Read only memory mapping of a whole file, unmapped on destruction.
+*/
+class MappedFile {
+    public:
+        explicit MappedFile(const std::string& path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if(fd < 0) {
+                throw std::runtime_error(std::string("could not open ") + path);
+            }
+
+            struct stat status;
+            if(::fstat(fd, &status) != 0) {
+                ::close(fd);
+                throw std::runtime_error(std::string("could not stat ") + path);
+            }
+
+            mapped_size = status.st_size;
+            void* data = mapped_size == 0
+                         ? MAP_FAILED
+                         : ::mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if(data == MAP_FAILED) {
+                throw std::runtime_error(std::string("could not map ") + path);
+            }
+            mapped_data = data;
+        }
+
+        MappedFile(MappedFile&& other) noexcept:
+                mapped_data(other.mapped_data),
+                mapped_size(other.mapped_size) {
+            other.mapped_data = nullptr;
+            other.mapped_size = 0;
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile& operator=(MappedFile&&) = delete;
+
+        ~MappedFile() {
+            if(mapped_data != nullptr) {
+                ::munmap(mapped_data, mapped_size);
+            }
+        }
+
+    protected:
+        void* mapped_data = nullptr;
+        std::size_t mapped_size = 0;
+};
+
+}
+
+/**
+    Problem in the binary format mapped from a file. The mapping is kept
+    as long as the object lives, and is read through the ProblemView
+    accessors without copying.
+*/
+template<typename T>
+class MappedProblem : private binary_format_detail::MappedFile, public ProblemView<T> {
+    public:
+        explicit MappedProblem(const std::string& path):
+                binary_format_detail::MappedFile(path),
+                ProblemView<T>(mapped_data, mapped_size) {}
+};
+
+/*
+    Writes the problem in the binary format.
+*/
+template<typename T>
+void write_binary(std::ostream& os, const Problem<T>& problem,
+                  BinaryLayout layout = BinaryLayout::Automatic) {
+    using namespace binary_format_detail;
+    using Index = Eigen::Index;
+
+    Index n = problem.num_vars(), m = problem.num_constraints();
+
+    const auto& Q_upper = problem.Q_upper();
+    Index Q_nonzeros = 0;
+    for(Index i = 0; i < n; i++) {
+        for(Index j = i; j < n; j++) {
+            Q_nonzeros += Q_upper(i, j) != T(0);
+        }
+    }
+
+    FileSparseMatrix<T> sparse_Q, sparse_A;
+    bool is_Q_sparse = prefer_sparse<T>(layout, n, n, Q_nonzeros);
+    if(is_Q_sparse) {
+        sparse_Q.resize(n, n);
+        sparse_Q.reserve(Q_nonzeros);
+        for(Index j = 0; j < n; j++) {
+            sparse_Q.startVec(j);
+            for(Index i = 0; i <= j; i++) {
+                if(Q_upper(i, j) != T(0)) {
+                    sparse_Q.insertBack(i, j) = Q_upper(i, j);
+                }
+            }
+        }
+        sparse_Q.finalize();
+    }
+
+    bool is_A_sparse = false;
+    if(layout != BinaryLayout::Dense) {
+        sparse_A = problem.A().sparseView();
+        sparse_A.makeCompressed();
+        is_A_sparse = prefer_sparse<T>(layout, m, n, sparse_A.nonZeros());
+    }
+
+    // the dense sections are written from Q() and the row major A
+    // storage of the problem, which are laid out as the format requires.
+    write_problem(os, problem,
+                  is_Q_sparse ? nullptr : problem.Q().data(),
+                  is_Q_sparse ? &sparse_Q : nullptr,
+                  is_A_sparse ? nullptr : problem.A().data(),
+                  is_A_sparse ? &sparse_A : nullptr);
+}
+
+/*
+    Sparse version of write_binary.
+*/
+template<typename T>
+void write_binary(std::ostream& os, const SparseProblem<T>& problem,
+                  BinaryLayout layout = BinaryLayout::Automatic) {
+    using namespace binary_format_detail;
+    using Matrix = typename Problem<T>::Matrix;
+    using Index = Eigen::Index;
+
+    Index n = problem.num_vars(), m = problem.num_constraints();
+
+    FileSparseMatrix<T> sparse_Q = problem.Q();
+    FileSparseMatrix<T> sparse_A = problem.A();
+    sparse_Q.makeCompressed();
+    sparse_A.makeCompressed();
+
+    bool is_Q_sparse = prefer_sparse<T>(layout, n, n, sparse_Q.nonZeros());
+    bool is_A_sparse = prefer_sparse<T>(layout, m, n, sparse_A.nonZeros());
+
+    Matrix dense_Q, dense_A;
+    if(!is_Q_sparse) {
+        dense_Q = Matrix::Zero(n, n);
+        for(Index k = 0; k < sparse_Q.outerSize(); k++) {
+            for(typename FileSparseMatrix<T>::InnerIterator it(sparse_Q, k); it; ++it) {
+                dense_Q(it.row(), it.col()) = dense_Q(it.col(), it.row()) = it.value();
+            }
+        }
+    }
+    if(!is_A_sparse) {
+        dense_A = sparse_A.toDense();
+    }
+
+    write_problem(os, problem,
+                  is_Q_sparse ? nullptr : dense_Q.data(),
+                  is_Q_sparse ? &sparse_Q : nullptr,
+                  is_A_sparse ? nullptr : dense_A.data(),
+                  is_A_sparse ? &sparse_A : nullptr);
+}
+
+/*
+    Reads a problem in the binary format. Problems written with a
+    different scalar type are converted to T.
+*/
+template<typename T>
+void read_binary(std::istream& is, Problem<T>& problem) {
+    using namespace binary_format_detail;
+
+    std::size_t size;
+    std::vector<std::uint64_t> buffer = read_aligned(is, size);
+    if(peek_scalar_size(buffer.data(), size) == sizeof(float)) {
+        problem = ProblemView<float>(buffer.data(), size).to_problem().template cast<T>();
+    } else {
+        problem = ProblemView<double>(buffer.data(), size).to_problem().template cast<T>();
+    }
+}
+
+/*
+    Sparse version of read_binary.
+*/
+template<typename T>
+void read_binary(std::istream& is, SparseProblem<T>& problem) {
+    using namespace binary_format_detail;
+
+    std::size_t size;
+    std::vector<std::uint64_t> buffer = read_aligned(is, size);
+    if(peek_scalar_size(buffer.data(), size) == sizeof(float)) {
+        problem = ProblemView<float>(buffer.data(), size).to_sparse_problem().template cast<T>();
+    } else {
+        problem = ProblemView<double>(buffer.data(), size).to_sparse_problem().template cast<T>();
+    }
+}
+
+/*
+    Converts a problem in the text format of operator<< to the binary format.
+*/
+template<typename T = double>
+void text_to_binary(std::istream& text, std::ostream& binary,
+                    BinaryLayout layout = BinaryLayout::Automatic) {
+    Problem<T> problem(0);
+    text >> problem;
+    write_binary(binary, problem, layout);
+}
+
+/*
+    Converts a problem in the binary format to the text format of operator<<.
+*/
+template<typename T = double>
+void binary_to_text(std::istream& binary, std::ostream& text) {
+    Problem<T> problem(0);
+    read_binary(binary, problem);
+    text << problem;
+}
+
+}
+
+#endif
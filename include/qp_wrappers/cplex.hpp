@@ -2,6 +2,7 @@
 #define QPWRAPPERS_CPLEX_HPP
 
 #include "problem.hpp"
+#include "sparse_problem.hpp"
 #include "types.hpp"
 #include <ilcplex/ilocplex.h>
 #include <iostream>
@@ -36,6 +37,16 @@ namespace QPWrappers {
                     feasibility_tolerance = tolerance;
                 }
 
+                /*
+                    Time budget of each init or next call in seconds, 0 for no
+                    budget. The time left after building the model is given to
+                    CPLEX as its TimeLimit. A solve that runs out of it returns
+                    OptReturnType::TimeLimit with the incumbent.
+                */
+                void setTimeBudget(double seconds) {
+                    budget.set(seconds);
+                }
+
                 // /*
                 //     By how much are the eigenvalues of the Q matrix are allowed be below 0 during PSD check?
                 // */
@@ -47,7 +58,64 @@ namespace QPWrappers {
                     Solve the first intance of the set of problems.
                     Load solution result to result.
                 */
-                OptReturnType init(const Problem<T>& problem, typename Problem<T>::Vector& result) {
+                template<int NumVars, int MaxConstraints>
+                OptReturnType init(const Problem<T, NumVars, MaxConstraints>& problem, typename Problem<T>::Vector& result) {
+                    return solve(problem, result);
+                }
+
+                /*
+                    Sparse version of init. Only the nonzero entries of Q and A
+                    are added to the model.
+                */
+                OptReturnType init(const SparseProblem<T>& problem, typename Problem<T>::Vector& result) {
+                    return solve(problem, result);
+                }
+
+                /*
+                    Solve the next problem of the set of problems.
+                */
+                template<int NumVars, int MaxConstraints>
+                OptReturnType next(const Problem<T, NumVars, MaxConstraints>& problem, typename Problem<T>::Vector& result) {
+                    return init(problem, result);
+                }
+
+                /*
+                    Sparse version of next.
+                */
+                OptReturnType next(const SparseProblem<T>& problem, typename Problem<T>::Vector& result) {
+                    return init(problem, result);
+                }
+
+                /*
+                    Solve the next problem of the set of problems with the given initial guess.
+                    Since there is no concept of feeding initial guess in CPLEX, we simply call init.
+                */
+                template<int NumVars, int MaxConstraints>
+                OptReturnType next(const Problem<T, NumVars, MaxConstraints>& problem, typename Problem<T>::Vector& result, const typename Problem<T>::Vector& initial_guess) {
+                    return init(problem, result);
+                }
+
+                /*
+                    Sparse version of next with the given initial guess.
+                */
+                OptReturnType next(const SparseProblem<T>& problem, typename Problem<T>::Vector& result, const typename Problem<T>::Vector& initial_guess) {
+                    return init(problem, result);
+                }
+
+                /*
+                    Statistics of the last init or next call.
+                */
+                const SolveStatistics& statistics() const {
+                    return last_statistics;
+                }
+
+            private:
+
+                template<typename ProblemType>
+                OptReturnType solve(const ProblemType& problem, typename Problem<T>::Vector& result) {
+                    last_statistics = SolveStatistics();
+                    SolveClock::time_point setup_start = SolveClock::now();
+
                     IloEnv env;
                     env.setOut(env.getNullStream());
 
@@ -58,21 +126,11 @@ namespace QPWrappers {
                         variables.add(var);
                     }
 
-                    for(int i = 0; i < problem.num_constraints(); i++) {
-                        IloExpr expr(env);
-                        for(int j = 0; j < problem.num_vars(); j++) {
-                            expr += problem.A()(i, j) * variables[j];
-                        }
-                        IloRange range(env, problem.lb()(i), expr, problem.ub()(i));
-                        model.add(range);
-                    }
+                    add_constraints(env, model, variables, problem);
 
-                    IloExpr quadratic_cost(env);
+                    IloExpr quadratic_cost = quadratic_objective(env, variables, problem);
                     IloExpr linear_cost(env);
                     for(int i = 0; i < problem.num_vars(); i++) {
-                        for(int j = 0; j < problem.num_vars(); j++) {
-                            quadratic_cost += variables[i] * variables[j] * problem.Q()(i, j) * 0.5;
-                        }
                         linear_cost += variables[i] * problem.c()(i);
                     }
 
@@ -91,11 +149,27 @@ namespace QPWrappers {
                         cplex.setParam(IloCplex::Param::OptimalityTarget, CPX_OPTIMALITYTARGET_FIRSTORDER);
                     }
 
+                    if(budget.active()) {
+                        cplex.setParam(IloCplex::Param::TimeLimit, budget.remaining(seconds_since(setup_start)));
+                    }
+
+                    last_statistics.setup_time = seconds_since(setup_start);
+
+                    SolveClock::time_point solve_start = SolveClock::now();
                     cplex.solve();
+                    last_statistics.solve_time = seconds_since(solve_start);
+                    last_statistics.iterations = cplex.getNiterations() + cplex.getNbarrierIterations();
+                    budget.record(last_statistics, setup_start);
 
                     auto status = cplex.getStatus();
 
-                    if(status == IloAlgorithm::Status::Unknown) {
+                    // a solve stopped by the time limit is Feasible if it has
+                    // an incumbent and Unknown otherwise.
+                    if(status == IloAlgorithm::Status::Feasible && cplex.getCplexStatus() == IloCplex::AbortTimeLim) {
+                        loadResult(env, cplex, variables, result);
+                        env.end();
+                        return OptReturnType::TimeLimit;
+                    } else if(status == IloAlgorithm::Status::Unknown) {
                         env.end();
                         return OptReturnType::Unknown;
                     } else if(status == IloAlgorithm::Status::Feasible) {
@@ -125,25 +199,78 @@ namespace QPWrappers {
                     return OptReturnType::Unknown;
                 }
 
+                template<int NumVars, int MaxConstraints>
+                void add_constraints(IloEnv& env, IloModel& model, const IloNumVarArray& variables, const Problem<T, NumVars, MaxConstraints>& problem) {
+                    for(int i = 0; i < problem.num_constraints(); i++) {
+                        IloExpr expr(env);
+                        for(int j = 0; j < problem.num_vars(); j++) {
+                            expr += problem.A()(i, j) * variables[j];
+                        }
+                        IloRange range(env, problem.lb()(i), expr, problem.ub()(i));
+                        model.add(range);
+                    }
+                }
+
                 /*
-                    Solve the next problem of the set of problems.
+                    Rows are assembled by a single pass over the columns of A.
                 */
-                OptReturnType next(const Problem<T>& problem, typename Problem<T>::Vector& result) {
-                    return init(problem, result);
+                void add_constraints(IloEnv& env, IloModel& model, const IloNumVarArray& variables, const SparseProblem<T>& problem) {
+                    const auto& A = problem.A();
+                    IloExprArray exprs(env, problem.num_constraints());
+                    for(int i = 0; i < problem.num_constraints(); i++) {
+                        exprs[i] = IloExpr(env);
+                    }
+                    for(int j = 0; j < A.outerSize(); j++) {
+                        for(typename SparseProblem<T>::SparseMatrix::InnerIterator it(A, j); it; ++it) {
+                            exprs[it.row()] += it.value() * variables[j];
+                        }
+                    }
+
+                    for(int i = 0; i < problem.num_constraints(); i++) {
+                        IloRange range(env, problem.lb()(i), exprs[i], problem.ub()(i));
+                        model.add(range);
+                    }
                 }
 
                 /*
-                    Solve the next problem of the set of problems with the given initial guess.
-                    Since there is no concept of feeding initial guess in CPLEX, we simply call init.
+                    Off-diagonal entries of the upper triangle appear twice in Q,
+                    which cancels the 1/2 of the objective.
                 */
-                OptReturnType next(const Problem<T>& problem, typename Problem<T>::Vector& result, const typename Problem<T>::Vector& initial_guess) {
-                    return init(problem, result);
+                template<int NumVars, int MaxConstraints>
+                IloExpr quadratic_objective(IloEnv& env, const IloNumVarArray& variables, const Problem<T, NumVars, MaxConstraints>& problem) {
+                    const auto& Q = problem.Q_upper();
+                    IloExpr quadratic_cost(env);
+                    for(int i = 0; i < problem.num_vars(); i++) {
+                        quadratic_cost += variables[i] * variables[i] * Q(i, i) * 0.5;
+                        for(int j = i + 1; j < problem.num_vars(); j++) {
+                            if(Q(i, j) != T(0)) {
+                                quadratic_cost += variables[i] * variables[j] * Q(i, j);
+                            }
+                        }
+                    }
+                    return quadratic_cost;
+                }
+
+                /*
+                    Sparse version of quadratic_objective.
+                */
+                IloExpr quadratic_objective(IloEnv& env, const IloNumVarArray& variables, const SparseProblem<T>& problem) {
+                    const auto& Q = problem.Q();
+                    IloExpr quadratic_cost(env);
+                    for(int j = 0; j < Q.outerSize(); j++) {
+                        for(typename SparseProblem<T>::SparseMatrix::InnerIterator it(Q, j); it; ++it) {
+                            T coeff = it.row() == j ? it.value() / 2 : it.value();
+                            quadratic_cost += variables[it.row()] * variables[j] * coeff;
+                        }
+                    }
+                    return quadratic_cost;
                 }
 
-            private:
 
                 T feasibility_tolerance;
                 // T psd_tolerance;
+                SolveStatistics last_statistics;
+                TimeBudget budget;
 
                 /*
                     Load solution result to the result.
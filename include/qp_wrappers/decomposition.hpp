@@ -0,0 +1,450 @@
+#ifndef QPWRAPPERS_DECOMPOSITION_HPP
+#define QPWRAPPERS_DECOMPOSITION_HPP
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "problem.hpp"
+#include "types.hpp"
+
+
+namespace QPWrappers {
+
+template<typename T>
+class SparseProblem;
+
+namespace decomposition_detail {
+
+/*
+    Union find over variables with union by size and path halving.
+*/
+class VariableSets {
+    public:
+        explicit VariableSets(Eigen::Index count): parent(count), size(count, 1) {
+            std::iota(parent.begin(), parent.end(), Eigen::Index(0));
+        }
+
+        Eigen::Index find(Eigen::Index i) {
+            while(parent[i] != i) {
+                parent[i] = parent[parent[i]];
+                i = parent[i];
+            }
+            return i;
+        }
+
+        void unite(Eigen::Index i, Eigen::Index j) {
+            i = find(i);
+            j = find(j);
+            if(i == j) {
+                return;
+            }
+            if(size[i] < size[j]) {
+                std::swap(i, j);
+            }
+            parent[j] = i;
+            size[i] += size[j];
+        }
+
+    private:
+        std::vector<Eigen::Index> parent, size;
+};
+
+/*
+    Ranks statuses so that the status of a decomposed solve is the worst
+    status of its subproblems.
+*/
+inline int severity(OptReturnType status) {
+    switch(status) {
+        case OptReturnType::Optimal:
+            return 0;
+        case OptReturnType::Feasible:
+            return 1;
+        case OptReturnType::TimeLimit:
+            return 2;
+        case OptReturnType::Unknown:
+            return 3;
+        case OptReturnType::Error:
+            return 4;
+        case OptReturnType::InfeasibleOrUnbounded:
+            return 5;
+        case OptReturnType::Unbounded:
+            return 6;
+        case OptReturnType::Infeasible:
+            return 7;
+    }
+    return 3;
+}
+
+}
+
+/**
+    Splits a Problem or SparseProblem into independent subproblems, one per
+    connected component of the graph where variables are linked by the
+    nonzero off-diagonal entries of Q and by sharing a constraint, and
+    solves them in parallel.
+
+    Components with fewer than min_subproblem_vars variables are packed
+    together, so that many tiny components do not each pay the setup cost
+    of an engine. Constraints without nonzero coefficients belong to no
+    subproblem, they only make the problem infeasible if violated by 0.
+    Subproblems are built once at construction; construct a new
+    Decomposition when the problem changes.
+*/
+template<typename ProblemType>
+class Decomposition {
+    public:
+        using T = typename ProblemType::Scalar;
+        using Index = Eigen::Index;
+        using Vector = typename Problem<T>::Vector;
+
+        explicit Decomposition(const ProblemType& problem, Index min_subproblem_vars = 1):
+                num_vars(problem.num_vars()) {
+            split(problem, min_subproblem_vars);
+        }
+
+        Index num_subproblems() const {
+            return subproblems.size();
+        }
+
+        const ProblemType& subproblem(Index k) const {
+            return subproblems[k].problem;
+        }
+
+        /*
+            Original indices of the variables of subproblem k, in the order
+            they appear in it.
+        */
+        const std::vector<Index>& variables(Index k) const {
+            return subproblems[k].variables;
+        }
+
+        /*
+            Original indices of the constraints of subproblem k, in the
+            order they appear in it.
+        */
+        const std::vector<Index>& constraints(Index k) const {
+            return subproblems[k].constraints;
+        }
+
+        /*
+            Status of subproblem k in the last solve.
+        */
+        OptReturnType status(Index k) const {
+            return subproblems[k].status;
+        }
+
+        /*
+            Solves every subproblem with a default constructed Engine per
+            thread. Returns Optimal if all subproblems are solved optimally,
+            and the worst status among them otherwise. The combined solution
+            is written to result if that status is Optimal, Feasible or
+            TimeLimit. num_threads = 0 uses one thread per hardware thread.
+        */
+        template<typename Engine>
+        OptReturnType solve(Vector& result, unsigned num_threads = 0) {
+            return solve<Engine>(result, [](Engine&) {}, num_threads);
+        }
+
+        /*
+            Same as solve, but configure(engine) is called on the engine of
+            each thread before it is used, e.g. to set tolerances.
+        */
+        template<typename Engine, typename Configure,
+                 typename = std::enable_if_t<std::is_invocable<Configure&, Engine&>::value>>
+        OptReturnType solve(Vector& result, Configure configure, unsigned num_threads = 0) {
+            if(has_infeasible_empty_row) {
+                return OptReturnType::Infeasible;
+            }
+
+            if(num_threads == 0) {
+                num_threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            num_threads = std::min<unsigned>(num_threads, subproblems.size());
+
+            std::atomic<std::size_t> next_subproblem(0);
+            std::vector<std::exception_ptr> errors(num_threads);
+            auto work = [&](unsigned thread_idx) {
+                try {
+                    Engine engine;
+                    configure(engine);
+                    std::size_t i;
+                    while((i = next_subproblem++) < solve_order.size()) {
+                        Subproblem& subproblem = subproblems[solve_order[i]];
+                        subproblem.status = engine.init(subproblem.problem, subproblem.result);
+                    }
+                } catch(...) {
+                    errors[thread_idx] = std::current_exception();
+                }
+            };
+
+            std::vector<std::thread> workers;
+            for(unsigned t = 1; t < num_threads; t++) {
+                workers.emplace_back(work, t);
+            }
+            if(num_threads > 0) {
+                work(0);
+            }
+            for(std::thread& worker: workers) {
+                worker.join();
+            }
+            for(const std::exception_ptr& error: errors) {
+                if(error) {
+                    std::rethrow_exception(error);
+                }
+            }
+
+            OptReturnType status = OptReturnType::Optimal;
+            for(const Subproblem& subproblem: subproblems) {
+                if(decomposition_detail::severity(subproblem.status)
+                   > decomposition_detail::severity(status)) {
+                    status = subproblem.status;
+                }
+            }
+
+            // every subproblem has a solution if the worst status has one
+            if(status == OptReturnType::Optimal || status == OptReturnType::Feasible
+               || status == OptReturnType::TimeLimit) {
+                result.resize(num_vars);
+                for(const Subproblem& subproblem: subproblems) {
+                    for(std::size_t i = 0; i < subproblem.variables.size(); i++) {
+                        result(subproblem.variables[i]) = subproblem.result(i);
+                    }
+                }
+            }
+
+            return status;
+        }
+
+    private:
+        struct Subproblem {
+            Subproblem(Index vars, Index constraints): problem(vars, constraints) {}
+
+            ProblemType problem;
+            std::vector<Index> variables, constraints;
+            Vector result;
+            OptReturnType status = OptReturnType::Unknown;
+        };
+
+        Index num_vars;
+        std::vector<Subproblem> subproblems;
+        // subproblem indices from the largest to the smallest, so that the
+        // largest ones do not start last.
+        std::vector<Index> solve_order;
+        bool has_infeasible_empty_row = false;
+
+        void split(const ProblemType& problem, Index min_subproblem_vars) {
+            Index n = problem.num_vars(), m = problem.num_constraints();
+            decomposition_detail::VariableSets sets(n);
+
+            // first variable of each constraint, -1 if it has none
+            std::vector<Index> row_variable(m, -1);
+            link(problem, sets, row_variable);
+
+            // components are numbered in the order of their first variable,
+            // and packed until they have min_subproblem_vars variables.
+            std::vector<Index> component(n, -1), subproblem_of(n);
+            std::vector<Index> variable_count, constraint_count;
+            for(Index i = 0; i < n; i++) {
+                Index root = sets.find(i);
+                if(component[root] < 0) {
+                    if(variable_count.empty() || variable_count.back() >= min_subproblem_vars) {
+                        variable_count.push_back(0);
+                    }
+                    component[root] = variable_count.size() - 1;
+                }
+                subproblem_of[i] = component[root];
+                variable_count[subproblem_of[i]]++;
+            }
+
+            constraint_count.assign(variable_count.size(), 0);
+            for(Index r = 0; r < m; r++) {
+                if(row_variable[r] >= 0) {
+                    constraint_count[subproblem_of[row_variable[r]]]++;
+                } else if(problem.lb()(r) > T(0) || problem.ub()(r) < T(0)) {
+                    has_infeasible_empty_row = true;
+                }
+            }
+
+            subproblems.reserve(variable_count.size());
+            for(std::size_t k = 0; k < variable_count.size(); k++) {
+                subproblems.emplace_back(variable_count[k], constraint_count[k]);
+                subproblems[k].variables.reserve(variable_count[k]);
+                subproblems[k].constraints.reserve(constraint_count[k]);
+            }
+
+            // local index of each variable and constraint in its subproblem
+            std::vector<Index> local_variable(n), local_constraint(m, -1);
+            for(Index i = 0; i < n; i++) {
+                std::vector<Index>& variables = subproblems[subproblem_of[i]].variables;
+                local_variable[i] = variables.size();
+                variables.push_back(i);
+            }
+            for(Index r = 0; r < m; r++) {
+                if(row_variable[r] >= 0) {
+                    std::vector<Index>& constraints = subproblems[subproblem_of[row_variable[r]]].constraints;
+                    local_constraint[r] = constraints.size();
+                    constraints.push_back(r);
+                }
+            }
+
+            for(Subproblem& subproblem: subproblems) {
+                for(std::size_t a = 0; a < subproblem.variables.size(); a++) {
+                    Index i = subproblem.variables[a];
+                    subproblem.problem.set_var_limits(a, problem.lbx()(i), problem.ubx()(i));
+                }
+                Vector c(subproblem.variables.size());
+                for(std::size_t a = 0; a < subproblem.variables.size(); a++) {
+                    c(a) = problem.c()(subproblem.variables[a]);
+                }
+                subproblem.problem.add_c(c);
+            }
+
+            assemble(problem, subproblem_of, local_variable, local_constraint);
+
+            solve_order.resize(subproblems.size());
+            std::iota(solve_order.begin(), solve_order.end(), Index(0));
+            std::stable_sort(solve_order.begin(), solve_order.end(), [this](Index a, Index b) {
+                return subproblems[a].variables.size() + subproblems[a].constraints.size()
+                       > subproblems[b].variables.size() + subproblems[b].constraints.size();
+            });
+        }
+
+        template<typename S>
+        static void link(const Problem<S>& problem, decomposition_detail::VariableSets& sets,
+                         std::vector<Index>& row_variable) {
+            const auto& Q = problem.Q_upper();
+            for(Index i = 0; i < problem.num_vars(); i++) {
+                for(Index j = i + 1; j < problem.num_vars(); j++) {
+                    if(Q(i, j) != S(0)) {
+                        sets.unite(i, j);
+                    }
+                }
+            }
+
+            auto A = problem.A();
+            for(Index r = 0; r < problem.num_constraints(); r++) {
+                for(Index j = 0; j < problem.num_vars(); j++) {
+                    if(A(r, j) == S(0)) {
+                        continue;
+                    }
+                    if(row_variable[r] < 0) {
+                        row_variable[r] = j;
+                    } else {
+                        sets.unite(row_variable[r], j);
+                    }
+                }
+            }
+        }
+
+        template<typename S>
+        static void link(const SparseProblem<S>& problem, decomposition_detail::VariableSets& sets,
+                         std::vector<Index>& row_variable) {
+            const auto& Q = problem.Q();
+            for(Index j = 0; j < Q.outerSize(); j++) {
+                for(typename SparseProblem<S>::SparseMatrix::InnerIterator it(Q, j); it; ++it) {
+                    if(it.row() != j && it.value() != S(0)) {
+                        sets.unite(it.row(), j);
+                    }
+                }
+            }
+
+            const auto& A = problem.A();
+            for(Index j = 0; j < A.outerSize(); j++) {
+                for(typename SparseProblem<S>::SparseMatrix::InnerIterator it(A, j); it; ++it) {
+                    if(it.value() == S(0)) {
+                        continue;
+                    }
+                    if(row_variable[it.row()] < 0) {
+                        row_variable[it.row()] = j;
+                    } else {
+                        sets.unite(row_variable[it.row()], j);
+                    }
+                }
+            }
+        }
+
+        /*
+            Copies Q and the constraints of problem to the subproblems. Both
+            ends of a nonzero off-diagonal Q entry, and all variables of a
+            constraint, are in the same subproblem by construction.
+        */
+        template<typename S>
+        void assemble(const Problem<S>& problem, const std::vector<Index>&,
+                      const std::vector<Index>&, const std::vector<Index>&) {
+            using Matrix = typename Problem<S>::Matrix;
+            using RowVector = typename Problem<S>::RowVector;
+
+            const Matrix& Q = problem.Q();
+            for(Subproblem& subproblem: subproblems) {
+                const std::vector<Index>& variables = subproblem.variables;
+                Index size = variables.size();
+                Matrix Q_sub(size, size);
+                for(Index a = 0; a < size; a++) {
+                    for(Index b = 0; b < size; b++) {
+                        Q_sub(a, b) = Q(variables[a], variables[b]);
+                    }
+                }
+                subproblem.problem.add_Q(Q_sub);
+
+                RowVector coeff(size);
+                for(std::size_t k = 0; k < subproblem.constraints.size(); k++) {
+                    Index r = subproblem.constraints[k];
+                    for(Index a = 0; a < size; a++) {
+                        coeff(a) = problem.A()(r, variables[a]);
+                    }
+                    subproblem.problem.set_constraint(k, coeff, problem.lb()(r), problem.ub()(r),
+                                                      problem.is_soft_convertible(r),
+                                                      problem.soft_weight(r));
+                }
+            }
+        }
+
+        template<typename S>
+        void assemble(const SparseProblem<S>& problem, const std::vector<Index>& subproblem_of,
+                      const std::vector<Index>& local_variable,
+                      const std::vector<Index>& local_constraint) {
+            const auto& Q = problem.Q();
+            for(Index j = 0; j < Q.outerSize(); j++) {
+                for(typename SparseProblem<S>::SparseMatrix::InnerIterator it(Q, j); it; ++it) {
+                    if(it.value() == S(0)) {
+                        continue;
+                    }
+                    // add_Q_entry splits off-diagonal values between Q(i, j)
+                    // and Q(j, i), while Q holds the upper triangle entry.
+                    S value = it.row() == j ? it.value() : 2 * it.value();
+                    subproblems[subproblem_of[j]].problem.add_Q_entry(
+                        local_variable[it.row()], local_variable[j], value);
+                }
+            }
+
+            const auto& A = problem.A();
+            for(Index j = 0; j < A.outerSize(); j++) {
+                for(typename SparseProblem<S>::SparseMatrix::InnerIterator it(A, j); it; ++it) {
+                    if(it.value() == S(0)) {
+                        continue;
+                    }
+                    subproblems[subproblem_of[j]].problem.add_constraint_entry(
+                        local_constraint[it.row()], local_variable[j], it.value());
+                }
+            }
+
+            for(Subproblem& subproblem: subproblems) {
+                for(std::size_t k = 0; k < subproblem.constraints.size(); k++) {
+                    Index r = subproblem.constraints[k];
+                    subproblem.problem.set_constraint_limits(k, problem.lb()(r), problem.ub()(r));
+                    subproblem.problem.set_soft_convertible(k, problem.is_soft_convertible(r),
+                                                            problem.soft_weight(r));
+                }
+            }
+        }
+};
+
+}
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef QPWRAPPERS_EIGENVALUE_ESTIMATION_HPP
+#define QPWRAPPERS_EIGENVALUE_ESTIMATION_HPP
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <Eigen/Eigenvalues>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+
+namespace QPWrappers {
+
+/*
+    How the minimum eigenvalue of a symmetric matrix is computed.
+    Exact uses a full eigenvalue decomposition, Lanczos runs a
+    Lanczos iteration that only needs matrix vector products, and
+    Gershgorin uses the Gershgorin circle theorem.
+*/
+enum class EigenvalueEstimation {
+    Exact,
+    Lanczos,
+    Gershgorin
+};
+
+/*
+    Estimate of the minimum eigenvalue of a symmetric matrix.
+*/
+template<typename T>
+struct EigenvalueEstimate {
+    // estimate of the minimum eigenvalue
+    T value = 0;
+
+    // the minimum eigenvalue is believed to be at least lower_bound.
+    // It is exact for Exact and Gershgorin estimates. For Lanczos
+    // estimates it is value - residual, bounded below by the
+    // Gershgorin bound, which holds when the iteration has found
+    // the lowest part of the spectrum.
+    T lower_bound = 0;
+
+    // distance from value within which there is guaranteed to be an
+    // eigenvalue. 0 for Exact estimates.
+    T residual = 0;
+
+    // number of matrix vector products used
+    Eigen::Index iterations = 0;
+
+    bool converged = true;
+};
+
+/*
+    Gershgorin lower bound on the eigenvalues of the symmetric matrix
+    whose upper triangle, diagonal included, is given.
+*/
+template<typename Derived>
+typename Derived::Scalar gershgorin_lower_bound(const Eigen::MatrixBase<Derived>& upper) {
+    using T = typename Derived::Scalar;
+    using Index = Eigen::Index;
+
+    Index n = upper.rows();
+    if(n == 0) {
+        return std::numeric_limits<T>::max();
+    }
+
+    Eigen::Matrix<T, Eigen::Dynamic, 1> radius = Eigen::Matrix<T, Eigen::Dynamic, 1>::Zero(n);
+    for(Index i = 0; i < n; i++) {
+        for(Index j = i + 1; j < n; j++) {
+            T entry = std::abs(upper(i, j));
+            radius(i) += entry;
+            radius(j) += entry;
+        }
+    }
+
+    return (upper.diagonal() - radius).minCoeff();
+}
+
+/*
+    Sparse version of gershgorin_lower_bound. Runs in O(nnz).
+*/
+template<typename T, int Options, typename StorageIndex>
+T gershgorin_lower_bound(const Eigen::SparseMatrix<T, Options, StorageIndex>& upper) {
+    using Index = Eigen::Index;
+    using SparseMatrix = Eigen::SparseMatrix<T, Options, StorageIndex>;
+
+    Index n = upper.rows();
+    if(n == 0) {
+        return std::numeric_limits<T>::max();
+    }
+
+    Eigen::Matrix<T, Eigen::Dynamic, 1> center = Eigen::Matrix<T, Eigen::Dynamic, 1>::Zero(n);
+    Eigen::Matrix<T, Eigen::Dynamic, 1> radius = Eigen::Matrix<T, Eigen::Dynamic, 1>::Zero(n);
+    for(Index k = 0; k < upper.outerSize(); k++) {
+        for(typename SparseMatrix::InnerIterator it(upper, k); it; ++it) {
+            if(it.row() == it.col()) {
+                center(it.row()) += it.value();
+            } else if(it.row() < it.col()) {
+                radius(it.row()) += std::abs(it.value());
+                radius(it.col()) += std::abs(it.value());
+            }
+        }
+    }
+
+    return (center - radius).minCoeff();
+}
+
+/*
+    Estimates the minimum eigenvalue of the symmetric matrix whose upper
+    triangle, diagonal included, is given, by a Lanczos iteration with full
+    reorthogonalization. Works on dense and sparse matrices, touching the
+    matrix only through matrix vector products. Stops after max_iterations
+    products or once the residual of the smallest Ritz value drops below
+    tolerance * max(1, |value|).
+*/
+template<typename MatrixType>
+EigenvalueEstimate<typename MatrixType::Scalar> lanczos_min_eigenvalue(
+        const MatrixType& upper,
+        Eigen::Index max_iterations = 100,
+        typename MatrixType::Scalar tolerance = std::sqrt(std::numeric_limits<typename MatrixType::Scalar>::epsilon())) {
+    using T = typename MatrixType::Scalar;
+    using Index = Eigen::Index;
+    using Vector = Eigen::Matrix<T, Eigen::Dynamic, 1>;
+    using Basis = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+
+    EigenvalueEstimate<T> estimate;
+    Index n = upper.rows();
+    if(n == 0) {
+        estimate.value = estimate.lower_bound = std::numeric_limits<T>::max();
+        return estimate;
+    }
+
+    Index steps = std::min(max_iterations, n);
+    Basis basis(n, steps);
+    Vector alpha(steps), beta(steps);
+
+    // deterministic start vector, so that estimates are reproducible
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    Vector v(n);
+    for(Index i = 0; i < n; i++) {
+        v(i) = T(distribution(generator));
+    }
+    v.normalize();
+
+    Vector w(n);
+    Eigen::SelfAdjointEigenSolver<Basis> tridiagonal_solver;
+    estimate.converged = false;
+
+    for(Index k = 0; k < steps; k++) {
+        basis.col(k) = v;
+        w.noalias() = upper.template selfadjointView<Eigen::Upper>() * v;
+        estimate.iterations++;
+
+        alpha(k) = v.dot(w);
+        w -= alpha(k) * v;
+        if(k > 0) {
+            w -= beta(k - 1) * basis.col(k - 1);
+        }
+
+        // full reorthogonalization against the basis built so far
+        w -= basis.leftCols(k + 1) * (basis.leftCols(k + 1).transpose() * w);
+        beta(k) = w.norm();
+
+        Vector subdiagonal = beta.head(k);
+        tridiagonal_solver.computeFromTridiagonal(alpha.head(k + 1), subdiagonal,
+                                                  Eigen::ComputeEigenvectors);
+        if(tridiagonal_solver.info() != Eigen::Success) {
+            // implicit QR on the tridiagonal matrix can fail to converge on badly
+            // scaled spectra, in which case the small dense problem is solved instead.
+            Basis tridiagonal = Basis::Zero(k + 1, k + 1);
+            tridiagonal.diagonal() = alpha.head(k + 1);
+            tridiagonal.template diagonal<1>() = subdiagonal;
+            tridiagonal.template diagonal<-1>() = subdiagonal;
+            tridiagonal_solver.compute(tridiagonal, Eigen::ComputeEigenvectors);
+        }
+        estimate.value = tridiagonal_solver.eigenvalues()(0);
+        estimate.residual = beta(k) * std::abs(tridiagonal_solver.eigenvectors()(k, 0));
+
+        bool invariant_subspace = beta(k) <= std::numeric_limits<T>::epsilon() * std::max(T(1), std::abs(alpha(k)));
+        if(invariant_subspace
+           || estimate.residual <= tolerance * std::max(T(1), std::abs(estimate.value))) {
+            estimate.converged = true;
+            break;
+        }
+
+        v = w / beta(k);
+    }
+
+    estimate.lower_bound = std::max(estimate.value - estimate.residual,
+                                    gershgorin_lower_bound(upper));
+    return estimate;
+}
+
+}
+
+#endif
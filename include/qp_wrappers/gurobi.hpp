@@ -2,9 +2,11 @@
 #define QPWRAPPERS_GUROBI_HPP
 
 #include "problem.hpp"
+#include "sparse_problem.hpp"
 #include "types.hpp"
 #include <gurobi_c++.h>
 #include <string>
+#include <vector>
 
 namespace QPWrappers {
     namespace GUROBI {
@@ -48,38 +50,93 @@ namespace QPWrappers {
                     env.set(GRB_DoubleParam_PSDTol, tolerance);
                 }
 
+                /*
+                    Time budget of each init or next call in seconds, 0 for no
+                    budget. The time left after building the model is given to
+                    Gurobi as its TimeLimit. A solve that runs out of it returns
+                    OptReturnType::TimeLimit with the best solution found so far.
+                */
+                void setTimeBudget(double seconds) {
+                    budget.set(seconds);
+                }
+
                 /*
                     Solve the first intance of the set of problems.
                     Load solution result to result.
                 */
-                OptReturnType init(const Problem<T>& problem, typename Problem<T>::Vector& result) {
-                    GRBModel model{env};
-                    GRBVar* vars = model.addVars(problem.lbx().data(), problem.ubx().data(), NULL, NULL, NULL, problem.num_vars());
+                template<int NumVars, int MaxConstraints>
+                OptReturnType init(const Problem<T, NumVars, MaxConstraints>& problem, typename Problem<T>::Vector& result) {
+                    return solve(problem, result);
+                }
 
-                    for(typename Problem<T>::Index i = 0; i < problem.num_constraints(); i++) {
-                        GRBLinExpr expr;
-                        for(typename Problem<T>::Index j = 0; j < problem.num_vars(); j++) {
-                            expr += problem.A()(i, j) * vars[j];
-                        }
+                /*
+                    Sparse version of init. Only the nonzero entries of Q and A
+                    are added to the model.
+                */
+                OptReturnType init(const SparseProblem<T>& problem, typename Problem<T>::Vector& result) {
+                    return solve(problem, result);
+                }
 
-                        model.addConstr(expr, GRB_LESS_EQUAL, problem.ub()(i));
-                        model.addConstr(expr, GRB_GREATER_EQUAL, problem.lb()(i));
-                    }
+                /*
+                    Solve the next problem of the set of problems.
+                */
+                template<int NumVars, int MaxConstraints>
+                OptReturnType next(const Problem<T, NumVars, MaxConstraints>& problem, typename Problem<T>::Vector& result) {
+                    return init(problem, result);
+                }
 
-                    GRBQuadExpr obj_quad{0};
-                    for(typename Problem<T>::Index i = 0; i < problem.num_vars(); i++) {
-                        for(typename Problem<T>::Index j = 0; j < problem.num_vars(); j++) {
-                            obj_quad += problem.Q()(i, j) * vars[i] * vars[j];
-                        }
-                    }
-                    obj_quad *= 0.5;
+                /*
+                    Sparse version of next.
+                */
+                OptReturnType next(const SparseProblem<T>& problem, typename Problem<T>::Vector& result) {
+                    return init(problem, result);
+                }
+
+                /*
+                    Solve the next problem of the set of problems with the given initial guess.
+                    Since there is no concept of feeding initial guess in GUROBI, we simply call init.
+                */
+                template<int NumVars, int MaxConstraints>
+                OptReturnType next(const Problem<T, NumVars, MaxConstraints>& problem, typename Problem<T>::Vector& result, const typename Problem<T>::Vector& initial_guess) {
+                    return init(problem, result);
+                }
+
+                /*
+                    Sparse version of next with the given initial guess.
+                */
+                OptReturnType next(const SparseProblem<T>& problem, typename Problem<T>::Vector& result, const typename Problem<T>::Vector& initial_guess) {
+                    return init(problem, result);
+                }
+
+                /*
+                    Statistics of the last init or next call.
+                */
+                const SolveStatistics& statistics() const {
+                    return last_statistics;
+                }
+
+            private:
+                GRBEnv env;
+                T psd_tolerance;
+                SolveStatistics last_statistics;
+                TimeBudget budget;
+
+                template<typename ProblemType>
+                OptReturnType solve(const ProblemType& problem, typename Problem<T>::Vector& result) {
+                    last_statistics = SolveStatistics();
+                    SolveClock::time_point setup_start = SolveClock::now();
+
+                    GRBModel model{env};
+                    GRBVar* vars = model.addVars(problem.lbx().data(), problem.ubx().data(), NULL, NULL, NULL, problem.num_vars());
+
+                    add_constraints(model, vars, problem);
 
                     GRBLinExpr obj_lin{0};
                     for(typename Problem<T>::Index i = 0; i < problem.num_vars(); i++) {
                         obj_lin += problem.c()(i) * vars[i];
                     }
 
-                    model.setObjective(obj_quad + obj_lin);
+                    model.setObjective(quadratic_objective(vars, problem) + obj_lin);
 
 
                     if(problem.is_Q_psd(psd_tolerance)) {
@@ -88,54 +145,109 @@ namespace QPWrappers {
                         env.set(GRB_IntParam_Method, -1);
                     }
 
+                    if(budget.active()) {
+                        model.set(GRB_DoubleParam_TimeLimit, budget.remaining(seconds_since(setup_start)));
+                    }
+
+                    last_statistics.setup_time = seconds_since(setup_start);
+
+                    SolveClock::time_point solve_start = SolveClock::now();
                     model.optimize();
+                    last_statistics.solve_time = seconds_since(solve_start);
+                    last_statistics.iterations = static_cast<long long>(model.get(GRB_DoubleAttr_IterCount))
+                                                 + model.get(GRB_IntAttr_BarIterCount);
+                    budget.record(last_statistics, setup_start);
                     auto status = model.get(GRB_IntAttr_Status);
 
+                    OptReturnType return_value = OptReturnType::Unknown;
                     if(status == GRB_OPTIMAL) {
                         loadResult(vars, problem.num_vars(), result);
-                        delete[] vars;
-                        return OptReturnType::Optimal;
+                        return_value = OptReturnType::Optimal;
                     } else if(status == GRB_INFEASIBLE) {
-                        delete[] vars;
-                        return OptReturnType::Infeasible;
+                        return_value = OptReturnType::Infeasible;
                     } else if (status == GRB_INF_OR_UNBD) {
-                        delete[] vars;
-                        return OptReturnType::InfeasibleOrUnbounded;
+                        return_value = OptReturnType::InfeasibleOrUnbounded;
                     } else if(status == GRB_UNBOUNDED) {
-                        delete[] vars;
                         loadResult(vars, problem.num_vars(), result);
-                        return OptReturnType::Unbounded;
+                        return_value = OptReturnType::Unbounded;
                     } else if (status == GRB_NUMERIC) {
-                        delete[] vars;
-                        return OptReturnType::Error;
+                        return_value = OptReturnType::Error;
                     } else if (status == GRB_SUBOPTIMAL) {
-                        delete[] vars;
                         loadResult(vars, problem.num_vars(), result);
-                        return OptReturnType::Feasible;
+                        return_value = OptReturnType::Feasible;
+                    } else if (status == GRB_TIME_LIMIT && model.get(GRB_IntAttr_SolCount) > 0) {
+                        loadResult(vars, problem.num_vars(), result);
+                        return_value = OptReturnType::TimeLimit;
                     }
 
                     delete[] vars;
-                    return OptReturnType::Unknown;
+                    return return_value;
+                }
+
+                template<int NumVars, int MaxConstraints>
+                void add_constraints(GRBModel& model, GRBVar* vars, const Problem<T, NumVars, MaxConstraints>& problem) {
+                    for(typename Problem<T>::Index i = 0; i < problem.num_constraints(); i++) {
+                        GRBLinExpr expr;
+                        for(typename Problem<T>::Index j = 0; j < problem.num_vars(); j++) {
+                            expr += problem.A()(i, j) * vars[j];
+                        }
+
+                        model.addConstr(expr, GRB_LESS_EQUAL, problem.ub()(i));
+                        model.addConstr(expr, GRB_GREATER_EQUAL, problem.lb()(i));
+                    }
                 }
 
                 /*
-                    Solve the next problem of the set of problems.
+                    Rows are assembled by a single pass over the columns of A.
                 */
-                OptReturnType next(const Problem<T>& problem, typename Problem<T>::Vector& result) {
-                    return init(problem, result);
+                void add_constraints(GRBModel& model, GRBVar* vars, const SparseProblem<T>& problem) {
+                    const auto& A = problem.A();
+                    std::vector<GRBLinExpr> exprs(problem.num_constraints());
+                    for(typename Problem<T>::Index j = 0; j < A.outerSize(); j++) {
+                        for(typename SparseProblem<T>::SparseMatrix::InnerIterator it(A, j); it; ++it) {
+                            exprs[it.row()] += it.value() * vars[j];
+                        }
+                    }
+
+                    for(typename Problem<T>::Index i = 0; i < problem.num_constraints(); i++) {
+                        model.addConstr(exprs[i], GRB_LESS_EQUAL, problem.ub()(i));
+                        model.addConstr(exprs[i], GRB_GREATER_EQUAL, problem.lb()(i));
+                    }
                 }
 
                 /*
-                    Solve the next problem of the set of problems with the given initial guess.
-                    Since there is no concept of feeding initial guess in GUROBI, we simply call init.
+                    Off-diagonal entries of the upper triangle appear twice in Q,
+                    which cancels the 1/2 of the objective.
                 */
-                OptReturnType next(const Problem<T>& problem, typename Problem<T>::Vector& result, const typename Problem<T>::Vector& initial_guess) {
-                    return init(problem, result);
+                template<int NumVars, int MaxConstraints>
+                GRBQuadExpr quadratic_objective(GRBVar* vars, const Problem<T, NumVars, MaxConstraints>& problem) {
+                    const auto& Q = problem.Q_upper();
+                    GRBQuadExpr obj_quad{0};
+                    for(typename Problem<T>::Index i = 0; i < problem.num_vars(); i++) {
+                        obj_quad.addTerm(Q(i, i) / 2, vars[i], vars[i]);
+                        for(typename Problem<T>::Index j = i + 1; j < problem.num_vars(); j++) {
+                            if(Q(i, j) != T(0)) {
+                                obj_quad.addTerm(Q(i, j), vars[i], vars[j]);
+                            }
+                        }
+                    }
+                    return obj_quad;
                 }
 
-            private:
-                GRBEnv env;
-                T psd_tolerance;
+                /*
+                    Sparse version of quadratic_objective.
+                */
+                GRBQuadExpr quadratic_objective(GRBVar* vars, const SparseProblem<T>& problem) {
+                    const auto& Q = problem.Q();
+                    GRBQuadExpr obj_quad{0};
+                    for(typename Problem<T>::Index j = 0; j < Q.outerSize(); j++) {
+                        for(typename SparseProblem<T>::SparseMatrix::InnerIterator it(Q, j); it; ++it) {
+                            T coeff = it.row() == j ? it.value() / 2 : it.value();
+                            obj_quad.addTerm(coeff, vars[it.row()], vars[j]);
+                        }
+                    }
+                    return obj_quad;
+                }
 
                 void loadResult(GRBVar* vars, typename Problem<T>::Index var_count, typename Problem<T>::Vector& result) {
                     result.resize(var_count);
@@ -0,0 +1,445 @@
+#ifndef QPWRAPPERS_MIXED_PRECISION_HPP
+#define QPWRAPPERS_MIXED_PRECISION_HPP
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "problem.hpp"
+#include "sparse_problem.hpp"
+#include "types.hpp"
+
+
+namespace QPWrappers {
+
+/**
+    Solves a Problem or SparseProblem with an engine working in the lower
+    precision Low, e.g. OSQP::Engine<float>, and recovers the accuracy
+    of T by iterative refinement.
+
+    The limits the low precision solution is within active_tolerance of
+    are taken as the active set, and the equality constrained problem
+        [Q   A_a^T] [x]   [-c ]
+        [A_a   0  ] [l] = [b_a]
+    on them is solved by factorizing a regularized version of this KKT
+    matrix in Low, and correcting the solution with residuals of the
+    unregularized system computed in T until they are below tolerance.
+    Limits with multipliers of the wrong sign are then dropped from the
+    active set and violated ones added, and the system is solved again,
+    a few times at most. If this does not end with a solution satisfying
+    every limit, the low precision solution and status are returned. An
+    iterate the engine stopped at with TimeLimit is returned unrefined.
+
+    Duals of refined solutions are kept, with the convention
+        Q x + c + A^T y + z = 0
+    where y(i) is positive if the upper limit of constraint i is active.
+*/
+template<typename ProblemType, typename Low = float>
+class MixedPrecision {
+    public:
+        using T = typename ProblemType::Scalar;
+        using Index = Eigen::Index;
+        using Vector = typename Problem<T>::Vector;
+        using LowVector = typename Problem<Low>::Vector;
+        using LowProblem = decltype(std::declval<const ProblemType&>().template cast<Low>());
+
+        explicit MixedPrecision(T tolerance = T(1e-9), T active_tolerance = T(1e-4),
+                                int max_refinement_steps = 20):
+                tolerance(tolerance),
+                active_tolerance(active_tolerance),
+                max_refinement_steps(max_refinement_steps),
+                low_problem(cast_problem_type()) {}
+
+        /*
+            init, next and next with an initial guess of engine on the
+            problem cast to Low, followed by refinement.
+        */
+        template<typename Engine>
+        OptReturnType init(Engine& engine, const ProblemType& problem, Vector& result) {
+            cast(problem);
+            return refine(problem, engine.init(low_problem, low_result), result);
+        }
+
+        template<typename Engine>
+        OptReturnType next(Engine& engine, const ProblemType& problem, Vector& result) {
+            cast(problem);
+            return refine(problem, engine.next(low_problem, low_result), result);
+        }
+
+        template<typename Engine>
+        OptReturnType next(Engine& engine, const ProblemType& problem, Vector& result,
+                           const Vector& initial_guess) {
+            cast(problem);
+            low_guess = initial_guess.template cast<Low>();
+            return refine(problem, engine.next(low_problem, low_result, low_guess), result);
+        }
+
+        /*
+            True if the last solution was refined to tolerance.
+        */
+        bool refined() const {
+            return was_refined;
+        }
+
+        /*
+            Number of corrections made to the last solution.
+        */
+        int refinement_steps() const {
+            return steps;
+        }
+
+        /*
+            Duals of the last solution, valid only if it was refined.
+        */
+        const Vector& constraint_duals() const {
+            return y;
+        }
+
+        const Vector& variable_duals() const {
+            return z;
+        }
+
+        const LowProblem& low_precision_problem() const {
+            return low_problem;
+        }
+
+    private:
+        static constexpr bool is_sparse = std::is_same<ProblemType, SparseProblem<T>>::value;
+
+        // regularization of the KKT matrix factorized in Low, and how many
+        // times the active set is corrected at most.
+        static constexpr double regularization = 1e-6;
+        static constexpr int max_active_set_changes = 5;
+
+        using LowMatrix = Eigen::Matrix<Low, Eigen::Dynamic, Eigen::Dynamic>;
+        using LowSparseMatrix = Eigen::SparseMatrix<Low, Eigen::ColMajor>;
+        using Factorization = typename std::conditional<
+            is_sparse,
+            Eigen::SimplicialLDLT<LowSparseMatrix, Eigen::Lower>,
+            Eigen::LDLT<LowMatrix, Eigen::Lower>
+        >::type;
+
+        // limit of a constraint, or of a variable if is_variable is set,
+        // side is -1 for the lower, 1 for the upper limit and 0 for both
+        // when they are equal.
+        struct ActiveLimit {
+            Index index;
+            bool is_variable;
+            int side;
+        };
+
+        T tolerance, active_tolerance;
+        int max_refinement_steps;
+
+        LowProblem low_problem;
+        DerivedVersion low_versions;
+        LowVector low_result, low_guess;
+
+        bool was_refined = false;
+        int steps = 0;
+
+        std::vector<ActiveLimit> active;
+        Factorization factorization;
+
+        // [x; l] of the KKT system, its residual, and the buffers of the
+        // residual computation
+        Vector kkt_solution, residual, x, y, z, Ax;
+        LowVector low_residual;
+        std::vector<Eigen::Triplet<Low>> triplets;
+        std::vector<Index> constraint_position;
+
+        /*
+            Casts problem to low_problem, whose parts keep their versions
+            while the parts of problem they come from are unchanged.
+        */
+        void cast(const ProblemType& problem) {
+            low_problem = problem.template cast<Low>();
+            low_problem.versions = low_versions.derive(problem.version());
+        }
+
+        static LowProblem cast_problem_type() {
+            return problem_detail::EmptyProblem<ProblemType>::make().template cast<Low>();
+        }
+
+        static bool is_infinite(T value) {
+            return value == std::numeric_limits<T>::lowest()
+                   || value == std::numeric_limits<T>::max();
+        }
+
+        OptReturnType refine(const ProblemType& problem, OptReturnType status, Vector& result) {
+            was_refined = false;
+            steps = 0;
+            if(status == OptReturnType::TimeLimit) {
+                // the budget is spent, so the iterate is returned unrefined
+                result = low_result.template cast<T>();
+                return status;
+            }
+            if(status != OptReturnType::Optimal && status != OptReturnType::Feasible) {
+                return status;
+            }
+
+            result = low_result.template cast<T>();
+            x = result;
+            Ax.noalias() = problem.A() * x;
+            find_active_set(problem);
+
+            for(int change = 0; change <= max_active_set_changes; change++) {
+                if(!solve_kkt(problem)) {
+                    return status;
+                }
+                if(!update_active_set(problem)) {
+                    was_refined = true;
+                    result = x;
+                    return OptReturnType::Optimal;
+                }
+            }
+            return status;
+        }
+
+        // returned by closest_side for limits that are not active
+        static constexpr int inactive = 2;
+
+        static int closest_side(T value, T low, T up, T tolerance) {
+            if(low == up) {
+                return 0;
+            }
+            bool near_low = !is_infinite(low) && std::abs(value - low) <= tolerance * (1 + std::abs(low));
+            bool near_up = !is_infinite(up) && std::abs(value - up) <= tolerance * (1 + std::abs(up));
+            if(near_low && near_up) {
+                return std::abs(value - low) <= std::abs(value - up) ? -1 : 1;
+            }
+            return near_low ? -1 : (near_up ? 1 : inactive);
+        }
+
+        void find_active_set(const ProblemType& problem) {
+            active.clear();
+            for(Index i = 0; i < problem.num_constraints(); i++) {
+                int side = closest_side(Ax(i), problem.lb()(i), problem.ub()(i), active_tolerance);
+                if(side != inactive) {
+                    active.push_back(ActiveLimit{i, false, side});
+                }
+            }
+            for(Index j = 0; j < problem.num_vars(); j++) {
+                int side = closest_side(x(j), problem.lbx()(j), problem.ubx()(j), active_tolerance);
+                if(side != inactive) {
+                    active.push_back(ActiveLimit{j, true, side});
+                }
+            }
+        }
+
+        T limit_value(const ProblemType& problem, const ActiveLimit& limit) const {
+            if(limit.is_variable) {
+                return limit.side > 0 ? problem.ubx()(limit.index) : problem.lbx()(limit.index);
+            }
+            return limit.side > 0 ? problem.ub()(limit.index) : problem.lb()(limit.index);
+        }
+
+        /*
+            Solves the KKT system of the active set by iterative refinement,
+            leaving x, y and z at its solution. Returns false if the system
+            could not be factorized or refined to tolerance.
+        */
+        bool solve_kkt(const ProblemType& problem) {
+            Index n = problem.num_vars(), k = static_cast<Index>(active.size());
+            if(!factorize(problem)) {
+                return false;
+            }
+
+            kkt_solution.resize(n + k);
+            kkt_solution.head(n) = x;
+            kkt_solution.tail(k).setZero();
+
+            T scale = 1;
+            if(n > 0) {
+                scale = std::max(scale, problem.c().cwiseAbs().maxCoeff());
+            }
+            for(const ActiveLimit& limit: active) {
+                scale = std::max(scale, std::abs(limit_value(problem, limit)));
+            }
+
+            for(int step = 0; ; step++) {
+                compute_residual(problem);
+                T residual_norm = residual.size() > 0 ? residual.cwiseAbs().maxCoeff() : T(0);
+                if(!std::isfinite(residual_norm)) {
+                    return false;
+                }
+                if(residual_norm <= tolerance * scale) {
+                    return true;
+                }
+                if(step == max_refinement_steps) {
+                    return false;
+                }
+
+                low_residual = residual.template cast<Low>();
+                kkt_solution += factorization.solve(low_residual).template cast<T>();
+                steps++;
+            }
+        }
+
+        /*
+            residual = [-c; b_a] - K [x; l] in T, and x, y and z from the
+            current [x; l].
+        */
+        void compute_residual(const ProblemType& problem) {
+            Index n = problem.num_vars(), k = static_cast<Index>(active.size());
+            x = kkt_solution.head(n);
+            y.setZero(problem.num_constraints());
+            z.setZero(n);
+            for(Index p = 0; p < k; p++) {
+                const ActiveLimit& limit = active[p];
+                (limit.is_variable ? z : y)(limit.index) += kkt_solution(n + p);
+            }
+
+            residual.resize(n + k);
+            multiply_Q(problem, x, residual);
+            residual.head(n) += problem.c() + z;
+            residual.head(n).noalias() += problem.A().transpose() * y;
+            residual.head(n) = -residual.head(n);
+
+            Ax.noalias() = problem.A() * x;
+            for(Index p = 0; p < k; p++) {
+                const ActiveLimit& limit = active[p];
+                T value = limit.is_variable ? x(limit.index) : Ax(limit.index);
+                residual(n + p) = limit_value(problem, limit) - value;
+            }
+        }
+
+        /*
+            Removes limits whose multipliers have the wrong sign from the
+            active set and adds violated ones. Returns whether it changed.
+        */
+        bool update_active_set(const ProblemType& problem) {
+            Index n = problem.num_vars();
+            T largest_multiplier = 0;
+            if(!active.empty()) {
+                largest_multiplier = kkt_solution.tail(active.size()).cwiseAbs().maxCoeff();
+            }
+            T dual_tolerance = tolerance * std::max(T(1), largest_multiplier);
+
+            std::size_t kept = 0;
+            bool changed = false;
+            for(std::size_t p = 0; p < active.size(); p++) {
+                T multiplier = kkt_solution(n + static_cast<Index>(p));
+                if(active[p].side * multiplier < -dual_tolerance) {
+                    changed = true;
+                } else {
+                    active[kept++] = active[p];
+                }
+            }
+            active.resize(kept);
+            if(changed) {
+                return true;
+            }
+
+            for(Index i = 0; i < problem.num_constraints(); i++) {
+                changed |= add_if_violated(i, false, Ax(i), problem.lb()(i), problem.ub()(i));
+            }
+            for(Index j = 0; j < n; j++) {
+                changed |= add_if_violated(j, true, x(j), problem.lbx()(j), problem.ubx()(j));
+            }
+            return changed;
+        }
+
+        bool add_if_violated(Index index, bool is_variable, T value, T low, T up) {
+            for(const ActiveLimit& limit: active) {
+                if(limit.index == index && limit.is_variable == is_variable) {
+                    return false;
+                }
+            }
+            if(value < low - tolerance * (1 + std::abs(low))) {
+                active.push_back(ActiveLimit{index, is_variable, low == up ? 0 : -1});
+                return true;
+            }
+            if(value > up + tolerance * (1 + std::abs(up))) {
+                active.push_back(ActiveLimit{index, is_variable, low == up ? 0 : 1});
+                return true;
+            }
+            return false;
+        }
+
+        template<int NumVars, int MaxConstraints>
+        static void multiply_Q(const Problem<T, NumVars, MaxConstraints>& problem,
+                               const Vector& x, Vector& result) {
+            result.head(x.rows()).noalias() = problem.Q() * x;
+        }
+
+        static void multiply_Q(const SparseProblem<T>& problem, const Vector& x, Vector& result) {
+            result.head(x.rows()).noalias() = problem.Q().template selfadjointView<Eigen::Upper>() * x;
+        }
+
+        /*
+            Factorizes, in Low,
+                [Q + d I   A_a^T]
+                [A_a       -d I ]
+            which is quasi definite for d > 0, so LDL^T factors it stably.
+        */
+        template<int NumVars, int MaxConstraints>
+        bool factorize(const Problem<T, NumVars, MaxConstraints>& problem) {
+            Index n = problem.num_vars(), k = static_cast<Index>(active.size());
+            LowMatrix K = LowMatrix::Zero(n + k, n + k);
+            K.topLeftCorner(n, n) = problem.Q().template cast<Low>();
+            K.topLeftCorner(n, n).diagonal().array() += Low(regularization);
+            K.bottomRightCorner(k, k).diagonal().setConstant(-Low(regularization));
+            for(Index p = 0; p < k; p++) {
+                const ActiveLimit& limit = active[p];
+                if(limit.is_variable) {
+                    K(n + p, limit.index) = Low(1);
+                } else {
+                    K.row(n + p).head(n) = problem.A().row(limit.index).template cast<Low>();
+                }
+            }
+
+            factorization.compute(K);
+            return factorization.info() == Eigen::Success;
+        }
+
+        bool factorize(const SparseProblem<T>& problem) {
+            using SparseMatrix = typename SparseProblem<T>::SparseMatrix;
+            Index n = problem.num_vars(), k = static_cast<Index>(active.size());
+
+            triplets.clear();
+            const SparseMatrix& Q = problem.Q();
+            for(Index j = 0; j < Q.outerSize(); j++) {
+                for(typename SparseMatrix::InnerIterator it(Q, j); it; ++it) {
+                    // Q holds the upper triangle, K is given by its lower
+                    triplets.emplace_back(j, it.row(), Low(it.value()));
+                }
+            }
+            for(Index j = 0; j < n; j++) {
+                triplets.emplace_back(j, j, Low(regularization));
+            }
+
+            constraint_position.assign(problem.num_constraints(), -1);
+            for(Index p = 0; p < k; p++) {
+                const ActiveLimit& limit = active[p];
+                triplets.emplace_back(n + p, n + p, -Low(regularization));
+                if(limit.is_variable) {
+                    triplets.emplace_back(n + p, limit.index, Low(1));
+                } else {
+                    constraint_position[limit.index] = p;
+                }
+            }
+            const SparseMatrix& A = problem.A();
+            for(Index j = 0; j < A.outerSize(); j++) {
+                for(typename SparseMatrix::InnerIterator it(A, j); it; ++it) {
+                    Index p = constraint_position[it.row()];
+                    if(p != -1) {
+                        triplets.emplace_back(n + p, j, Low(it.value()));
+                    }
+                }
+            }
+
+            LowSparseMatrix K(n + k, n + k);
+            K.setFromTriplets(triplets.begin(), triplets.end());
+            factorization.compute(K);
+            return factorization.info() == Eigen::Success;
+        }
+};
+
+}
+
+#endif
@@ -4,26 +4,94 @@
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 #include "problem.hpp"
+#include "sparse_problem.hpp"
 #include <osqp.h>
+#include <algorithm>
 #include <iostream>
+#include <cstring>
+#include <vector>
 #include "types.hpp"
 
 namespace QPWrappers {
     namespace OSQP {
-        
+
+        /*
+            Types and functions of the OSQP library working in T.
+        */
+        template<typename T>
+        struct Library;
+
+#define QPWRAPPERS_OSQP_LIBRARY(NAMESPACE) \
+        template<> \
+        struct Library<NAMESPACE::c_float> { \
+            using Float = NAMESPACE::c_float; \
+            using Int = NAMESPACE::c_int; \
+            using Matrix = NAMESPACE::csc; \
+            using Settings = NAMESPACE::OSQPSettings; \
+            using Data = NAMESPACE::OSQPData; \
+            using Workspace = NAMESPACE::OSQPWorkspace; \
+            static constexpr auto new_matrix = &NAMESPACE::csc_matrix; \
+            static constexpr auto set_default_settings = &NAMESPACE::osqp_set_default_settings; \
+            static constexpr auto setup = &NAMESPACE::osqp_setup; \
+            static constexpr auto solve = &NAMESPACE::osqp_solve; \
+            static constexpr auto cleanup = &NAMESPACE::osqp_cleanup; \
+            static constexpr auto warm_start_x = &NAMESPACE::osqp_warm_start_x; \
+            static constexpr auto warm_start_y = &NAMESPACE::osqp_warm_start_y; \
+            static constexpr auto update_lin_cost = &NAMESPACE::osqp_update_lin_cost; \
+            static constexpr auto update_bounds = &NAMESPACE::osqp_update_bounds; \
+            static constexpr auto update_P = &NAMESPACE::osqp_update_P; \
+            static constexpr auto update_A = &NAMESPACE::osqp_update_A; \
+            static constexpr auto update_P_A = &NAMESPACE::osqp_update_P_A; \
+            static constexpr auto update_time_limit = &NAMESPACE::osqp_update_time_limit; \
+            static constexpr auto update_eps_prim_inf = &NAMESPACE::osqp_update_eps_prim_inf; \
+        };
+
+        QPWRAPPERS_OSQP_LIBRARY()
+
+#ifdef QPWRAPPERS_WITH_OSQP_FLOAT
+        /*
+            The OSQP built with DFLOAT by cmake/OSQPFloat.cmake. Its headers
+            declare their own c_float, csc, OSQPWorkspace etc., so they are
+            included in a namespace of their own, after the headers of the
+            double OSQP have included every system header they need.
+            symbols.h renames its functions to the prefixed symbols of the
+            library until undef_symbols.h.
+        */
+        namespace single_precision {
+            #include <osqp_float/symbols.h>
+            #include <osqp_float/osqp.h>
+        }
+
+        QPWRAPPERS_OSQP_LIBRARY(single_precision)
+        #include <osqp_float/undef_symbols.h>
+#endif
+#undef QPWRAPPERS_OSQP_LIBRARY
+
         /*
             A QP engine that solves consecutive QP instances where the result of the previous
             instance used as an initial guess to the next one unless an initial guess
             is provided.
+
+            The engine keeps one OSQP workspace across calls. next updates the
+            parts of its data that changed since the last call in place, so the
+            KKT matrix is refactored only if Q or A changed, and the workspace
+            is set up again only if the sparsity pattern of Q or A changed.
+            The workspace keeps the duals, the adapted rho and the scaling of
+            the previous solve, and a workspace set up again by next starts
+            from the duals and the rho of the previous solve as well.
+
+            T is double, or float if the build has QPWRAPPERS_WITH_OSQP_FLOAT,
+            which solves Problem<float> with a single precision OSQP.
         */
         template<typename T>
         class Engine {
-            static_assert(std::is_same<T, c_float>::value);
+            using OSQPLib = Library<T>;
+            using c_int = typename OSQPLib::Int;
 
             public:
-                Engine(): initialized(false) {
-                    settings = static_cast<OSQPSettings*>(c_malloc(sizeof(OSQPSettings)));
-                    osqp_set_default_settings(settings);
+                Engine(): initialized(false), work(OSQP_NULL), carry_state(false), dual_guess(false) {
+                    settings = static_cast<typename OSQPLib::Settings*>(c_malloc(sizeof(typename OSQPLib::Settings)));
+                    OSQPLib::set_default_settings(settings);
                     settings->alpha = 1.0;
                     settings->verbose = false;
                     settings->max_iter = 1000000;
@@ -37,6 +105,7 @@ namespace QPWrappers {
                 Engine& operator=(Engine&& rhs) = delete;
 
                 ~Engine() {
+                    cleanup();
                     c_free(settings);
                 }
 
@@ -45,78 +114,253 @@ namespace QPWrappers {
                 */
                 void setFeasibilityTolerance(T tolerance) {
                     settings->eps_prim_inf = tolerance;
+                    if(work != OSQP_NULL) {
+                        OSQPLib::update_eps_prim_inf(work, tolerance);
+                    }
+                }
+
+                /*
+                    Time budget of each init or next call in seconds, 0 for no
+                    budget. A solve that runs out of it returns
+                    OptReturnType::TimeLimit and loads the last ADMM iterate to
+                    result. OSQP counts its own setup and update time against
+                    the time left after setup, so it stops slightly early
+                    rather than late.
+                */
+                void setTimeBudget(double seconds) {
+                    budget.set(seconds);
                 }
 
                 /*
                     Solve the first intance of the set of problems.
                     Load solution result to result.
                 */
-                OptReturnType init(const Problem<T>& problem, typename Problem<T>::Vector& result) {
-                    OSQPWorkspace* work;
+                template<int NumVars, int MaxConstraints>
+                OptReturnType init(const Problem<T, NumVars, MaxConstraints>& problem, typename Problem<T>::Vector& result) {
+                    cleanup();
+                    carry_state = false;
+                    return solve(problem, result, false);
+                }
 
-                    // setup data start
-                    OSQPData* data = static_cast<OSQPData*>(c_malloc(sizeof(OSQPData)));
+                /*
+                    Sparse version of init. Q and A are handed to OSQP without
+                    a dense copy.
+                */
+                OptReturnType init(const SparseProblem<T>& problem, typename Problem<T>::Vector& result) {
+                    cleanup();
+                    carry_state = false;
+                    return solve(problem, result, false);
+                }
 
-                    data->n = problem.num_vars();
+                /*
+                    Solve the next problem of the set of problems.
+                */
+                template<int NumVars, int MaxConstraints>
+                OptReturnType next(const Problem<T, NumVars, MaxConstraints>& problem, typename Problem<T>::Vector& result) {
+                    if(!initialized || problem.num_vars() != previous_result.rows()) {
+                        initialized = false;
+                        return init(problem, result);
+                    }
+                    return solve(problem, result, true);
+                }
 
-                    typename Problem<T>::Matrix QUpperTriangular = problem.Q().template triangularView<Eigen::Upper>();
-                    Eigen::SparseMatrix<T> SparseQUpperTriangular = QUpperTriangular.sparseView();
-                    SparseQUpperTriangular.makeCompressed();
-                    data->P = csc_matrix(
-                        problem.num_vars(),
-                        problem.num_vars(),
-                        SparseQUpperTriangular.nonZeros(),
-                        SparseQUpperTriangular.valuePtr(),
-                        SparseQUpperTriangular.innerIndexPtr(),
-                        SparseQUpperTriangular.outerIndexPtr()
-                    );
+                /*
+                    Sparse version of next.
+                */
+                OptReturnType next(const SparseProblem<T>& problem, typename Problem<T>::Vector& result) {
+                    if(!initialized || problem.num_vars() != previous_result.rows()) {
+                        initialized = false;
+                        return init(problem, result);
+                    }
+                    return solve(problem, result, true);
+                }
 
-                    data->q = static_cast<c_float*>(c_malloc(sizeof(T) * problem.num_vars()));
-                    std::memcpy(data->q, problem.c().data(), problem.num_vars() * sizeof(T));
-                    // data->q = const_cast<T*>(problem.c().data());
-
-                    typename Problem<T>::Matrix A = problem.A();
-                    typename Problem<T>::Vector lb = problem.lb();
-                    typename Problem<T>::Vector ub = problem.ub();
-                    A.conservativeResize(problem.num_constraints() + problem.num_vars(), Eigen::NoChange_t());
-                    lb.conservativeResize(problem.num_constraints() + problem.num_vars());
-                    ub.conservativeResize(problem.num_constraints() + problem.num_vars());
-                    A.block(problem.num_constraints(), 0, problem.num_vars(), problem.num_vars()).setIdentity();
-                    lb.block(problem.num_constraints(), 0, problem.num_vars(), 1) = problem.lbx();
-                    ub.block(problem.num_constraints(), 0, problem.num_vars(), 1) = problem.ubx();
-                    Eigen::SparseMatrix<T> SparseA = A.sparseView();
-                    SparseA.makeCompressed();
-                    data->m = A.rows();
-                    data->A = csc_matrix(
-                        A.rows(),
-                        A.cols(),
-                        SparseA.nonZeros(),
-                        SparseA.valuePtr(),
-                        SparseA.innerIndexPtr(),
-                        SparseA.outerIndexPtr()
-                    );
+                /*
+                    Solve the next problem of the set of problems with the given initial guess.
+                */
+                template<int NumVars, int MaxConstraints>
+                OptReturnType next(const Problem<T, NumVars, MaxConstraints>& problem, typename Problem<T>::Vector& result, const typename Problem<T>::Vector& initial_guess) {
+                    initialized = true;
+                    previous_result = initial_guess;
+                    return next(problem, result);
+                }
 
-                    data->l = lb.data();
-                    data->u = ub.data();
-                    // setup data end
+                /*
+                    Sparse version of next with the given initial guess.
+                */
+                OptReturnType next(const SparseProblem<T>& problem, typename Problem<T>::Vector& result, const typename Problem<T>::Vector& initial_guess) {
+                    initialized = true;
+                    previous_result = initial_guess;
+                    return next(problem, result);
+                }
+
+                /*
+                    Solve the next problem of the set of problems with the given initial guess,
+                    and the given guess of the duals y of the constraints and z of the variable
+                    limits for
+                        Q x + c + A^T y + z = 0.
+                */
+                template<int NumVars, int MaxConstraints>
+                OptReturnType next(const Problem<T, NumVars, MaxConstraints>& problem, typename Problem<T>::Vector& result,
+                                   const typename Problem<T>::Vector& initial_guess,
+                                   const typename Problem<T>::Vector& constraint_duals_guess,
+                                   const typename Problem<T>::Vector& variable_duals_guess) {
+                    set_dual_guess(constraint_duals_guess, variable_duals_guess);
+                    return next(problem, result, initial_guess);
+                }
+
+                /*
+                    Sparse version of next with the given primal and dual guesses.
+                */
+                OptReturnType next(const SparseProblem<T>& problem, typename Problem<T>::Vector& result,
+                                   const typename Problem<T>::Vector& initial_guess,
+                                   const typename Problem<T>::Vector& constraint_duals_guess,
+                                   const typename Problem<T>::Vector& variable_duals_guess) {
+                    set_dual_guess(constraint_duals_guess, variable_duals_guess);
+                    return next(problem, result, initial_guess);
+                }
+
+                /*
+                    Duals of the last solution for Q x + c + A^T y + z = 0,
+                    valid if the last solve was optimal.
+                */
+                const typename Problem<T>::Vector& constraint_duals() const {
+                    return y;
+                }
+
+                const typename Problem<T>::Vector& variable_duals() const {
+                    return z;
+                }
+
+                /*
+                    Statistics of the last init or next call.
+                */
+                const SolveStatistics& statistics() const {
+                    return last_statistics;
+                }
+
+            private:
+                typename Problem<T>::Vector previous_result;
+                bool initialized;
+                SolveStatistics last_statistics;
+                TimeBudget budget;
+
+                typename OSQPLib::Settings* settings;
+
+                // workspace of the last solve and the version of the problem
+                // its data is loaded from, or OSQP_NULL.
+                typename OSQPLib::Workspace* work;
+                ProblemVersion work_version;
+
+                // buffers of the data handed to OSQP, kept to avoid reallocating
+                Eigen::SparseMatrix<T> P_matrix, A_matrix;
+                typename Problem<T>::Vector lower, upper, duals;
+
+                // variables with a finite limit in the workspace, which have
+                // a row in augmented_A, and a buffer to compare them with.
+                std::vector<c_int> bounded_vars, new_bounded_vars;
+
+                // duals of the last optimal solve or the last dual guess, and
+                // the rho OSQP adapted to in the last solve. They are carried
+                // over to workspaces set up by next if carry_state is set, and
+                // the duals are given to the workspace in any case if
+                // dual_guess is set.
+                typename Problem<T>::Vector y, z;
+                T rho;
+                bool carry_state, dual_guess;
+
+                void set_dual_guess(const typename Problem<T>::Vector& constraint_duals_guess,
+                                    const typename Problem<T>::Vector& variable_duals_guess) {
+                    y = constraint_duals_guess;
+                    z = variable_duals_guess;
+                    dual_guess = true;
+                }
+
+                /*
+                    Warm starts the duals of the workspace from y and z if they
+                    match the problem.
+                */
+                template<typename ProblemType>
+                void warm_start_duals(const ProblemType& problem) {
+                    if(y.rows() != problem.num_constraints() || z.rows() != problem.num_vars()) {
+                        return;
+                    }
+                    duals.resize(y.rows() + bounded_vars.size());
+                    duals.head(y.rows()) = y;
+                    for(std::size_t k = 0; k < bounded_vars.size(); k++) {
+                        duals(y.rows() + k) = z(bounded_vars[k]);
+                    }
+                    OSQPLib::warm_start_y(work, duals.data());
+                }
 
-                    osqp_setup(&work, data, settings);
+                void loadResult(typename OSQPLib::Workspace* work, typename Problem<T>::Vector& result, typename Problem<T>::Index n) {
+                    result.resize(n);
+                    for(typename Problem<T>::Index i = 0; i < n; i++) {
+                        result(i) = work->solution->x[i];
+                    }
+                }
 
-                    osqp_solve(work);
+                /*
+                    Loads the problem to the workspace, solves it, and loads the
+                    solution to result if it is solved. Previous result is used
+                    as the initial guess if warm_start is true.
+                */
+                template<typename ProblemType>
+                OptReturnType solve(const ProblemType& problem, typename Problem<T>::Vector& result, bool warm_start) {
+                    last_statistics = SolveStatistics();
+                    SolveClock::time_point setup_start = SolveClock::now();
+
+                    bool carry_duals = dual_guess;
+                    dual_guess = false;
+                    if(!update_workspace(problem)) {
+                        if(!setup_workspace(problem)) {
+                            last_statistics.setup_time = seconds_since(setup_start);
+                            budget.record(last_statistics, setup_start);
+                            return OptReturnType::Error;
+                        }
+                        carry_duals = carry_duals || carry_state;
+                    }
+                    if(warm_start) {
+                        OSQPLib::warm_start_x(work, previous_result.data());
+                    }
+                    if(carry_duals) {
+                        warm_start_duals(problem);
+                    }
+                    OSQPLib::update_time_limit(work, budget.active() ? budget.remaining(seconds_since(setup_start)) : 0);
+                    last_statistics.setup_time = seconds_since(setup_start);
+
+                    SolveClock::time_point solve_start = SolveClock::now();
+                    OSQPLib::solve(work);
+                    last_statistics.solve_time = seconds_since(solve_start);
+                    last_statistics.iterations = work->info->iter;
+                    budget.record(last_statistics, setup_start);
+                    rho = work->settings->rho;
+                    carry_state = true;
 
-                    OptReturnType return_value;
+                    OptReturnType return_value = OptReturnType::Unknown;
 
                     if(work->info->status_val == OSQP_SOLVED) {
                         loadResult(work, result, problem.num_vars());
                         initialized = true;
                         previous_result = result;
+                        y = Eigen::Map<const typename Problem<T>::Vector>(work->solution->y, problem.num_constraints());
+                        z.setZero(problem.num_vars());
+                        for(std::size_t k = 0; k < bounded_vars.size(); k++) {
+                            z(bounded_vars[k]) = work->solution->y[problem.num_constraints() + k];
+                        }
                         return_value = OptReturnType::Optimal;
-                    } else if(work->info->status_val == OSQP_NON_CVX 
+                    } else if(work->info->status_val == OSQP_NON_CVX
                            || work->info->status_val == OSQP_UNSOLVED) {
 
                         return_value = OptReturnType::Error;
-                    } else if(work->info->status_val == OSQP_TIME_LIMIT_REACHED
-                           || work->info->status_val == OSQP_SIGINT
+                    } else if(work->info->status_val == OSQP_TIME_LIMIT_REACHED) {
+                        // the iterate is kept as the initial guess of the next
+                        // solve, which continues from where this one stopped.
+                        loadResult(work, result, problem.num_vars());
+                        initialized = true;
+                        previous_result = result;
+                        return_value = OptReturnType::TimeLimit;
+                    } else if(work->info->status_val == OSQP_SIGINT
                            || work->info->status_val == OSQP_MAX_ITER_REACHED
                            || work->info->status_val == OSQP_SOLVED_INACCURATE) {
                         return_value = OptReturnType::Unknown;
@@ -127,173 +371,267 @@ namespace QPWrappers {
                         return_value = OptReturnType::Infeasible;
                     }
 
-                    free_osqp_data(data);
-
                     return return_value;
                 }
 
                 /*
-                    Solve the next problem of the set of problems.
+                    Sets up a new workspace for the problem. Returns false if
+                    OSQP rejects the problem.
                 */
-                OptReturnType next(const Problem<T>& problem, typename Problem<T>::Vector& result) {
-                    if(!initialized || problem.num_vars() != previous_result.rows()) {
-                        initialized = false;
-                        return init(problem, result);
-                    }
-                    OSQPWorkspace* work;
+                template<typename ProblemType>
+                bool setup_workspace(const ProblemType& problem) {
+                    cleanup();
 
                     // setup data start
-                    OSQPData* data = static_cast<OSQPData*>(c_malloc(sizeof(OSQPData)));
+                    typename OSQPLib::Data* data = static_cast<typename OSQPLib::Data*>(c_malloc(sizeof(typename OSQPLib::Data)));
 
                     data->n = problem.num_vars();
 
-                    typename Problem<T>::Matrix QUpperTriangular = problem.Q().template triangularView<Eigen::Upper>();
-                    Eigen::SparseMatrix<T> SparseQUpperTriangular = QUpperTriangular.sparseView();
-                    SparseQUpperTriangular.makeCompressed();
-                    data->P = csc_matrix(
+                    upper_triangular_Q(problem, P_matrix);
+                    data->P = OSQPLib::new_matrix(
                         problem.num_vars(),
                         problem.num_vars(),
-                        SparseQUpperTriangular.nonZeros(),
-                        SparseQUpperTriangular.valuePtr(),
-                        SparseQUpperTriangular.innerIndexPtr(),
-                        SparseQUpperTriangular.outerIndexPtr()
+                        P_matrix.nonZeros(),
+                        P_matrix.valuePtr(),
+                        P_matrix.innerIndexPtr(),
+                        P_matrix.outerIndexPtr()
                     );
 
-                    data->q = static_cast<c_float*>(c_malloc(sizeof(T) * problem.num_vars()));
-                    std::memcpy(data->q, problem.c().data(), problem.num_vars() * sizeof(T));
-                    // data->q = const_cast<T*>(problem.c().data());
-
-                    typename Problem<T>::Matrix A = problem.A();
-                    typename Problem<T>::Vector lb = problem.lb();
-                    typename Problem<T>::Vector ub = problem.ub();
-                    A.conservativeResize(problem.num_constraints() + problem.num_vars(), Eigen::NoChange_t());
-                    lb.conservativeResize(problem.num_constraints() + problem.num_vars());
-                    ub.conservativeResize(problem.num_constraints() + problem.num_vars());
-                    A.block(problem.num_constraints(), 0, problem.num_vars(), problem.num_vars()).setIdentity();
-                    lb.block(problem.num_constraints(), 0, problem.num_vars(), 1) = problem.lbx();
-                    ub.block(problem.num_constraints(), 0, problem.num_vars(), 1) = problem.ubx();
-                    Eigen::SparseMatrix<T> SparseA = A.sparseView();
-                    SparseA.makeCompressed();
-                    data->m = A.rows();
-                    data->A = csc_matrix(
-                        A.rows(),
-                        A.cols(),
-                        SparseA.nonZeros(),
-                        SparseA.valuePtr(),
-                        SparseA.innerIndexPtr(),
-                        SparseA.outerIndexPtr()
+                    data->q = const_cast<T*>(problem.c().data());
+
+                    find_bounded_vars(problem, bounded_vars);
+                    augmented_A(problem, A_matrix);
+                    augmented_bounds(problem);
+                    data->m = A_matrix.rows();
+                    data->A = OSQPLib::new_matrix(
+                        A_matrix.rows(),
+                        A_matrix.cols(),
+                        A_matrix.nonZeros(),
+                        A_matrix.valuePtr(),
+                        A_matrix.innerIndexPtr(),
+                        A_matrix.outerIndexPtr()
                     );
 
-                    data->l = lb.data();
-                    data->u = ub.data();
+                    data->l = lower.data();
+                    data->u = upper.data();
                     // setup data end
 
-                    osqp_setup(&work, data, settings);
-                    osqp_warm_start_x(work, previous_result.data()); // warm start
+                    // the rho adapted to the previous problem is a better start
+                    // than the default for the next one.
+                    typename OSQPLib::Settings setup_settings = *settings;
+                    if(carry_state) {
+                        setup_settings.rho = rho;
+                    }
 
-                    osqp_solve(work);
+                    // OSQP copies the data into the workspace
+                    c_int exitflag = OSQPLib::setup(&work, data, &setup_settings);
+                    free_osqp_data(data);
 
-                    OptReturnType return_value;
+                    if(exitflag != 0) {
+                        cleanup();
+                        return false;
+                    }
 
-                    if(work->info->status_val == OSQP_SOLVED) {
-                        loadResult(work, result, problem.num_vars());
-                        previous_result = result;
-                        return_value = OptReturnType::Optimal;
-                    } else if(work->info->status_val == OSQP_NON_CVX 
-                            || work->info->status_val == OSQP_UNSOLVED) {
+                    work_version = problem.version();
+                    return true;
+                }
 
-                        return_value = OptReturnType::Error;
-                    } else if(work->info->status_val == OSQP_TIME_LIMIT_REACHED
-                            || work->info->status_val == OSQP_SIGINT
-                            || work->info->status_val == OSQP_MAX_ITER_REACHED
-                            || work->info->status_val == OSQP_SOLVED_INACCURATE) {
-                        return_value = OptReturnType::Unknown;
-                    } else if(work->info->status_val == OSQP_DUAL_INFEASIBLE
-                            || work->info->status_val == OSQP_PRIMAL_INFEASIBLE
-                            || work->info->status_val == OSQP_PRIMAL_INFEASIBLE_INACCURATE
-                            || work->info->status_val == OSQP_DUAL_INFEASIBLE_INACCURATE) {
-                        return_value = OptReturnType::Infeasible;
+                /*
+                    Updates the data of the workspace to the problem in place.
+                    Returns false if there is no workspace, the sparsity pattern
+                    of Q or A changed, or OSQP rejects an update, in which case
+                    the workspace must be set up again.
+                */
+                template<typename ProblemType>
+                bool update_workspace(const ProblemType& problem) {
+                    if(work == OSQP_NULL) {
+                        return false;
                     }
 
-                    free_osqp_data(data);
+                    ProblemChanges changed(work_version, problem.version());
+                    if(work->data->n != problem.num_vars()) {
+                        return false;
+                    }
 
-                    return return_value;
+                    // variables gaining or losing their only finite limit add
+                    // or remove rows of augmented_A.
+                    if(changed.var_limits) {
+                        find_bounded_vars(problem, new_bounded_vars);
+                        if(new_bounded_vars != bounded_vars) {
+                            return false;
+                        }
+                    }
+                    if(work->data->m != problem.num_constraints() + static_cast<c_int>(bounded_vars.size())) {
+                        return false;
+                    }
+
+                    // the patterns are compared rather than trusting the
+                    // structure stamp, since dense matrices are handed to OSQP
+                    // without their zero entries.
+                    bool update_P = changed.structure || changed.Q;
+                    bool update_A = changed.structure || changed.A;
+                    if(update_P) {
+                        upper_triangular_Q(problem, P_matrix);
+                        if(!same_pattern(P_matrix, work->data->P)) {
+                            return false;
+                        }
+                    }
+                    if(update_A) {
+                        augmented_A(problem, A_matrix);
+                        if(!same_pattern(A_matrix, work->data->A)) {
+                            return false;
+                        }
+                    }
+
+                    if(update_P && update_A) {
+                        if(OSQPLib::update_P_A(work, P_matrix.valuePtr(), OSQP_NULL, P_matrix.nonZeros(),
+                                               A_matrix.valuePtr(), OSQP_NULL, A_matrix.nonZeros()) != 0) {
+                            return false;
+                        }
+                    } else if(update_P) {
+                        if(OSQPLib::update_P(work, P_matrix.valuePtr(), OSQP_NULL, P_matrix.nonZeros()) != 0) {
+                            return false;
+                        }
+                    } else if(update_A) {
+                        if(OSQPLib::update_A(work, A_matrix.valuePtr(), OSQP_NULL, A_matrix.nonZeros()) != 0) {
+                            return false;
+                        }
+                    }
 
+                    if(changed.c && OSQPLib::update_lin_cost(work, problem.c().data()) != 0) {
+                        return false;
+                    }
+
+                    if(changed.limits || changed.var_limits) {
+                        augmented_bounds(problem);
+                        if(OSQPLib::update_bounds(work, lower.data(), upper.data()) != 0) {
+                            return false;
+                        }
+                    }
+
+                    work_version = problem.version();
+                    return true;
+                }
+
+                static bool same_pattern(const Eigen::SparseMatrix<T>& matrix, const typename OSQPLib::Matrix* stored) {
+                    return matrix.nonZeros() == stored->p[stored->n]
+                        && std::equal(matrix.outerIndexPtr(), matrix.outerIndexPtr() + matrix.outerSize() + 1, stored->p)
+                        && std::equal(matrix.innerIndexPtr(), matrix.innerIndexPtr() + matrix.nonZeros(), stored->i);
+                }
+
+                void cleanup() {
+                    if(work != OSQP_NULL) {
+                        OSQPLib::cleanup(work);
+                        work = OSQP_NULL;
+                    }
                 }
 
                 /*
-                    Solve the next problem of the set of problems with the given initial guess.
+                    Upper triangular part of Q in CSC format, built in O(n^2)
+                    without a dense copy.
                 */
-                OptReturnType next(const Problem<T>& problem, typename Problem<T>::Vector& result, const typename Problem<T>::Vector& initial_guess) {
-                    initialized = true;
-                    previous_result = initial_guess;
-                    return next(problem, result);
+                template<int NumVars, int MaxConstraints>
+                void upper_triangular_Q(const Problem<T, NumVars, MaxConstraints>& problem, Eigen::SparseMatrix<T>& SparseQUpperTriangular) {
+                    const auto& Q = problem.Q_upper();
+                    SparseQUpperTriangular.resize(problem.num_vars(), problem.num_vars());
+                    for(typename Problem<T>::Index j = 0; j < problem.num_vars(); j++) {
+                        SparseQUpperTriangular.startVec(j);
+                        for(typename Problem<T>::Index i = 0; i <= j; i++) {
+                            if(Q(i, j) != T(0)) {
+                                SparseQUpperTriangular.insertBack(i, j) = Q(i, j);
+                            }
+                        }
+                    }
+                    SparseQUpperTriangular.finalize();
                 }
 
-            private:
-                typename Problem<T>::Vector previous_result;
-                bool initialized;
+                void upper_triangular_Q(const SparseProblem<T>& problem, Eigen::SparseMatrix<T>& SparseQUpperTriangular) {
+                    SparseQUpperTriangular = problem.Q();
+                }
 
-                OSQPSettings* settings;
+                /*
+                    Variables with a finite lower or upper limit. Limits OSQP
+                    treats as infinite do not need a constraint row.
+                */
+                template<typename ProblemType>
+                static void find_bounded_vars(const ProblemType& problem, std::vector<c_int>& vars) {
+                    vars.clear();
+                    for(typename Problem<T>::Index j = 0; j < problem.num_vars(); j++) {
+                        if(problem.lbx()(j) > T(-OSQP_INFTY) || problem.ubx()(j) < T(OSQP_INFTY)) {
+                            vars.push_back(j);
+                        }
+                    }
+                }
 
-                void loadResult(OSQPWorkspace* work, typename Problem<T>::Vector& result, typename Problem<T>::Index n) {
-                    result.resize(n);
-                    for(typename Problem<T>::Index i = 0; i < n; i++) {
-                        result(i) = work->solution->x[i];
+                /*
+                    A with a row of the identity appended below it for each
+                    variable in bounded_vars, so that the variable limits are
+                    enforced as constraints. Built column by column in O(nnz)
+                    for sparse problems and O(m n) for dense ones.
+                */
+                template<int NumVars, int MaxConstraints>
+                void augmented_A(const Problem<T, NumVars, MaxConstraints>& problem, Eigen::SparseMatrix<T>& SparseA) {
+                    const auto A = problem.A();
+                    typename Problem<T>::Index m = problem.num_constraints();
+                    SparseA.resize(m + bounded_vars.size(), problem.num_vars());
+
+                    std::size_t k = 0;
+                    for(typename Problem<T>::Index j = 0; j < problem.num_vars(); j++) {
+                        SparseA.startVec(j);
+                        for(typename Problem<T>::Index i = 0; i < m; i++) {
+                            if(A(i, j) != T(0)) {
+                                SparseA.insertBack(i, j) = A(i, j);
+                            }
+                        }
+                        if(k < bounded_vars.size() && bounded_vars[k] == j) {
+                            SparseA.insertBack(m + k, j) = T(1);
+                            k++;
+                        }
+                    }
+                    SparseA.finalize();
+                }
+
+                void augmented_A(const SparseProblem<T>& problem, Eigen::SparseMatrix<T>& SparseA) {
+                    const auto& A = problem.A();
+                    typename Problem<T>::Index m = problem.num_constraints();
+                    SparseA.resize(m + bounded_vars.size(), problem.num_vars());
+                    SparseA.reserve(A.nonZeros() + bounded_vars.size());
+
+                    std::size_t k = 0;
+                    for(typename Problem<T>::Index j = 0; j < A.outerSize(); j++) {
+                        SparseA.startVec(j);
+                        for(typename SparseProblem<T>::SparseMatrix::InnerIterator it(A, j); it; ++it) {
+                            SparseA.insertBack(it.row(), j) = it.value();
+                        }
+                        if(k < bounded_vars.size() && bounded_vars[k] == j) {
+                            SparseA.insertBack(m + k, j) = T(1);
+                            k++;
+                        }
+                    }
+                    SparseA.finalize();
+                }
+
+                /*
+                    Limits of the constraints of augmented_A, clamped to the
+                    range OSQP treats as finite.
+                */
+                template<typename ProblemType>
+                void augmented_bounds(const ProblemType& problem) {
+                    typename Problem<T>::Index m = problem.num_constraints();
+                    lower.resize(m + bounded_vars.size());
+                    upper.resize(m + bounded_vars.size());
+                    lower.head(m) = problem.lb();
+                    upper.head(m) = problem.ub();
+                    for(std::size_t k = 0; k < bounded_vars.size(); k++) {
+                        lower(m + k) = problem.lbx()(bounded_vars[k]);
+                        upper(m + k) = problem.ubx()(bounded_vars[k]);
                     }
+                    lower = lower.cwiseMax(T(-OSQP_INFTY));
+                    upper = upper.cwiseMin(T(OSQP_INFTY));
                 }
 
-                // OSQPData* setup_osqp_data(const Problem<T>& problem) {
-                //     OSQPData* data = static_cast<OSQPData*>(c_malloc(sizeof(OSQPData)));
-
-                //     data->n = problem.num_vars();
-
-                //     typename Problem<T>::Matrix QUpperTriangular = problem.Q().template triangularView<Eigen::Upper>();
-                //     Eigen::SparseMatrix<T> SparseQUpperTriangular = QUpperTriangular.sparseView();
-                //     SparseQUpperTriangular.makeCompressed();
-                //     data->P = csc_matrix(
-                //         problem.num_vars(),
-                //         problem.num_vars(),
-                //         SparseQUpperTriangular.nonZeros(),
-                //         SparseQUpperTriangular.valuePtr(),
-                //         SparseQUpperTriangular.innerIndexPtr(),
-                //         SparseQUpperTriangular.outerIndexPtr()
-                //     );
-
-                //     // data->q = static_cast<c_float*>(c_malloc(sizeof(T) * problem.num_vars()));
-                //     // std::memcpy(data->q, problem.c().data(), problem.num_vars() * sizeof(T));
-                //     data->q = const_cast<T*>(problem.c().data());
-
-                //     typename Problem<T>::Matrix A = problem.A();
-                //     typename Problem<T>::Vector lb = problem.lb();
-                //     typename Problem<T>::Vector ub = problem.ub();
-                //     A.conservativeResize(problem.num_constraints() + problem.num_vars(), Eigen::NoChange_t());
-                //     lb.conservativeResize(problem.num_constraints() + problem.num_vars());
-                //     ub.conservativeResize(problem.num_constraints() + problem.num_vars());
-                //     A.block(problem.num_constraints(), 0, problem.num_vars(), problem.num_vars()).setIdentity();
-                //     lb.block(problem.num_constraints(), 0, problem.num_vars(), 1) = problem.lbx();
-                //     ub.block(problem.num_constraints(), 0, problem.num_vars(), 1) = problem.ubx();
-                //     Eigen::SparseMatrix<T> SparseA = A.sparseView();
-                //     SparseA.makeCompressed();
-                //     data->m = A.rows();
-                //     data->A = csc_matrix(
-                //         A.rows(),
-                //         A.cols(),
-                //         SparseA.nonZeros(),
-                //         SparseA.valuePtr(),
-                //         SparseA.innerIndexPtr(),
-                //         SparseA.outerIndexPtr()
-                //     );
-
-                //     data->l = lb.data();
-                //     data->u = ub.data();
-
-                //     return data;
-                // }
-
-                void free_osqp_data(OSQPData* data) {
+                void free_osqp_data(typename OSQPLib::Data* data) {
                     c_free(data->P);
-                    c_free(data->q);
                     c_free(data->A);
                     c_free(data);
                 }
@@ -0,0 +1,1099 @@
+#ifndef QPWRAPPERS_OSQP_CODEGEN_HPP
+#define QPWRAPPERS_OSQP_CODEGEN_HPP
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <Eigen/OrderingMethods>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "problem.hpp"
+#include "scaling.hpp"
+#include "sparse_problem.hpp"
+
+
+namespace QPWrappers {
+    namespace OSQP {
+
+        /*
+            Settings of generated solvers, named after the OSQP settings they
+            correspond to and with the same defaults. scaling is the number of
+            Ruiz equilibration iterations, 0 for no scaling. rho is adapted
+            every 4 check_termination iterations.
+        */
+        struct CodegenSettings {
+            double rho = 0.1;
+            double sigma = 1e-6;
+            double alpha = 1.6;
+            double eps_abs = 1e-3;
+            double eps_rel = 1e-3;
+            int max_iter = 4000;
+            int check_termination = 25;
+            int scaling = 10;
+            bool adaptive_rho = true;
+            double adaptive_rho_tolerance = 5;
+        };
+
+        namespace codegen_detail {
+
+            /*
+                Elimination tree and column pointers of L in the LDL^T
+                factorization of the matrix with upper triangle pattern Kp, Ki.
+            */
+            inline void ldl_symbolic(int K, const std::vector<int>& Kp, const std::vector<int>& Ki,
+                                     std::vector<int>& etree, std::vector<int>& Lp) {
+                std::vector<int> flag(K), Lnz(K, 0);
+                etree.assign(K, -1);
+                for(int k = 0; k < K; k++) {
+                    flag[k] = k;
+                    for(int p = Kp[k]; p < Kp[k + 1]; p++) {
+                        for(int i = Ki[p]; i < k && flag[i] != k; i = etree[i]) {
+                            if(etree[i] == -1) {
+                                etree[i] = k;
+                            }
+                            Lnz[i]++;
+                            flag[i] = k;
+                        }
+                    }
+                }
+                Lp.assign(K + 1, 0);
+                for(int k = 0; k < K; k++) {
+                    Lp[k + 1] = Lp[k] + Lnz[k];
+                }
+            }
+
+            /*
+                Up-looking LDL^T factorization, the same as the one emitted
+                into generated solvers. Returns false on a zero pivot.
+            */
+            template<typename T>
+            bool ldl_numeric(int K, const std::vector<int>& Kp, const std::vector<int>& Ki, const std::vector<T>& Kx,
+                             const std::vector<int>& etree, const std::vector<int>& Lp,
+                             std::vector<int>& Li, std::vector<T>& Lx, std::vector<T>& Ld) {
+                std::vector<int> flag(K), pattern(K), Lnz(K);
+                std::vector<T> Y(K, T(0));
+                Li.assign(Lp[K], 0);
+                Lx.assign(Lp[K], T(0));
+                Ld.assign(K, T(0));
+                for(int k = 0; k < K; k++) {
+                    int top = K;
+                    Y[k] = 0;
+                    flag[k] = k;
+                    Lnz[k] = 0;
+                    for(int p = Kp[k]; p < Kp[k + 1]; p++) {
+                        int i = Ki[p];
+                        Y[i] += Kx[p];
+                        int len = 0;
+                        for(; flag[i] != k; i = etree[i]) {
+                            pattern[len++] = i;
+                            flag[i] = k;
+                        }
+                        while(len > 0) {
+                            pattern[--top] = pattern[--len];
+                        }
+                    }
+                    Ld[k] = Y[k];
+                    Y[k] = 0;
+                    for(; top < K; top++) {
+                        int i = pattern[top];
+                        T yi = Y[i];
+                        Y[i] = 0;
+                        int p = Lp[i];
+                        for(; p < Lp[i] + Lnz[i]; p++) {
+                            Y[Li[p]] -= Lx[p] * yi;
+                        }
+                        T l_ki = yi / Ld[i];
+                        Ld[k] -= l_ki * yi;
+                        Li[p] = k;
+                        Lx[p] = l_ki;
+                        Lnz[i]++;
+                    }
+                    if(Ld[k] == 0) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            /*
+                Body of generated solvers after their data. UPREFIX and PREFIX
+                are replaced by the upper case prefix and the prefix of the
+                solver.
+            */
+            constexpr const char* solver_source = R"(
+static PREFIX_float absolute(PREFIX_float value) {
+    return value < 0 ? -value : value;
+}
+
+static PREFIX_float maximum(PREFIX_float a, PREFIX_float b) {
+    return a > b ? a : b;
+}
+
+static PREFIX_float scale_limit(PREFIX_float value, PREFIX_float scale) {
+    if(value <= -INFTY) {
+        return -INFTY;
+    }
+    if(value >= INFTY) {
+        return INFTY;
+    }
+    return value * scale;
+}
+
+/*
+    Sets the rho of each row from the type of its limits as OSQP does.
+    Returns 1 if the type of a row changed.
+*/
+static int update_rho_vec(void) {
+    int changed = 0;
+    for(int r = 0; r < R; r++) {
+        int type;
+        if(l[r] < -INFTY * MIN_SCALING && u[r] > INFTY * MIN_SCALING) {
+            type = -1;
+            rho_vec[r] = RHO_MIN;
+        } else if(u[r] - l[r] < RHO_TOL) {
+            type = 1;
+            rho_vec[r] = RHO_EQ_OVER_RHO_INEQ * rho;
+        } else {
+            type = 0;
+            rho_vec[r] = rho;
+        }
+        rho_inv_vec[r] = 1 / rho_vec[r];
+        changed |= type != constraint_type[r];
+        constraint_type[r] = type;
+    }
+    return changed;
+}
+
+/*
+    Assembles the permuted KKT matrix
+        [P + sigma I        A^T     ]
+        [     A       -diag(1/rho)  ]
+    and factors it. Returns 0, or -1 on a zero pivot.
+*/
+static int factor(void) {
+    factorization_failed = 1;
+    for(int p = 0; p < KKT_NNZ; p++) {
+        KKT_x[p] = 0;
+    }
+    for(int j = 0; j < N; j++) {
+        KKT_x[P_diag_slot[j]] = SIGMA;
+    }
+    for(int p = 0; p < Q_NNZ; p++) {
+        KKT_x[Q_slot[p]] += Q_x[p];
+    }
+    for(int p = 0; p < A_NNZ; p++) {
+        KKT_x[A_slot[p]] = A_x[p];
+    }
+    for(int k = 0; k < B; k++) {
+        KKT_x[bound_slot[k]] = 1;
+    }
+    for(int r = 0; r < R; r++) {
+        KKT_x[rho_slot[r]] = -rho_inv_vec[r];
+    }
+
+    for(int k = 0; k < K; k++) {
+        int top = K;
+        Y[k] = 0;
+        flag[k] = k;
+        L_nz[k] = 0;
+        for(int p = KKT_p[k]; p < KKT_p[k + 1]; p++) {
+            int i = KKT_i[p];
+            int len = 0;
+            Y[i] += KKT_x[p];
+            for(; flag[i] != k; i = etree[i]) {
+                pattern[len++] = i;
+                flag[i] = k;
+            }
+            while(len > 0) {
+                pattern[--top] = pattern[--len];
+            }
+        }
+        L_d[k] = Y[k];
+        Y[k] = 0;
+        for(; top < K; top++) {
+            int i = pattern[top];
+            int p = L_p[i];
+            PREFIX_float yi = Y[i], l_ki;
+            Y[i] = 0;
+            for(; p < L_p[i] + L_nz[i]; p++) {
+                Y[L_i[p]] -= L_x[p] * yi;
+            }
+            l_ki = yi / L_d[i];
+            L_d[k] -= l_ki * yi;
+            L_i[p] = k;
+            L_x[p] = l_ki;
+            L_nz[i]++;
+        }
+        if(L_d[k] == 0) {
+            return -1;
+        }
+    }
+    factorization_failed = 0;
+    return 0;
+}
+
+/*
+    Solves the KKT system in place.
+*/
+static void kkt_solve(PREFIX_float* b) {
+    for(int i = 0; i < K; i++) {
+        work[perm[i]] = b[i];
+    }
+    for(int j = 0; j < K; j++) {
+        for(int p = L_p[j]; p < L_p[j + 1]; p++) {
+            work[L_i[p]] -= L_x[p] * work[j];
+        }
+    }
+    for(int j = 0; j < K; j++) {
+        work[j] /= L_d[j];
+    }
+    for(int j = K - 1; j >= 0; j--) {
+        for(int p = L_p[j]; p < L_p[j + 1]; p++) {
+            work[j] -= L_x[p] * work[L_i[p]];
+        }
+    }
+    for(int i = 0; i < K; i++) {
+        b[i] = work[perm[i]];
+    }
+}
+
+/*
+    Computes the primal and dual residuals of x, z, y and the norms they
+    are compared with, unscaled and scaled.
+*/
+static void compute_residuals(void) {
+    prim_res = prim_norm = dual_res = dual_norm = 0;
+    scaled_prim_res = scaled_prim_norm = scaled_dual_res = scaled_dual_norm = 0;
+
+    for(int r = 0; r < R; r++) {
+        Ax[r] = 0;
+    }
+    for(int j = 0; j < N; j++) {
+        Px[j] = 0;
+        Aty[j] = 0;
+    }
+    for(int j = 0; j < N; j++) {
+        for(int p = PREFIX_A_col_ptr[j]; p < PREFIX_A_col_ptr[j + 1]; p++) {
+            Ax[PREFIX_A_row_idx[p]] += A_x[p] * x[j];
+            Aty[j] += A_x[p] * y[PREFIX_A_row_idx[p]];
+        }
+        for(int p = PREFIX_Q_col_ptr[j]; p < PREFIX_Q_col_ptr[j + 1]; p++) {
+            int i = PREFIX_Q_row_idx[p];
+            Px[i] += Q_x[p] * x[j];
+            if(i != j) {
+                Px[j] += Q_x[p] * x[i];
+            }
+        }
+    }
+    for(int k = 0; k < B; k++) {
+        Ax[M + k] = x[bounded[k]];
+        Aty[bounded[k]] += y[M + k];
+    }
+
+    for(int r = 0; r < R; r++) {
+        PREFIX_float residual = Ax[r] - z[r];
+        prim_res = maximum(prim_res, absolute(residual * E_inv[r]));
+        prim_norm = maximum(prim_norm, maximum(absolute(Ax[r] * E_inv[r]), absolute(z[r] * E_inv[r])));
+        scaled_prim_res = maximum(scaled_prim_res, absolute(residual));
+        scaled_prim_norm = maximum(scaled_prim_norm, maximum(absolute(Ax[r]), absolute(z[r])));
+    }
+    for(int j = 0; j < N; j++) {
+        PREFIX_float residual = Px[j] + q[j] + Aty[j];
+        PREFIX_float norm = maximum(absolute(Px[j]), maximum(absolute(Aty[j]), absolute(q[j])));
+        dual_res = maximum(dual_res, absolute(residual * D_inv[j]));
+        dual_norm = maximum(dual_norm, norm * D_inv[j]);
+        scaled_dual_res = maximum(scaled_dual_res, absolute(residual));
+        scaled_dual_norm = maximum(scaled_dual_norm, norm);
+    }
+    dual_res *= COST_SCALE_INV;
+    dual_norm *= COST_SCALE_INV;
+}
+
+static int converged(void) {
+    return prim_res <= EPS_ABS + EPS_REL * prim_norm
+        && dual_res <= EPS_ABS + EPS_REL * dual_norm;
+}
+
+/*
+    Balances the scaled residuals by changing rho as OSQP does, refactoring
+    if it changes by more than ADAPTIVE_RHO_TOLERANCE. Returns 0, or -1 on
+    a failed factorization.
+*/
+static int adapt_rho(void) {
+    PREFIX_float ratio = (scaled_prim_res / (scaled_prim_norm + DIVISION_TOL))
+                       / (scaled_dual_res / (scaled_dual_norm + DIVISION_TOL) + DIVISION_TOL);
+    PREFIX_float estimate = rho * sqrt(ratio);
+    if(estimate < RHO_MIN) {
+        estimate = RHO_MIN;
+    } else if(estimate > RHO_MAX) {
+        estimate = RHO_MAX;
+    }
+    if(estimate > rho * ADAPTIVE_RHO_TOLERANCE || estimate < rho / ADAPTIVE_RHO_TOLERANCE) {
+        rho = estimate;
+        update_rho_vec();
+        return factor();
+    }
+    return 0;
+}
+
+static void store_solution(void) {
+    for(int j = 0; j < N; j++) {
+        x_out[j] = D[j] * x[j];
+        z_out[j] = 0;
+    }
+    for(int i = 0; i < M; i++) {
+        y_out[i] = E[i] * y[i] * COST_SCALE_INV;
+    }
+    for(int k = 0; k < B; k++) {
+        z_out[bounded[k]] = E[M + k] * y[M + k] * COST_SCALE_INV;
+    }
+}
+
+int PREFIX_update_c(const PREFIX_float* c) {
+    for(int j = 0; j < N; j++) {
+        q[j] = COST_SCALE * D[j] * c[j];
+    }
+    return 0;
+}
+
+int PREFIX_update_limits(const PREFIX_float* lb, const PREFIX_float* ub) {
+    for(int i = 0; i < M; i++) {
+        if(lb[i] > ub[i]) {
+            return 1;
+        }
+    }
+    for(int i = 0; i < M; i++) {
+        l[i] = scale_limit(lb[i], E[i]);
+        u[i] = scale_limit(ub[i], E[i]);
+    }
+    if(update_rho_vec()) {
+        return factor();
+    }
+    return 0;
+}
+
+int PREFIX_update_var_limits(const PREFIX_float* lbx, const PREFIX_float* ubx) {
+    for(int j = 0; j < N; j++) {
+        if(lbx[j] > ubx[j]) {
+            return 1;
+        }
+        if(var_row[j] < 0 && (lbx[j] > -INFTY || ubx[j] < INFTY)) {
+            return 1;
+        }
+    }
+    for(int k = 0; k < B; k++) {
+        l[M + k] = scale_limit(lbx[bounded[k]], E[M + k]);
+        u[M + k] = scale_limit(ubx[bounded[k]], E[M + k]);
+    }
+    if(update_rho_vec()) {
+        return factor();
+    }
+    return 0;
+}
+
+int PREFIX_update_Q(const PREFIX_float* Q_values) {
+    for(int j = 0; j < N; j++) {
+        for(int p = PREFIX_Q_col_ptr[j]; p < PREFIX_Q_col_ptr[j + 1]; p++) {
+            Q_x[p] = COST_SCALE * D[PREFIX_Q_row_idx[p]] * D[j] * Q_values[p];
+        }
+    }
+    return factor();
+}
+
+int PREFIX_update_A(const PREFIX_float* A_values) {
+    for(int j = 0; j < N; j++) {
+        for(int p = PREFIX_A_col_ptr[j]; p < PREFIX_A_col_ptr[j + 1]; p++) {
+            A_x[p] = E[PREFIX_A_row_idx[p]] * D[j] * A_values[p];
+        }
+    }
+    return factor();
+}
+
+void PREFIX_warm_start_x(const PREFIX_float* x_guess) {
+    for(int j = 0; j < N; j++) {
+        x[j] = D_inv[j] * x_guess[j];
+    }
+}
+
+int PREFIX_solve(void) {
+    int status = UPREFIX_MAX_ITER_REACHED;
+
+    if(factorization_failed) {
+        return UPREFIX_UNSOLVED;
+    }
+
+    for(iterations = 1; iterations <= MAX_ITER; iterations++) {
+        for(int j = 0; j < N; j++) {
+            x_prev[j] = x[j];
+            rhs[j] = SIGMA * x[j] - q[j];
+        }
+        for(int r = 0; r < R; r++) {
+            z_prev[r] = z[r];
+            rhs[N + r] = z[r] - rho_inv_vec[r] * y[r];
+        }
+        kkt_solve(rhs);
+
+        for(int j = 0; j < N; j++) {
+            x[j] = ALPHA * rhs[j] + (1 - ALPHA) * x_prev[j];
+        }
+        for(int r = 0; r < R; r++) {
+            PREFIX_float z_tilde = z_prev[r] + rho_inv_vec[r] * (rhs[N + r] - y[r]);
+            PREFIX_float z_relaxed = ALPHA * z_tilde + (1 - ALPHA) * z_prev[r];
+            PREFIX_float projected = z_relaxed + rho_inv_vec[r] * y[r];
+            if(projected < l[r]) {
+                projected = l[r];
+            } else if(projected > u[r]) {
+                projected = u[r];
+            }
+            z[r] = projected;
+            y[r] += rho_vec[r] * (z_relaxed - z[r]);
+        }
+
+        if(iterations % CHECK_TERMINATION == 0 || iterations == MAX_ITER) {
+            compute_residuals();
+            if(converged()) {
+                status = UPREFIX_SOLVED;
+                break;
+            }
+            if(ADAPTIVE_RHO && iterations % ADAPTIVE_RHO_INTERVAL == 0 && adapt_rho() != 0) {
+                status = UPREFIX_UNSOLVED;
+                break;
+            }
+        }
+    }
+    if(iterations > MAX_ITER) {
+        iterations = MAX_ITER;
+    }
+
+    store_solution();
+    return status;
+}
+
+int PREFIX_iterations(void) {
+    return iterations;
+}
+
+const PREFIX_float* PREFIX_solution(void) {
+    return x_out;
+}
+
+const PREFIX_float* PREFIX_constraint_duals(void) {
+    return y_out;
+}
+
+const PREFIX_float* PREFIX_variable_duals(void) {
+    return z_out;
+}
+)";
+
+            inline std::string replace_all(std::string text, const std::string& from, const std::string& to) {
+                for(std::size_t position = text.find(from); position != std::string::npos;
+                    position = text.find(from, position + to.size())) {
+                    text.replace(position, from.size(), to);
+                }
+                return text;
+            }
+        }
+
+        /**
+            Generates a self-contained C solver for problems with the sparsity
+            pattern of a representative Problem or SparseProblem, in the style
+            of the embedded mode of OSQP.
+
+            The generated solver runs the ADMM iterations of OSQP, adapting
+            rho as OSQP does, on the problem scaled by the Ruiz equilibration
+            of the representative problem, without polishing or infeasibility
+            detection. Its data, the sparse LDL^T factorization of its KKT
+            matrix included, is computed here and emitted as static arrays,
+            so it has no setup, does not allocate and does not depend on
+            OSQP or Eigen. c and the limits are updated without and Q and A
+            with a numeric refactorization, whose symbolic part is fixed by
+            the AMD ordering computed here. A change of the limits that
+            turns a constraint into an equality or removes its limits
+            refactors as well, since OSQP gives those rows a different rho.
+
+            The patterns of Q and A are the nonzero entries of the
+            representative problem, or the stored entries of a SparseProblem,
+            so it should have every entry that can become nonzero. Variables
+            with no finite limit in it must keep having none, as in the OSQP
+            engine they have no constraint row.
+
+            write(directory, prefix) writes prefix.h and prefix.c, whose
+            functions and types start with prefix. The qpwrappers_add_generated_solver
+            CMake function in cmake/QPWrappersCodegen.cmake builds them into a
+            library target as part of a build.
+        */
+        template<typename ProblemType>
+        class CodeGenerator {
+            public:
+                using T = typename ProblemType::Scalar;
+                using Index = Eigen::Index;
+                using Vector = typename Problem<T>::Vector;
+
+                explicit CodeGenerator(const ProblemType& problem, const CodegenSettings& settings = CodegenSettings()):
+                        settings(settings) {
+                    n = static_cast<int>(problem.num_vars());
+                    m = static_cast<int>(problem.num_constraints());
+
+                    patterns(problem);
+                    find_bounded_vars(problem);
+                    scale(problem);
+                    set_rho_vec();
+                    build_kkt();
+
+                    codegen_detail::ldl_symbolic(n + rows(), KKT_p, KKT_i, etree, L_p);
+                    if(!codegen_detail::ldl_numeric(n + rows(), KKT_p, KKT_i, KKT_x, etree, L_p, L_i, L_x, L_d)) {
+                        throw std::domain_error("KKT matrix of the problem has a zero pivot.");
+                    }
+                }
+
+                /*
+                    Writes the solver to directory/prefix.h and directory/prefix.c.
+                    prefix must be a C identifier.
+                */
+                void write(const std::string& directory, const std::string& prefix) const {
+                    check_prefix(prefix);
+                    std::string base = directory.empty() ? prefix : directory + "/" + prefix;
+
+                    std::ofstream header(base + ".h");
+                    write_header(header, prefix);
+                    header.close();
+                    if(!header) {
+                        throw std::runtime_error(std::string("could not write ") + base + ".h");
+                    }
+
+                    std::ofstream source(base + ".c");
+                    write_source(source, prefix);
+                    source.close();
+                    if(!source) {
+                        throw std::runtime_error(std::string("could not write ") + base + ".c");
+                    }
+                }
+
+                void write_header(std::ostream& os, const std::string& prefix) const {
+                    std::string upper = upper_case(prefix);
+                    std::string text = R"(#ifndef UPREFIX_H
+#define UPREFIX_H
+
+/*
+    Solver generated by QPWrappers::OSQP::CodeGenerator for
+        minimize    1/2 x^T Q x + c^T x
+        subject to  lb <= A x <= ub
+                    lbx <= x <= ubx
+    with the sparsity patterns of Q and A fixed. Q is given by the values
+    of its upper triangle in the CSC pattern PREFIX_Q_col_ptr, PREFIX_Q_row_idx,
+    and A by its values in the CSC pattern PREFIX_A_col_ptr, PREFIX_A_row_idx.
+    Only variables that had a finite limit when the solver was generated
+    may have finite limits. Limits at or beyond 1e30 are infinite.
+
+    Update functions return 0, or nonzero if the update is rejected or
+    the KKT matrix could not be factored. All data is static, so the
+    solver does not allocate and can be used by one thread at a time.
+    Every solve starts from the result of the previous one.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UPREFIX_SOLVED 1
+#define UPREFIX_MAX_ITER_REACHED (-2)
+#define UPREFIX_UNSOLVED (-10)
+
+)";
+                    os << with_prefix(text, prefix);
+                    os << "#define " << upper << "_NUM_VARS " << n << "\n";
+                    os << "#define " << upper << "_NUM_CONSTRAINTS " << m << "\n";
+                    os << "#define " << upper << "_Q_NNZ " << Q_i.size() << "\n";
+                    os << "#define " << upper << "_A_NNZ " << A_i.size() << "\n\n";
+
+                    text = R"(typedef FLOAT PREFIX_float;
+
+extern const int PREFIX_Q_col_ptr[];
+extern const int PREFIX_Q_row_idx[];
+extern const int PREFIX_A_col_ptr[];
+extern const int PREFIX_A_row_idx[];
+
+int PREFIX_update_c(const PREFIX_float* c);
+int PREFIX_update_limits(const PREFIX_float* lb, const PREFIX_float* ub);
+int PREFIX_update_var_limits(const PREFIX_float* lbx, const PREFIX_float* ubx);
+int PREFIX_update_Q(const PREFIX_float* Q_values);
+int PREFIX_update_A(const PREFIX_float* A_values);
+
+/*
+    Starts the next solve from x_guess instead of the last result.
+*/
+void PREFIX_warm_start_x(const PREFIX_float* x_guess);
+
+/*
+    Returns UPREFIX_SOLVED, UPREFIX_MAX_ITER_REACHED, or UPREFIX_UNSOLVED if
+    the last update left the KKT matrix unfactored.
+*/
+int PREFIX_solve(void);
+int PREFIX_iterations(void);
+
+/*
+    Result of the last solve, and its duals for
+        Q x + c + A^T y + z = 0.
+*/
+const PREFIX_float* PREFIX_solution(void);
+const PREFIX_float* PREFIX_constraint_duals(void);
+const PREFIX_float* PREFIX_variable_duals(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+)";
+                    os << with_prefix(codegen_detail::replace_all(text, "FLOAT", float_type()), prefix);
+                }
+
+                void write_source(std::ostream& os, const std::string& prefix) const {
+                    os.precision(std::numeric_limits<T>::max_digits10);
+                    int R = rows(), K = n + R;
+
+                    os << "#include \"" << prefix << ".h\"\n";
+                    os << "#include <math.h>\n\n";
+                    os << "#define N " << n << "\n";
+                    os << "#define M " << m << "\n";
+                    os << "#define B " << bounded.size() << "\n";
+                    os << "#define R " << R << "\n";
+                    os << "#define K " << K << "\n";
+                    os << "#define Q_NNZ " << Q_i.size() << "\n";
+                    os << "#define A_NNZ " << A_i.size() << "\n";
+                    os << "#define KKT_NNZ " << KKT_i.size() << "\n\n";
+
+                    os << "#define SIGMA " << settings.sigma << "\n";
+                    os << "#define ALPHA " << settings.alpha << "\n";
+                    os << "#define EPS_ABS " << settings.eps_abs << "\n";
+                    os << "#define EPS_REL " << settings.eps_rel << "\n";
+                    os << "#define MAX_ITER " << settings.max_iter << "\n";
+                    os << "#define CHECK_TERMINATION " << std::max(settings.check_termination, 1) << "\n";
+                    os << "#define ADAPTIVE_RHO " << (settings.adaptive_rho ? 1 : 0) << "\n";
+                    os << "#define ADAPTIVE_RHO_INTERVAL " << 4 * std::max(settings.check_termination, 1) << "\n";
+                    os << "#define ADAPTIVE_RHO_TOLERANCE " << settings.adaptive_rho_tolerance << "\n";
+                    os << "#define COST_SCALE " << cost_scale << "\n";
+                    os << "#define COST_SCALE_INV " << T(1) / cost_scale << "\n\n";
+
+                    // constants of OSQP 0.6
+                    os << "#define INFTY 1e30\n";
+                    os << "#define RHO_MIN 1e-6\n";
+                    os << "#define RHO_MAX 1e6\n";
+                    os << "#define DIVISION_TOL 1e-30\n";
+                    os << "#define RHO_TOL 1e-4\n";
+                    os << "#define RHO_EQ_OVER_RHO_INEQ 1e3\n";
+                    os << "#define MIN_SCALING 1e-4\n\n";
+
+                    std::string type = prefix + "_float";
+                    write_array(os, "const int", prefix + "_Q_col_ptr", Q_p);
+                    write_array(os, "const int", prefix + "_Q_row_idx", Q_i);
+                    write_array(os, "const int", prefix + "_A_col_ptr", A_p);
+                    write_array(os, "const int", prefix + "_A_row_idx", A_i);
+                    os << "\n";
+
+                    // scaling and data of the scaled problem
+                    write_array(os, "static const " + type, "D", D);
+                    write_array(os, "static const " + type, "D_inv", inverse(D));
+                    write_array(os, "static const " + type, "E", E);
+                    write_array(os, "static const " + type, "E_inv", inverse(E));
+                    write_array(os, "static const int", "bounded", bounded);
+                    write_array(os, "static const int", "var_row", var_row);
+                    write_array(os, "static " + type, "Q_x", Q_x);
+                    write_array(os, "static " + type, "A_x", A_x);
+                    write_array(os, "static " + type, "q", q);
+                    write_array(os, "static " + type, "l", l);
+                    write_array(os, "static " + type, "u", u);
+                    os << "static " << type << " rho = " << settings.rho << ";\n";
+                    write_array(os, "static " + type, "rho_vec", rho_vec);
+                    write_array(os, "static " + type, "rho_inv_vec", inverse(rho_vec));
+                    write_array(os, "static int", "constraint_type", constraint_type);
+                    os << "\n";
+
+                    // permuted KKT matrix, where the entries of each part go
+                    write_array(os, "static const int", "perm", perm);
+                    write_array(os, "static const int", "KKT_p", KKT_p);
+                    write_array(os, "static const int", "KKT_i", KKT_i);
+                    write_array(os, "static " + type, "KKT_x", KKT_x);
+                    write_array(os, "static const int", "P_diag_slot", P_diag_slot);
+                    write_array(os, "static const int", "Q_slot", Q_slot);
+                    write_array(os, "static const int", "A_slot", A_slot);
+                    write_array(os, "static const int", "bound_slot", bound_slot);
+                    write_array(os, "static const int", "rho_slot", rho_slot);
+                    os << "\n";
+
+                    // factorization of the KKT matrix
+                    write_array(os, "static const int", "etree", etree);
+                    write_array(os, "static const int", "L_p", L_p);
+                    write_array(os, "static int", "L_i", L_i);
+                    write_array(os, "static " + type, "L_x", L_x);
+                    write_array(os, "static " + type, "L_d", L_d);
+                    os << "static int factorization_failed = 0;\n\n";
+
+                    // iterates and work arrays
+                    write_zeros(os, "int", "L_nz", K);
+                    write_zeros(os, "int", "flag", K);
+                    write_zeros(os, "int", "pattern", K);
+                    write_zeros(os, type, "Y", K);
+                    write_zeros(os, type, "work", K);
+                    write_zeros(os, type, "rhs", K);
+                    write_zeros(os, type, "x", n);
+                    write_zeros(os, type, "x_prev", n);
+                    write_zeros(os, type, "z", R);
+                    write_zeros(os, type, "z_prev", R);
+                    write_zeros(os, type, "y", R);
+                    write_zeros(os, type, "Ax", R);
+                    write_zeros(os, type, "Px", n);
+                    write_zeros(os, type, "Aty", n);
+                    write_zeros(os, type, "x_out", n);
+                    write_zeros(os, type, "y_out", m);
+                    write_zeros(os, type, "z_out", n);
+                    os << "static " << type << " prim_res, prim_norm, dual_res, dual_norm;\n";
+                    os << "static " << type << " scaled_prim_res, scaled_prim_norm, scaled_dual_res, scaled_dual_norm;\n";
+                    os << "static int iterations = 0;\n";
+
+                    os << with_prefix(codegen_detail::solver_source, prefix);
+                }
+
+                /*
+                    Number of nonzeros of the L factor of the KKT matrix.
+                */
+                Index factor_nonzeros() const {
+                    return static_cast<Index>(L_i.size());
+                }
+
+            private:
+                CodegenSettings settings;
+                int n, m;
+
+                // upper triangle of Q and A in CSC, values of the representative problem
+                std::vector<int> Q_p, Q_i, A_p, A_i;
+                std::vector<T> Q_values, A_values;
+
+                // variables with a finite limit, which have rows after those of
+                // A, and the index of the row of each variable in them or -1
+                std::vector<int> bounded, var_row;
+
+                // scaling, where E holds 1 / D of the variable of each limit row,
+                // and the scaled problem
+                std::vector<T> D, E, Q_x, A_x, q, l, u, rho_vec;
+                T cost_scale;
+                std::vector<int> constraint_type;
+
+                // permuted upper triangle of the KKT matrix, slots of its parts,
+                // and its factorization
+                std::vector<int> perm, KKT_p, KKT_i;
+                std::vector<T> KKT_x;
+                std::vector<int> P_diag_slot, Q_slot, A_slot, bound_slot, rho_slot;
+                std::vector<int> etree, L_p, L_i;
+                std::vector<T> L_x, L_d;
+
+                int rows() const {
+                    return m + static_cast<int>(bounded.size());
+                }
+
+                static bool is_finite_limit(T value) {
+                    return value > T(-1e30) && value < T(1e30);
+                }
+
+                template<int NumVars, int MaxConstraints>
+                void patterns(const Problem<T, NumVars, MaxConstraints>& problem) {
+                    Q_p.assign(1, 0);
+                    A_p.assign(1, 0);
+                    for(int j = 0; j < n; j++) {
+                        for(int i = 0; i <= j; i++) {
+                            if(problem.Q()(i, j) != 0) {
+                                Q_i.push_back(i);
+                                Q_values.push_back(problem.Q()(i, j));
+                            }
+                        }
+                        Q_p.push_back(static_cast<int>(Q_i.size()));
+                        for(int i = 0; i < m; i++) {
+                            if(problem.A()(i, j) != 0) {
+                                A_i.push_back(i);
+                                A_values.push_back(problem.A()(i, j));
+                            }
+                        }
+                        A_p.push_back(static_cast<int>(A_i.size()));
+                    }
+                }
+
+                void patterns(const SparseProblem<T>& problem) {
+                    using SparseMatrix = typename SparseProblem<T>::SparseMatrix;
+                    Q_p.assign(1, 0);
+                    A_p.assign(1, 0);
+                    for(int j = 0; j < n; j++) {
+                        for(typename SparseMatrix::InnerIterator it(problem.Q(), j); it; ++it) {
+                            Q_i.push_back(static_cast<int>(it.row()));
+                            Q_values.push_back(it.value());
+                        }
+                        Q_p.push_back(static_cast<int>(Q_i.size()));
+                        for(typename SparseMatrix::InnerIterator it(problem.A(), j); it; ++it) {
+                            A_i.push_back(static_cast<int>(it.row()));
+                            A_values.push_back(it.value());
+                        }
+                        A_p.push_back(static_cast<int>(A_i.size()));
+                    }
+                }
+
+                void find_bounded_vars(const ProblemType& problem) {
+                    var_row.assign(n, -1);
+                    for(int j = 0; j < n; j++) {
+                        if(is_finite_limit(problem.lbx()(j)) || is_finite_limit(problem.ubx()(j))) {
+                            var_row[j] = static_cast<int>(bounded.size());
+                            bounded.push_back(j);
+                        }
+                    }
+                }
+
+                static T scale_limit(T value, T scale) {
+                    if(!is_finite_limit(value)) {
+                        return value < 0 ? T(-1e30) : T(1e30);
+                    }
+                    return value * scale;
+                }
+
+                void scale(const ProblemType& problem) {
+                    Vector variable_scaling = Vector::Ones(n), constraint_scaling = Vector::Ones(m);
+                    cost_scale = 1;
+                    if(settings.scaling > 0) {
+                        Scaling<ProblemType> scaling(settings.scaling);
+                        scaling.scale(problem);
+                        variable_scaling = scaling.variable_scaling();
+                        constraint_scaling = scaling.constraint_scaling();
+                        cost_scale = scaling.cost_scaling();
+                    }
+
+                    D.assign(variable_scaling.data(), variable_scaling.data() + n);
+                    E.assign(constraint_scaling.data(), constraint_scaling.data() + m);
+                    for(int j: bounded) {
+                        E.push_back(T(1) / D[j]);
+                    }
+
+                    Q_x.resize(Q_i.size());
+                    A_x.resize(A_i.size());
+                    q.resize(n);
+                    for(int j = 0; j < n; j++) {
+                        for(int p = Q_p[j]; p < Q_p[j + 1]; p++) {
+                            Q_x[p] = cost_scale * D[Q_i[p]] * D[j] * Q_values[p];
+                        }
+                        for(int p = A_p[j]; p < A_p[j + 1]; p++) {
+                            A_x[p] = E[A_i[p]] * D[j] * A_values[p];
+                        }
+                        q[j] = cost_scale * D[j] * problem.c()(j);
+                    }
+
+                    l.resize(rows());
+                    u.resize(rows());
+                    for(int i = 0; i < m; i++) {
+                        l[i] = scale_limit(problem.lb()(i), E[i]);
+                        u[i] = scale_limit(problem.ub()(i), E[i]);
+                    }
+                    for(std::size_t k = 0; k < bounded.size(); k++) {
+                        l[m + k] = scale_limit(problem.lbx()(bounded[k]), E[m + k]);
+                        u[m + k] = scale_limit(problem.ubx()(bounded[k]), E[m + k]);
+                    }
+                }
+
+                /*
+                    rho of each row as set by update_rho_vec of generated solvers.
+                */
+                void set_rho_vec() {
+                    rho_vec.resize(rows());
+                    constraint_type.resize(rows());
+                    for(int r = 0; r < rows(); r++) {
+                        if(l[r] < T(-1e30 * 1e-4) && u[r] > T(1e30 * 1e-4)) {
+                            constraint_type[r] = -1;
+                            rho_vec[r] = T(1e-6);
+                        } else if(u[r] - l[r] < T(1e-4)) {
+                            constraint_type[r] = 1;
+                            rho_vec[r] = T(1e3 * settings.rho);
+                        } else {
+                            constraint_type[r] = 0;
+                            rho_vec[r] = T(settings.rho);
+                        }
+                    }
+                }
+
+                /*
+                    Orders the KKT matrix by AMD and finds the slot of each of
+                    its entries in the upper triangle of the permuted matrix.
+                */
+                void build_kkt() {
+                    int R = rows(), K = n + R;
+
+                    // entries of the upper triangle of the unpermuted KKT matrix
+                    std::vector<std::pair<int, int>> entries;
+                    for(int j = 0; j < n; j++) {
+                        entries.emplace_back(j, j);
+                        for(int p = Q_p[j]; p < Q_p[j + 1]; p++) {
+                            entries.emplace_back(Q_i[p], j);
+                        }
+                        for(int p = A_p[j]; p < A_p[j + 1]; p++) {
+                            entries.emplace_back(j, n + A_i[p]);
+                        }
+                    }
+                    for(std::size_t k = 0; k < bounded.size(); k++) {
+                        entries.emplace_back(bounded[k], n + m + static_cast<int>(k));
+                    }
+                    for(int r = 0; r < R; r++) {
+                        entries.emplace_back(n + r, n + r);
+                    }
+
+                    std::vector<Eigen::Triplet<double>> triplets;
+                    triplets.reserve(entries.size());
+                    for(const auto& entry: entries) {
+                        triplets.emplace_back(entry.first, entry.second, 1.0);
+                    }
+                    Eigen::SparseMatrix<double> pattern(K, K);
+                    pattern.setFromTriplets(triplets.begin(), triplets.end());
+
+                    // AMD gives the inverse of the permutation that maps the
+                    // index of each row to its index in the permuted matrix
+                    Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> inverse_perm;
+                    Eigen::AMDOrdering<int> ordering;
+                    ordering(pattern, inverse_perm);
+                    Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> permutation = inverse_perm.inverse();
+                    perm.assign(permutation.indices().data(), permutation.indices().data() + K);
+
+                    // (col, row) of the permuted entries, sorted by column
+                    std::vector<std::pair<int, int>> permuted;
+                    permuted.reserve(entries.size());
+                    for(const auto& entry: entries) {
+                        permuted.push_back(permuted_position(entry));
+                    }
+                    std::sort(permuted.begin(), permuted.end());
+                    permuted.erase(std::unique(permuted.begin(), permuted.end()), permuted.end());
+
+                    KKT_p.assign(K + 1, 0);
+                    KKT_i.resize(permuted.size());
+                    for(std::size_t p = 0; p < permuted.size(); p++) {
+                        KKT_p[permuted[p].first + 1]++;
+                        KKT_i[p] = permuted[p].second;
+                    }
+                    for(int k = 0; k < K; k++) {
+                        KKT_p[k + 1] += KKT_p[k];
+                    }
+
+                    auto slot = [&](int row, int col) {
+                        auto position = permuted_position(std::make_pair(row, col));
+                        return static_cast<int>(std::lower_bound(permuted.begin(), permuted.end(), position) - permuted.begin());
+                    };
+                    P_diag_slot.resize(n);
+                    Q_slot.resize(Q_i.size());
+                    A_slot.resize(A_i.size());
+                    bound_slot.resize(bounded.size());
+                    rho_slot.resize(R);
+                    for(int j = 0; j < n; j++) {
+                        P_diag_slot[j] = slot(j, j);
+                        for(int p = Q_p[j]; p < Q_p[j + 1]; p++) {
+                            Q_slot[p] = slot(Q_i[p], j);
+                        }
+                        for(int p = A_p[j]; p < A_p[j + 1]; p++) {
+                            A_slot[p] = slot(j, n + A_i[p]);
+                        }
+                    }
+                    for(std::size_t k = 0; k < bounded.size(); k++) {
+                        bound_slot[k] = slot(bounded[k], n + m + static_cast<int>(k));
+                    }
+                    for(int r = 0; r < R; r++) {
+                        rho_slot[r] = slot(n + r, n + r);
+                    }
+
+                    // values as assembled by factor of generated solvers
+                    KKT_x.assign(KKT_i.size(), T(0));
+                    for(int j = 0; j < n; j++) {
+                        KKT_x[P_diag_slot[j]] = T(settings.sigma);
+                    }
+                    for(std::size_t p = 0; p < Q_x.size(); p++) {
+                        KKT_x[Q_slot[p]] += Q_x[p];
+                    }
+                    for(std::size_t p = 0; p < A_x.size(); p++) {
+                        KKT_x[A_slot[p]] = A_x[p];
+                    }
+                    for(int s: bound_slot) {
+                        KKT_x[s] = 1;
+                    }
+                    for(int r = 0; r < R; r++) {
+                        KKT_x[rho_slot[r]] = -(T(1) / rho_vec[r]);
+                    }
+                }
+
+                std::pair<int, int> permuted_position(const std::pair<int, int>& entry) const {
+                    int row = perm[entry.first], col = perm[entry.second];
+                    return std::make_pair(std::max(row, col), std::min(row, col));
+                }
+
+                static std::vector<T> inverse(const std::vector<T>& values) {
+                    std::vector<T> result(values.size());
+                    for(std::size_t i = 0; i < values.size(); i++) {
+                        result[i] = T(1) / values[i];
+                    }
+                    return result;
+                }
+
+                static std::string float_type() {
+                    return std::is_same<T, float>::value ? "float" : "double";
+                }
+
+                /*
+                    Replaces UPREFIX in text by the upper case prefix and then
+                    PREFIX by prefix.
+                */
+                static std::string with_prefix(const std::string& text, const std::string& prefix) {
+                    return codegen_detail::replace_all(codegen_detail::replace_all(text, "UPREFIX", upper_case(prefix)),
+                                                       "PREFIX", prefix);
+                }
+
+                static std::string upper_case(std::string name) {
+                    for(char& character: name) {
+                        if(character >= 'a' && character <= 'z') {
+                            character = static_cast<char>(character - 'a' + 'A');
+                        }
+                    }
+                    return name;
+                }
+
+                static void check_prefix(const std::string& prefix) {
+                    bool valid = !prefix.empty() && !(prefix[0] >= '0' && prefix[0] <= '9');
+                    for(char character: prefix) {
+                        valid = valid && ((character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z')
+                                          || (character >= '0' && character <= '9') || character == '_');
+                    }
+                    if(!valid) {
+                        throw std::domain_error(std::string("prefix ") + prefix + std::string(" is not a C identifier."));
+                    }
+                }
+
+                /*
+                    Writes an initialized array, with a single 0 if values is
+                    empty since C has no arrays of size 0.
+                */
+                template<typename V>
+                static void write_array(std::ostream& os, const std::string& qualifiers, const std::string& name,
+                                        const std::vector<V>& values) {
+                    os << qualifiers << " " << name << "[" << std::max<std::size_t>(values.size(), 1) << "] = {";
+                    for(std::size_t i = 0; i < values.size(); i++) {
+                        os << (i % 8 == 0 ? "\n    " : " ") << values[i] << (i + 1 < values.size() ? "," : "");
+                    }
+                    if(values.empty()) {
+                        os << "0";
+                    }
+                    os << "\n};\n";
+                }
+
+                static void write_zeros(std::ostream& os, const std::string& type, const std::string& name, int size) {
+                    os << "static " << type << " " << name << "[" << std::max(size, 1) << "];\n";
+                }
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,301 @@
+#ifndef QPWRAPPERS_PARAMETRIC_PROBLEM_HPP
+#define QPWRAPPERS_PARAMETRIC_PROBLEM_HPP
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "problem.hpp"
+#include "sparse_problem.hpp"
+#include "types.hpp"
+
+
+namespace QPWrappers {
+
+/**
+    A Problem or SparseProblem whose entries are affine functions of a
+    parameter vector theta.
+
+    The problem given to the constructor is the constant part. Terms
+    added with add_*_term make an entry depend on theta, so that the
+    entry of the instance is its value in the constant part plus the sum
+    of coeff * theta(param_idx) over its terms. Q terms are symmetric,
+    i.e. a term of Q(row, col) is also a term of Q(col, row).
+
+    instantiate(theta) writes only the entries with terms into the kept
+    instance and marks only the parts they belong to as modified, so an
+    engine given consecutive instances sees which parts changed, e.g.
+    only c and the limits.
+*/
+template<typename ProblemType>
+class ParametricProblem {
+    public:
+        using T = typename ProblemType::Scalar;
+        using Index = Eigen::Index;
+        using Parameters = Eigen::Matrix<T, Eigen::Dynamic, 1>;
+
+        ParametricProblem(const ProblemType& problem, Index num_params):
+                instance(problem),
+                parameter_count(num_params),
+                bound(false) {}
+
+        // the instance is pointed into, so it is not copied or moved along
+        ParametricProblem(const ParametricProblem& rhs) = delete;
+        ParametricProblem& operator=(const ParametricProblem& rhs) = delete;
+
+        inline Index num_params() const {
+            return parameter_count;
+        }
+
+        /*
+            Adds coeff * theta(param_idx) to Q(row, col) and Q(col, row).
+        */
+        void add_Q_term(Index row, Index col, Index param_idx, T coeff) {
+            check_index(row, instance.num_vars(), "row");
+            check_index(col, instance.num_vars(), "col");
+            Index r = std::min(row, col), c = std::max(row, col);
+            add_term(parts[QPart], r, c, instance.Q().coeff(r, c), param_idx, coeff);
+        }
+
+        /*
+            Adds coeff * theta(param_idx) to A(constraint_idx, var_idx).
+        */
+        void add_A_term(Index constraint_idx, Index var_idx, Index param_idx, T coeff) {
+            check_index(constraint_idx, instance.num_constraints(), "constraint_idx");
+            check_index(var_idx, instance.num_vars(), "var_idx");
+            add_term(parts[APart], constraint_idx, var_idx, instance.A().coeff(constraint_idx, var_idx), param_idx, coeff);
+        }
+
+        /*
+            Adds coeff * theta(param_idx) to c(var_idx).
+        */
+        void add_c_term(Index var_idx, Index param_idx, T coeff) {
+            check_index(var_idx, instance.num_vars(), "var_idx");
+            add_term(parts[cPart], var_idx, 0, instance.c()(var_idx), param_idx, coeff);
+        }
+
+        /*
+            Adds coeff * theta(param_idx) to the lower limit of constraint constraint_idx.
+        */
+        void add_lb_term(Index constraint_idx, Index param_idx, T coeff) {
+            check_index(constraint_idx, instance.num_constraints(), "constraint_idx");
+            add_term(parts[lbPart], constraint_idx, 0, instance.lb()(constraint_idx), param_idx, coeff);
+        }
+
+        /*
+            Adds coeff * theta(param_idx) to the upper limit of constraint constraint_idx.
+        */
+        void add_ub_term(Index constraint_idx, Index param_idx, T coeff) {
+            check_index(constraint_idx, instance.num_constraints(), "constraint_idx");
+            add_term(parts[ubPart], constraint_idx, 0, instance.ub()(constraint_idx), param_idx, coeff);
+        }
+
+        /*
+            Adds coeff * theta(param_idx) to the lower limit of variable var_idx.
+        */
+        void add_lbx_term(Index var_idx, Index param_idx, T coeff) {
+            check_index(var_idx, instance.num_vars(), "var_idx");
+            add_term(parts[lbxPart], var_idx, 0, instance.lbx()(var_idx), param_idx, coeff);
+        }
+
+        /*
+            Adds coeff * theta(param_idx) to the upper limit of variable var_idx.
+        */
+        void add_ubx_term(Index var_idx, Index param_idx, T coeff) {
+            check_index(var_idx, instance.num_vars(), "var_idx");
+            add_term(parts[ubxPart], var_idx, 0, instance.ubx()(var_idx), param_idx, coeff);
+        }
+
+        /*
+            Evaluates the entries with terms at theta and returns the instance,
+            which stays valid until the next call. Takes time linear in the
+            number of terms.
+        */
+        const ProblemType& instantiate(const Parameters& theta) {
+            if(theta.rows() != parameter_count) {
+                throw std::domain_error(
+                    std::string("Expected ")
+                    + std::to_string(parameter_count)
+                    + std::string(" parameters, but got ")
+                    + std::to_string(theta.rows())
+                    + std::string(".")
+                );
+            }
+
+            if(!bound) {
+                bind(instance);
+                bound = true;
+            }
+
+            for(Affine& part: parts) {
+                if(part.terms.empty()) {
+                    continue;
+                }
+
+                part.values = part.base;
+                for(const Term& term: part.terms) {
+                    part.values[term.entry] += term.coeff * theta(term.param);
+                }
+                for(std::size_t i = 0; i < part.values.size(); i++) {
+                    *part.targets[i] = part.values[i];
+                    if(part.mirrors[i] != nullptr) {
+                        *part.mirrors[i] = part.values[i];
+                    }
+                }
+            }
+
+            mark_modified(instance);
+            return instance;
+        }
+
+        /*
+            The last instance, or the constant part before the first instantiate.
+        */
+        const ProblemType& problem() const {
+            return instance;
+        }
+
+    private:
+        enum Part { QPart, APart, cPart, lbPart, ubPart, lbxPart, ubxPart, PartCount };
+
+        struct Term {
+            std::size_t entry;
+            Index param;
+            T coeff;
+        };
+
+        // entries of one part with terms. base holds their values in the
+        // constant part, and targets point to their storage in instance.
+        // mirrors point to the lower triangle entries of a dense Q, which
+        // are kept up to date along with the upper triangle.
+        struct Affine {
+            std::map<std::pair<Index, Index>, std::size_t> entries;
+            std::vector<std::pair<Index, Index>> positions;
+            std::vector<T> base, values;
+            std::vector<T*> targets, mirrors;
+            std::vector<Term> terms;
+        };
+
+        void add_term(Affine& part, Index row, Index col, T value, Index param_idx, T coeff) {
+            check_index(param_idx, parameter_count, "param_idx");
+
+            auto inserted = part.entries.emplace(std::make_pair(row, col), part.positions.size());
+            if(inserted.second) {
+                part.positions.emplace_back(row, col);
+                part.base.push_back(value);
+            }
+            part.terms.push_back(Term{inserted.first->second, param_idx, coeff});
+            bound = false;
+        }
+
+        /*
+            Points the targets of the entries with terms to their storage in problem.
+        */
+        template<int NumVars, int MaxConstraints>
+        void bind(Problem<T, NumVars, MaxConstraints>& problem) {
+            bind_part(parts[QPart], [&](Index r, Index c) { return &problem.Q_mtr(r, c); });
+            bind_part(parts[APart], [&](Index r, Index c) { return &problem.A_mtr(r, c); });
+            bind_vectors(problem.c_mtr.data(), problem.lb_mtr.data(), problem.ub_mtr.data(),
+                         problem.lbx_mtr.data(), problem.ubx_mtr.data());
+
+            Affine& Q = parts[QPart];
+            for(std::size_t i = 0; i < Q.positions.size(); i++) {
+                Index r = Q.positions[i].first, c = Q.positions[i].second;
+                Q.mirrors[i] = r == c ? nullptr : &problem.Q_mtr(c, r);
+            }
+        }
+
+        /*
+            Sparse version of bind. Entries with terms that are not in the
+            patterns of Q and A are inserted as explicit zeros, so that their
+            storage stays in place while the instance is only instantiated.
+        */
+        void bind(SparseProblem<T>& problem) {
+            problem.compress_Q();
+            problem.compress_A();
+            Index previous_nonzeros = problem.Q_mtr.nonZeros() + problem.A_mtr.nonZeros();
+
+            for(const auto& position: parts[QPart].positions) {
+                problem.Q_mtr.coeffRef(position.first, position.second);
+            }
+            for(const auto& position: parts[APart].positions) {
+                problem.A_mtr.coeffRef(position.first, position.second);
+            }
+            problem.Q_mtr.makeCompressed();
+            problem.A_mtr.makeCompressed();
+            if(problem.Q_mtr.nonZeros() + problem.A_mtr.nonZeros() != previous_nonzeros) {
+                problem.versions.structure = new_version_stamp();
+            }
+
+            bind_part(parts[QPart], [&](Index r, Index c) { return &problem.Q_mtr.coeffRef(r, c); });
+            bind_part(parts[APart], [&](Index r, Index c) { return &problem.A_mtr.coeffRef(r, c); });
+            bind_vectors(problem.c_mtr.data(), problem.lb_vec.data(), problem.ub_vec.data(),
+                         problem.lbx_mtr.data(), problem.ubx_mtr.data());
+        }
+
+        template<typename Locate>
+        void bind_part(Affine& part, Locate locate) {
+            part.targets.resize(part.positions.size());
+            part.mirrors.assign(part.positions.size(), nullptr);
+            for(std::size_t i = 0; i < part.positions.size(); i++) {
+                part.targets[i] = locate(part.positions[i].first, part.positions[i].second);
+            }
+        }
+
+        void bind_vectors(T* c, T* lb, T* ub, T* lbx, T* ubx) {
+            bind_part(parts[cPart], [&](Index i, Index) { return c + i; });
+            bind_part(parts[lbPart], [&](Index i, Index) { return lb + i; });
+            bind_part(parts[ubPart], [&](Index i, Index) { return ub + i; });
+            bind_part(parts[lbxPart], [&](Index i, Index) { return lbx + i; });
+            bind_part(parts[ubxPart], [&](Index i, Index) { return ubx + i; });
+        }
+
+        /*
+            Gives the parts with terms new version stamps.
+        */
+        template<typename Instance>
+        void mark_modified(Instance& problem) {
+            if(!parts[QPart].terms.empty()) {
+                problem.versions.Q = new_version_stamp();
+            }
+            if(!parts[APart].terms.empty()) {
+                problem.versions.A = new_version_stamp();
+            }
+            if(!parts[cPart].terms.empty()) {
+                problem.versions.c = new_version_stamp();
+            }
+            if(!parts[lbPart].terms.empty() || !parts[ubPart].terms.empty()) {
+                problem.versions.limits = new_version_stamp();
+            }
+            if(!parts[lbxPart].terms.empty() || !parts[ubxPart].terms.empty()) {
+                problem.versions.var_limits = new_version_stamp();
+            }
+        }
+
+        static void check_index(Index idx, Index size, const char* name) {
+            if(idx < 0 || idx >= size) {
+                throw std::domain_error(
+                    std::string(name)
+                    + std::string(" ")
+                    + std::to_string(idx)
+                    + std::string(" is out of range [0, ")
+                    + std::to_string(size)
+                    + std::string(").")
+                );
+            }
+        }
+
+        ProblemType instance;
+        Index parameter_count;
+        Affine parts[PartCount];
+
+        // set if the targets of all parts point to the storage of instance
+        bool bound;
+};
+
+}
+
+#endif
@@ -0,0 +1,786 @@
+#ifndef QPWRAPPERS_PRESOLVE_HPP
+#define QPWRAPPERS_PRESOLVE_HPP
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+#include "problem.hpp"
+#include "types.hpp"
+
+
+namespace QPWrappers {
+
+template<typename T>
+class SparseProblem;
+
+/**
+    Reduced version of a Problem or SparseProblem, with the record needed
+    to map solutions of the reduced problem back to the original one.
+
+    Reductions are repeated until none applies:
+      - variables with equal lower and upper limits are substituted out,
+      - constraints with a single variable become limits of that variable,
+      - constraints without variables, with no finite limit, or implied by
+        the variable limits are dropped, and limits implied by the variable
+        limits are removed,
+      - limits of variables are tightened from the constraints,
+      - parallel constraints are merged into one with the tighter limits.
+    Soft convertible constraints are kept as they are, apart from
+    substituting out fixed variables, so that converting the reduced
+    problem to soft gives the same penalties.
+
+    The objective of the original problem at a postsolved solution is the
+    objective of the reduced problem plus objective_offset().
+*/
+template<typename ProblemType>
+class Presolve {
+    public:
+        using T = typename ProblemType::Scalar;
+        using Index = Eigen::Index;
+        using Vector = typename Problem<T>::Vector;
+
+        // returned as the reduced index of a removed variable or constraint
+        static constexpr Index none = -1;
+
+        explicit Presolve(const ProblemType& problem, T tolerance = T(1e-9)):
+                tolerance(tolerance),
+                reduced(0) {
+            load(problem);
+            reduce();
+            assemble(problem);
+        }
+
+        const ProblemType& problem() const & {
+            return reduced;
+        }
+
+        ProblemType problem() && {
+            return std::move(reduced);
+        }
+
+        /*
+            True if presolve found that the problem has no feasible point.
+            The reduced problem is not meaningful then.
+        */
+        bool is_infeasible() const {
+            return infeasible_found;
+        }
+
+        T objective_offset() const {
+            return offset;
+        }
+
+        /*
+            Index of variable var_idx of the original problem in the reduced
+            problem, or none if it is removed.
+        */
+        Index reduced_variable(Index var_idx) const {
+            return variables[var_idx].reduced;
+        }
+
+        /*
+            Index of constraint constraint_idx of the original problem in
+            the reduced problem, or none if it is removed.
+        */
+        Index reduced_constraint(Index constraint_idx) const {
+            return rows[constraint_idx].reduced;
+        }
+
+        /*
+            Solves the reduced problem with engine and writes the postsolved
+            solution to result, or the postsolved iterate on TimeLimit.
+        */
+        template<typename Engine>
+        OptReturnType solve(Engine& engine, Vector& result) const {
+            if(infeasible_found) {
+                return OptReturnType::Infeasible;
+            }
+
+            Vector reduced_result;
+            OptReturnType status = engine.init(reduced, reduced_result);
+            if(status == OptReturnType::Optimal || status == OptReturnType::Feasible
+               || status == OptReturnType::TimeLimit) {
+                postsolve(reduced_result, result);
+            }
+            return status;
+        }
+
+        /*
+            Maps a solution of the reduced problem to the original problem.
+        */
+        void postsolve(const Vector& reduced_solution, Vector& solution) const {
+            solution.resize(variables.size());
+            for(std::size_t j = 0; j < variables.size(); j++) {
+                const Variable& variable = variables[j];
+                solution(j) = variable.reduced == none ? variable.fixed_value
+                                                      : reduced_solution(variable.reduced);
+            }
+        }
+
+        /*
+            Maps a primal dual solution of the reduced problem to the
+            original problem, with duals as in SolutionQuality, i.e.
+                Q x + c + A^T y + z = 0
+            Multipliers of limits that presolve moved or merged are given to
+            the constraints they come from, and z is then recomputed from
+            the equation above, so that stationarity holds exactly except
+            for variables without a limit on the side z points to, whose z
+            is left at 0. Likewise, y is left at 0 for rows without a limit
+            on the side y points to.
+        */
+        void postsolve(const Vector& reduced_solution, const Vector& reduced_y,
+                       const Vector& reduced_z, Vector& solution, Vector& y, Vector& z) const {
+            postsolve(reduced_solution, solution);
+
+            y.setZero(rows.size());
+            for(std::size_t r = 0; r < rows.size(); r++) {
+                if(rows[r].reduced != none) {
+                    add_row_dual(r, reduced_y(rows[r].reduced), y);
+                }
+            }
+            for(const Variable& variable: variables) {
+                if(variable.reduced == none) {
+                    continue;
+                }
+                T dual = reduced_z(variable.reduced);
+                const LimitSource& source = dual > 0 ? variable.upper_source : variable.lower_source;
+                if(dual != T(0) && source.row != none) {
+                    add_row_dual(source.row, dual / source.scale, y);
+                }
+            }
+
+            // z = -(Q x + c + A^T y) with the original data
+            z.resize(variables.size());
+            for(std::size_t j = 0; j < variables.size(); j++) {
+                T value = original_c[j];
+                for(const Entry& entry: Q_columns[j]) {
+                    value += entry.value * solution(entry.index);
+                }
+                z(j) = -value;
+            }
+            for(std::size_t r = 0; r < rows.size(); r++) {
+                if((y(r) > 0 && is_upper_infinite(original_ub[r]))
+                   || (y(r) < 0 && is_lower_infinite(original_lb[r]))) {
+                    y(r) = 0;
+                }
+                if(y(r) == T(0)) {
+                    continue;
+                }
+                for(const Entry& entry: original_rows[r]) {
+                    z(entry.index) -= entry.value * y(r);
+                }
+            }
+            for(std::size_t j = 0; j < variables.size(); j++) {
+                if((z(j) > 0 && is_upper_infinite(original_ubx[j]))
+                   || (z(j) < 0 && is_lower_infinite(original_lbx[j]))) {
+                    z(j) = 0;
+                }
+            }
+        }
+
+    private:
+        struct Entry {
+            Index index;
+            T value;
+        };
+
+        /*
+            A limit of a row or variable comes from row, whose coefficients
+            are scale times the coefficients of the row or the variable.
+        */
+        struct LimitSource {
+            Index row;
+            T scale;
+        };
+
+        struct Variable {
+            T lower, upper, c;
+            LimitSource lower_source{none, T(1)}, upper_source{none, T(1)};
+            bool active = true;
+            T fixed_value = 0;
+            Index reduced = none;
+            std::vector<Index> rows;
+        };
+
+        struct Row {
+            std::vector<Entry> entries;
+            T lower, upper;
+            LimitSource lower_source, upper_source;
+            bool soft_convertible;
+            T soft_weight;
+            bool active = true;
+            Index reduced = none;
+        };
+
+        // passes over all reductions, and how much better than the current
+        // limit a propagated one must be, relative to tolerance, to be used.
+        static constexpr int max_passes = 8;
+        static constexpr double propagation_gain = 1e3;
+
+        T tolerance;
+        ProblemType reduced;
+        bool infeasible_found = false;
+        T offset = 0;
+
+        std::vector<Variable> variables;
+        std::vector<Row> rows;
+        // Q with both triangles, c and A rows of the original problem
+        std::vector<std::vector<Entry>> Q_columns, original_rows;
+        std::vector<T> original_c, original_lbx, original_ubx, original_lb, original_ub;
+
+        static bool is_lower_infinite(T value) {
+            return value == std::numeric_limits<T>::lowest();
+        }
+
+        static bool is_upper_infinite(T value) {
+            return value == std::numeric_limits<T>::max();
+        }
+
+        /*
+            Adds the multiplier dual of row r to the rows its limits come from.
+        */
+        void add_row_dual(Index r, T dual, Vector& y) const {
+            if(dual == T(0)) {
+                return;
+            }
+            const LimitSource& source = dual > 0 ? rows[r].upper_source : rows[r].lower_source;
+            y(source.row) += dual / source.scale;
+        }
+
+        template<typename S>
+        void load(const Problem<S>& problem) {
+            Index n = problem.num_vars(), m = problem.num_constraints();
+            const auto& Q = problem.Q();
+            Q_columns.resize(n);
+            for(Index j = 0; j < n; j++) {
+                for(Index i = 0; i < n; i++) {
+                    if(Q(i, j) != S(0)) {
+                        Q_columns[j].push_back(Entry{i, Q(i, j)});
+                    }
+                }
+            }
+
+            original_rows.resize(m);
+            auto A = problem.A();
+            for(Index r = 0; r < m; r++) {
+                for(Index j = 0; j < n; j++) {
+                    if(A(r, j) != S(0)) {
+                        original_rows[r].push_back(Entry{j, A(r, j)});
+                    }
+                }
+            }
+
+            load_limits(problem);
+        }
+
+        template<typename S>
+        void load(const SparseProblem<S>& problem) {
+            Index n = problem.num_vars(), m = problem.num_constraints();
+            const auto& Q = problem.Q();
+            Q_columns.resize(n);
+            for(Index j = 0; j < n; j++) {
+                for(typename SparseProblem<S>::SparseMatrix::InnerIterator it(Q, j); it; ++it) {
+                    if(it.value() == S(0)) {
+                        continue;
+                    }
+                    Q_columns[j].push_back(Entry{it.row(), it.value()});
+                    if(it.row() != j) {
+                        Q_columns[it.row()].push_back(Entry{j, it.value()});
+                    }
+                }
+            }
+
+            original_rows.resize(m);
+            const auto& A = problem.A();
+            for(Index j = 0; j < n; j++) {
+                for(typename SparseProblem<S>::SparseMatrix::InnerIterator it(A, j); it; ++it) {
+                    if(it.value() != S(0)) {
+                        original_rows[it.row()].push_back(Entry{j, it.value()});
+                    }
+                }
+            }
+
+            load_limits(problem);
+        }
+
+        template<typename Base>
+        void load_limits(const Base& problem) {
+            Index n = problem.num_vars(), m = problem.num_constraints();
+            original_c.resize(n);
+            original_lbx.resize(n);
+            original_ubx.resize(n);
+            variables.resize(n);
+            for(Index j = 0; j < n; j++) {
+                original_c[j] = problem.c()(j);
+                original_lbx[j] = problem.lbx()(j);
+                original_ubx[j] = problem.ubx()(j);
+                variables[j].lower = problem.lbx()(j);
+                variables[j].upper = problem.ubx()(j);
+                variables[j].c = problem.c()(j);
+            }
+
+            original_lb.resize(m);
+            original_ub.resize(m);
+            rows.resize(m);
+            for(Index r = 0; r < m; r++) {
+                original_lb[r] = problem.lb()(r);
+                original_ub[r] = problem.ub()(r);
+                Row& row = rows[r];
+                row.entries = original_rows[r];
+                row.lower = problem.lb()(r);
+                row.upper = problem.ub()(r);
+                row.lower_source = row.upper_source = LimitSource{r, T(1)};
+                row.soft_convertible = problem.is_soft_convertible(r);
+                row.soft_weight = problem.soft_weight(r);
+                for(const Entry& entry: row.entries) {
+                    variables[entry.index].rows.push_back(r);
+                }
+            }
+        }
+
+        void reduce() {
+            bool changed = true;
+            for(int pass = 0; pass < max_passes && changed && !infeasible_found; pass++) {
+                changed = remove_fixed_variables();
+                for(std::size_t r = 0; r < rows.size() && !infeasible_found; r++) {
+                    if(rows[r].active && !rows[r].soft_convertible) {
+                        changed |= reduce_row(r);
+                    }
+                }
+                if(!infeasible_found) {
+                    changed |= merge_parallel_rows();
+                }
+            }
+        }
+
+        bool remove_fixed_variables() {
+            bool changed = false;
+            for(std::size_t j = 0; j < variables.size(); j++) {
+                Variable& variable = variables[j];
+                if(!variable.active) {
+                    continue;
+                }
+                if(variable.lower > variable.upper + tolerance) {
+                    infeasible_found = true;
+                    return changed;
+                }
+                if(variable.upper - variable.lower <= tolerance) {
+                    fix_variable(j, variable.lower == variable.upper
+                                    ? variable.lower
+                                    : (variable.lower + variable.upper) / 2);
+                    changed = true;
+                }
+            }
+            return changed;
+        }
+
+        /*
+            Substitutes x_j = value into the objective and the constraints.
+        */
+        void fix_variable(Index j, T value) {
+            Variable& variable = variables[j];
+            variable.active = false;
+            variable.fixed_value = value;
+
+            // 1/2 x^T Q x gets Q_jj value^2 / 2 and value * Q_ij x_i for i != j
+            offset += variable.c * value;
+            for(const Entry& entry: Q_columns[j]) {
+                if(entry.index == j) {
+                    offset += entry.value * value * value / 2;
+                } else if(variables[entry.index].active) {
+                    variables[entry.index].c += entry.value * value;
+                }
+            }
+
+            for(Index r: variable.rows) {
+                Row& row = rows[r];
+                auto it = std::find_if(row.entries.begin(), row.entries.end(), [j](const Entry& entry) {
+                    return entry.index == j;
+                });
+                if(it == row.entries.end()) {
+                    continue;
+                }
+                T shift = it->value * value;
+                if(!is_lower_infinite(row.lower)) {
+                    row.lower -= shift;
+                }
+                if(!is_upper_infinite(row.upper)) {
+                    row.upper -= shift;
+                }
+                row.entries.erase(it);
+            }
+        }
+
+        /*
+            Applies the row reductions to row r. Returns true if anything
+            changed.
+        */
+        bool reduce_row(Index r) {
+            Row& row = rows[r];
+
+            if(row.lower > row.upper + tolerance) {
+                infeasible_found = true;
+                return false;
+            }
+
+            if(row.entries.empty()) {
+                if(row.lower > tolerance || row.upper < -tolerance) {
+                    infeasible_found = true;
+                }
+                row.active = false;
+                return true;
+            }
+
+            if(is_lower_infinite(row.lower) && is_upper_infinite(row.upper)) {
+                row.active = false;
+                return true;
+            }
+
+            if(row.entries.size() == 1) {
+                row_to_limits(r);
+                return true;
+            }
+
+            // activity range of the row over the variable limits, with the
+            // number of infinite contributions kept apart.
+            T min_activity = 0, max_activity = 0;
+            int min_infinite = 0, max_infinite = 0;
+            for(const Entry& entry: row.entries) {
+                const Variable& variable = variables[entry.index];
+                T low = entry.value > 0 ? variable.lower : variable.upper;
+                T up = entry.value > 0 ? variable.upper : variable.lower;
+                if(is_lower_infinite(low) || is_upper_infinite(low)) {
+                    min_infinite++;
+                } else {
+                    min_activity += entry.value * low;
+                }
+                if(is_lower_infinite(up) || is_upper_infinite(up)) {
+                    max_infinite++;
+                } else {
+                    max_activity += entry.value * up;
+                }
+            }
+
+            bool changed = false;
+            if(!is_lower_infinite(row.lower) && min_infinite == 0
+               && min_activity >= row.lower - tolerance) {
+                row.lower = std::numeric_limits<T>::lowest();
+                changed = true;
+            }
+            if(!is_upper_infinite(row.upper) && max_infinite == 0
+               && max_activity <= row.upper + tolerance) {
+                row.upper = std::numeric_limits<T>::max();
+                changed = true;
+            }
+            if(min_infinite == 0 && min_activity > row.upper + tolerance) {
+                infeasible_found = true;
+                return changed;
+            }
+            if(max_infinite == 0 && max_activity < row.lower - tolerance) {
+                infeasible_found = true;
+                return changed;
+            }
+            if(is_lower_infinite(row.lower) && is_upper_infinite(row.upper)) {
+                row.active = false;
+                return true;
+            }
+
+            for(const Entry& entry: row.entries) {
+                changed |= propagate(r, entry, min_activity, min_infinite,
+                                     max_activity, max_infinite);
+            }
+            return changed;
+        }
+
+        /*
+            Turns row r with a single variable into limits of that variable.
+        */
+        void row_to_limits(Index r) {
+            Row& row = rows[r];
+            const Entry& entry = row.entries.front();
+            T a = entry.value;
+
+            // a x_j <= upper bounds x_j from above if a > 0, from below otherwise
+            if(!is_upper_infinite(row.upper)) {
+                tighten(entry.index, row.upper / a, a > 0, LimitSource{r, a}, T(0));
+            }
+            if(!is_lower_infinite(row.lower)) {
+                tighten(entry.index, row.lower / a, a < 0, LimitSource{r, a}, T(0));
+            }
+            row.active = false;
+        }
+
+        /*
+            Tightens the limits of the variable of entry from the limits of
+            row r, given the activity range of the row.
+        */
+        bool propagate(Index r, const Entry& entry, T min_activity, int min_infinite,
+                       T max_activity, int max_infinite) {
+            const Row& row = rows[r];
+            const Variable& variable = variables[entry.index];
+            T a = entry.value;
+            T own_low = a > 0 ? variable.lower : variable.upper;
+            T own_up = a > 0 ? variable.upper : variable.lower;
+            bool own_low_infinite = is_lower_infinite(own_low) || is_upper_infinite(own_low);
+            bool own_up_infinite = is_lower_infinite(own_up) || is_upper_infinite(own_up);
+            T gain = T(propagation_gain) * tolerance;
+            bool changed = false;
+
+            // a x_j <= upper - (minimum activity of the other entries)
+            int others_min_infinite = min_infinite - own_low_infinite;
+            if(!is_upper_infinite(row.upper) && others_min_infinite == 0) {
+                T others = min_activity - (own_low_infinite ? T(0) : a * own_low);
+                changed |= tighten(entry.index, (row.upper - others) / a, a > 0,
+                                   LimitSource{r, a}, gain);
+            }
+
+            // a x_j >= lower - (maximum activity of the other entries)
+            int others_max_infinite = max_infinite - own_up_infinite;
+            if(!is_lower_infinite(row.lower) && others_max_infinite == 0) {
+                T others = max_activity - (own_up_infinite ? T(0) : a * own_up);
+                changed |= tighten(entry.index, (row.lower - others) / a, a < 0,
+                                   LimitSource{r, a}, gain);
+            }
+            return changed;
+        }
+
+        /*
+            Sets the upper limit of variable j to value if is_upper, and the
+            lower limit otherwise, if value is tighter by more than
+            gain * max(1, |value|). Returns true if the limit changed.
+        */
+        bool tighten(Index j, T value, bool is_upper, LimitSource source, T gain) {
+            Variable& variable = variables[j];
+            T margin = gain * std::max(T(1), std::abs(value));
+            if(is_upper && value < variable.upper - margin) {
+                variable.upper = value;
+                variable.upper_source = source;
+            } else if(!is_upper && value > variable.lower + margin) {
+                variable.lower = value;
+                variable.lower_source = source;
+            } else {
+                return false;
+            }
+
+            if(variable.lower > variable.upper + tolerance) {
+                infeasible_found = true;
+            }
+            return true;
+        }
+
+        /*
+            Merges rows whose coefficients are multiples of each other into
+            the first of them. Rows are grouped by a hash of their sparsity
+            pattern and coefficients normalized by the first coefficient.
+        */
+        bool merge_parallel_rows() {
+            std::unordered_map<std::size_t, std::vector<Index>> groups;
+            for(std::size_t r = 0; r < rows.size(); r++) {
+                Row& row = rows[r];
+                if(!row.active || row.soft_convertible || row.entries.size() < 2) {
+                    continue;
+                }
+                std::sort(row.entries.begin(), row.entries.end(), [](const Entry& a, const Entry& b) {
+                    return a.index < b.index;
+                });
+                groups[row_hash(row)].push_back(r);
+            }
+
+            bool changed = false;
+            for(auto& group: groups) {
+                std::vector<Index>& members = group.second;
+                for(std::size_t a = 0; a < members.size(); a++) {
+                    if(!rows[members[a]].active) {
+                        continue;
+                    }
+                    for(std::size_t b = a + 1; b < members.size(); b++) {
+                        T scale;
+                        if(rows[members[b]].active && is_multiple(members[a], members[b], scale)) {
+                            merge(members[a], members[b], scale);
+                            changed = true;
+                        }
+                    }
+                }
+            }
+            return changed;
+        }
+
+        std::size_t row_hash(const Row& row) const {
+            std::size_t hash = row.entries.size();
+            T first = row.entries.front().value;
+            for(const Entry& entry: row.entries) {
+                // rounded so that rows equal up to rounding errors collide
+                long long normalized = std::llround(entry.value / first * T(1e6));
+                hash = hash * 1000003 ^ std::hash<Index>()(entry.index);
+                hash = hash * 1000003 ^ std::hash<long long>()(normalized);
+            }
+            return hash;
+        }
+
+        /*
+            Checks whether row s is scale times row r.
+        */
+        bool is_multiple(Index r, Index s, T& scale) const {
+            const std::vector<Entry>& first = rows[r].entries;
+            const std::vector<Entry>& second = rows[s].entries;
+            if(first.size() != second.size()) {
+                return false;
+            }
+            scale = second.front().value / first.front().value;
+            for(std::size_t k = 0; k < first.size(); k++) {
+                if(first[k].index != second[k].index) {
+                    return false;
+                }
+                T expected = scale * first[k].value;
+                if(std::abs(second[k].value - expected) > tolerance * std::max(T(1), std::abs(expected))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /*
+            Merges row s, which is scale times row r, into row r.
+        */
+        void merge(Index r, Index s, T scale) {
+            Row& row = rows[r];
+            Row& other = rows[s];
+
+            // lower <= scale * a^T x <= upper limits a^T x by lower / scale
+            // and upper / scale, swapped if scale is negative.
+            T low = scale > 0 ? other.lower : other.upper;
+            T up = scale > 0 ? other.upper : other.lower;
+            LimitSource low_source = scale > 0 ? other.lower_source : other.upper_source;
+            LimitSource up_source = scale > 0 ? other.upper_source : other.lower_source;
+            bool low_infinite = is_lower_infinite(low) || is_upper_infinite(low);
+            bool up_infinite = is_lower_infinite(up) || is_upper_infinite(up);
+
+            if(!low_infinite && (is_lower_infinite(row.lower) || low / scale > row.lower)) {
+                row.lower = low / scale;
+                row.lower_source = LimitSource{low_source.row, low_source.scale * scale};
+            }
+            if(!up_infinite && (is_upper_infinite(row.upper) || up / scale < row.upper)) {
+                row.upper = up / scale;
+                row.upper_source = LimitSource{up_source.row, up_source.scale * scale};
+            }
+            other.active = false;
+        }
+
+        template<typename S>
+        void assemble(const Problem<S>&) {
+            using Matrix = typename Problem<S>::Matrix;
+            using RowVector = typename Problem<S>::RowVector;
+
+            Index n = number_variables(), m = number_rows();
+            Problem<S> result(n, m);
+
+            Matrix Q = Matrix::Zero(n, n);
+            for(std::size_t j = 0; j < variables.size(); j++) {
+                Index col = variables[j].reduced;
+                if(col == none) {
+                    continue;
+                }
+                for(const Entry& entry: Q_columns[j]) {
+                    Index i = variables[entry.index].reduced;
+                    if(i != none) {
+                        Q(i, col) = entry.value;
+                    }
+                }
+            }
+            result.add_Q(Q);
+            assemble_variables(result);
+
+            RowVector coeff(n);
+            for(const Row& row: rows) {
+                if(row.reduced == none) {
+                    continue;
+                }
+                coeff.setZero();
+                for(const Entry& entry: row.entries) {
+                    coeff(variables[entry.index].reduced) = entry.value;
+                }
+                result.set_constraint(row.reduced, coeff, row.lower, row.upper,
+                                      row.soft_convertible, row.soft_weight);
+            }
+
+            reduced = std::move(result);
+        }
+
+        template<typename S>
+        void assemble(const SparseProblem<S>&) {
+            Index n = number_variables(), m = number_rows();
+            SparseProblem<S> result(n, m);
+
+            for(std::size_t j = 0; j < variables.size(); j++) {
+                Index col = variables[j].reduced;
+                if(col == none) {
+                    continue;
+                }
+                for(const Entry& entry: Q_columns[j]) {
+                    Index i = variables[entry.index].reduced;
+                    // each off-diagonal entry is visited from both ends, and
+                    // add_Q_entry splits it between Q(i, j) and Q(j, i).
+                    if(i != none) {
+                        result.add_Q_entry(i, col, entry.value);
+                    }
+                }
+            }
+            assemble_variables(result);
+
+            for(const Row& row: rows) {
+                if(row.reduced == none) {
+                    continue;
+                }
+                for(const Entry& entry: row.entries) {
+                    result.add_constraint_entry(row.reduced, variables[entry.index].reduced, entry.value);
+                }
+                result.set_constraint_limits(row.reduced, row.lower, row.upper);
+                result.set_soft_convertible(row.reduced, row.soft_convertible, row.soft_weight);
+            }
+
+            reduced = std::move(result);
+        }
+
+        /*
+            Numbers the remaining variables, and returns their count.
+        */
+        Index number_variables() {
+            Index count = 0;
+            for(Variable& variable: variables) {
+                variable.reduced = variable.active ? count++ : none;
+            }
+            return count;
+        }
+
+        /*
+            Numbers the remaining constraints, and returns their count.
+        */
+        Index number_rows() {
+            Index count = 0;
+            for(Row& row: rows) {
+                row.reduced = row.active ? count++ : none;
+            }
+            return count;
+        }
+
+        template<typename Result>
+        void assemble_variables(Result& result) const {
+            Vector c(result.num_vars());
+            for(const Variable& variable: variables) {
+                if(variable.reduced != none) {
+                    c(variable.reduced) = variable.c;
+                    result.set_var_limits(variable.reduced, variable.lower, variable.upper);
+                }
+            }
+            result.add_c(c);
+        }
+};
+
+}
+
+#endif
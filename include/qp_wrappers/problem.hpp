@@ -5,10 +5,103 @@
 #include <Eigen/Eigenvalues>
 #include <limits>
 #include <iostream>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include "eigenvalue_estimation.hpp"
+#include "types.hpp"
 
 
 namespace QPWrappers {
 
+/*
+    Definiteness of the Q matrix of a problem.
+*/
+enum class QDefiniteness {
+    PositiveDefinite,
+    PositiveSemidefinite,
+    Indefinite
+};
+
+template<typename ProblemType>
+class SoftConversion;
+
+namespace problem_detail {
+
+/*
+    Replacement of std::vector<bool> with storage for Capacity flags in
+    the object, used for problems with a compile time maximum number of
+    constraints so that they do not allocate.
+*/
+template<int Capacity>
+class FixedFlags {
+    public:
+        bool operator[](std::size_t i) const {
+            return flags[i];
+        }
+
+        bool& operator[](std::size_t i) {
+            return flags[i];
+        }
+
+        std::size_t size() const {
+            return count;
+        }
+
+        void reserve(std::size_t) {}
+
+        void clear() {
+            count = 0;
+        }
+
+        void push_back(bool value) {
+            flags[count++] = value;
+        }
+
+        void resize(std::size_t new_count, bool value = false) {
+            std::fill(flags + std::min(count, new_count), flags + new_count, value);
+            count = new_count;
+        }
+
+    private:
+        bool flags[Capacity > 0 ? Capacity : 1] = {};
+        std::size_t count = 0;
+};
+
+template<int Constraints>
+using SoftFlags = typename std::conditional<
+    Constraints == Eigen::Dynamic,
+    std::vector<bool>,
+    FixedFlags<Constraints>
+>::type;
+
+/*
+    Casts a limit to S, keeping infinite limits, i.e. numeric_limits max
+    and lowest, infinite and saturating limits out of the range of S.
+*/
+template<typename S, typename T>
+S cast_limit(T value) {
+    using Wide = typename std::common_type<S, T>::type;
+    if(value == std::numeric_limits<T>::max()
+       || Wide(value) >= Wide(std::numeric_limits<S>::max())) {
+        return std::numeric_limits<S>::max();
+    }
+    if(value == std::numeric_limits<T>::lowest()
+       || Wide(value) <= Wide(std::numeric_limits<S>::lowest())) {
+        return std::numeric_limits<S>::lowest();
+    }
+    return static_cast<S>(value);
+}
+
+template<typename S, typename Derived>
+auto cast_limits(const Eigen::MatrixBase<Derived>& limits) {
+    return limits.unaryExpr([](typename Derived::Scalar value) {
+        return cast_limit<S>(value);
+    });
+}
+
+}
+
 /**
     Defines a quadratic program in the form 
          minimize 1/2 x^T Q x + c^T x
@@ -16,26 +109,54 @@ namespace QPWrappers {
            lb <= Ax <= ub
            lbx <= x <= ubx
     where Q is a symmetric matrix.
+
+    NumVars and MaxConstraints can fix the number of variables and the
+    maximum number of constraints at compile time. Then the problem keeps
+    all of its storage in the object itself, so small problems are built,
+    copied and verified without heap allocations.
 */
-template<typename T>
+template<typename T, int NumVars = Eigen::Dynamic, int MaxConstraints = Eigen::Dynamic>
 class Problem {
     public:
-        using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
-        using Vector = Eigen::Matrix<T, Eigen::Dynamic, 1>;
-        using RowVector = Eigen::Matrix<T, 1, Eigen::Dynamic>;
+        using Scalar = T;
+        static constexpr int VarsAtCompileTime = NumVars;
+        static constexpr int MaxConstraintsAtCompileTime = MaxConstraints;
+
+        using Matrix = Eigen::Matrix<T, NumVars, NumVars, Eigen::RowMajor>;
+        using Vector = Eigen::Matrix<T, NumVars, 1>;
+        using RowVector = Eigen::Matrix<T, 1, NumVars>;
         using Index = Eigen::Index;
 
+        // constraints and blocks have up to, rather than exactly, the compile
+        // time number of rows, hence dynamic sizes with fixed maximum sizes.
+        // All of them are the same as Matrix and Vector for dynamic problems.
+        using ConstraintMatrix = Eigen::Matrix<T, Eigen::Dynamic, NumVars,
+                                               NumVars == 1 ? Eigen::ColMajor : Eigen::RowMajor,
+                                               MaxConstraints, NumVars>;
+        using ConstraintVector = Eigen::Matrix<T, Eigen::Dynamic, 1, Eigen::ColMajor,
+                                               MaxConstraints, 1>;
+        using BlockMatrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor,
+                                          NumVars, NumVars>;
+        using BlockVector = Eigen::Matrix<T, Eigen::Dynamic, 1, Eigen::ColMajor, NumVars, 1>;
+
+        using ConstMatrixRows = typename ConstraintMatrix::ConstRowsBlockXpr;
+        using ConstVectorSegment = typename ConstraintVector::ConstSegmentReturnType;
+
         /*
             Construct a QP with N variables with M constraints.
             M can be omitted, in which case required constraints must
             be added one by one.
+            If sizes are fixed at compile time, N must be NumVars and M
+            must not be more than MaxConstraints.
         */
-        Problem(Index N, Index M = 0):
-                A_mtr(M, N),
-                lb_mtr(M),
-                ub_mtr(M),
-                soft_convertible(M),
-                soft_weights(M){
+        Problem(Index N, Index M = 0): constraint_count(M) {
+            check_compile_time_sizes(N, M);
+
+            A_mtr.resize(M, N);
+            lb_mtr.resize(M);
+            ub_mtr.resize(M);
+            soft_convertible.resize(M);
+            soft_weights.resize(M);
             Q_mtr.setConstant(N, N, 0);
             c_mtr.setConstant(N, 0);
             lbx_mtr.setConstant(N, std::numeric_limits<T>::lowest());
@@ -46,137 +167,28 @@ class Problem {
         /*
          * Converts the problem to the version with soft constraints
          * where first num_vars() variables are the original variables
-         * and the rest are the slack variables
+         * and the rest are the slack variables. The result has dynamic
+         * size, since the slack variables do not fit fixed sizes.
+         * Use SoftConversion directly to keep the converted problem
+         * around and map its solutions back.
          */
-        Problem<T> convert_to_soft()
-            const {
-            Index equality_constraint_count = 0;
-            Index inequality_constraint_count = 0;
-
-            for(Index i = 0; i < this->num_constraints(); i++) {
-                if(this->soft_convertible[i]) {
-                    if(this->lb()(i) == this->ub()(i)) {
-                        equality_constraint_count++;
-                    } else {
-                        if(this->lb()(i) != std::numeric_limits<T>::lowest()) {
-                            inequality_constraint_count++;
-                        }
-                        if(this->ub()(i) != std::numeric_limits<T>::max()) {
-                            inequality_constraint_count++;
-                        }
-                    }
-                }
-            }
-
-            Index new_num_vars = this->num_vars() + inequality_constraint_count;
-            Problem<T> new_problem(new_num_vars);
-
-            // carry Q
-            Matrix carry_Q(new_num_vars, new_num_vars);
-            carry_Q.setZero();
-            carry_Q.block(0, 0, this->num_vars(), this->num_vars()) = this->Q();
-            new_problem.add_Q(carry_Q);
-
-            // carry c
-            Vector carry_c(new_num_vars);
-            carry_c.setZero();
-            carry_c.block(0, 0, this->num_vars(), 1) = this->c();
-            new_problem.add_c(carry_c);
-
-            // carry lbx, ubx
-            for(Index i = 0; i < this->num_vars(); i++) {
-                new_problem.set_var_limits(i, this->lbx()(i), this->ubx()(i));
-            }
-
-            // lbx and ubx for slack variables
-            for(Index i = 0; i < inequality_constraint_count; i++) {
-                new_problem.set_var_limits(this->num_vars() + i,
-                        0, std::numeric_limits<T>::max());
-            }
-
-            Index next_slack_index = 0;
-            for(Index i = 0; i < this->num_constraints(); i++) {
-                if(this->soft_convertible[i]) {
-                    if (this->lb()(i) == this->ub()(i)) {
-                        // equality constraint
-                        Matrix Q_addition = 2 * this->soft_weights(i)
-                                            * this->A().row(i).transpose()
-                                            * this->A().row(i);
-
-                        new_problem.add_Q_block(0, 0, Q_addition);
-
-                        Vector c_addition = -2 * this->soft_weights(i)
-                                            * this->lb()(i)
-                                            * this->A().row(i).transpose();
-
-                        new_problem.add_c_block(0, c_addition);
-                    } else {
-                        if (this->lb()(i) != std::numeric_limits<T>::lowest()) {
-                            // lb ineq constraint
-                            RowVector coeff(new_num_vars);
-                            coeff.setZero();
-                            coeff.block(0, 0, 1, this->num_vars())
-                                    = this->A().row(i);
-                            coeff(this->num_vars() + next_slack_index) = 1;
-
-                            new_problem.add_constraint(coeff, this->lb()(i),
-                                                       std::numeric_limits<T>::max());
-
-
-                            Vector c_addition(new_num_vars);
-                            c_addition.setZero();
-                            c_addition(this->num_vars() + next_slack_index)
-                                    = this->soft_weights(i);
-
-                            new_problem.add_c(c_addition);
-
-                            next_slack_index++;
-                        }
-                        if (this->ub()(i) != std::numeric_limits<T>::max()) {
-                            // ub ineq constraint
-                            RowVector coeff(new_num_vars);
-                            coeff.setZero();
-                            coeff.block(0, 0, 1, this->num_vars())
-                                    = this->A().row(i);
-                            coeff(this->num_vars() + next_slack_index) = -1;
-
-                            new_problem.add_constraint(coeff,
-                                                       std::numeric_limits<T>::lowest(),
-                                                       this->ub()(i));
-
-                            Vector c_addition(new_num_vars);
-                            c_addition.setZero();
-                            c_addition(this->num_vars() + next_slack_index)
-                                    = this->soft_weights(i);
-
-                            new_problem.add_c(c_addition);
-
-                            next_slack_index++;
-                        }
-                    }
-                } else {
-                    RowVector coeff(new_num_vars);
-                    coeff.setZero();
-                    coeff.block(0, 0, 1, this->num_vars()) = this->A().row(i);
-                    new_problem.add_constraint(coeff
-                                    , this->lb()(i), this->ub()(i));
-                }
-            }
-
-            return new_problem;
+        Problem<T> convert_to_soft() const {
+            return SoftConversion<Problem<T, NumVars, MaxConstraints>>(*this).problem();
         }
 
         /*
-        * Resets the problem so that there is constraint, objective is 0, and
-        * there is no upper and lower limit
+        * Resets the problem so that there is no constraint, objective is 0, and
+        * there is no upper and lower limit. Constraint storage is kept as spare
+        * capacity, so rebuilding a problem of the same size does not reallocate.
         */
         void reset() {
-            A_mtr = Matrix(0, this->num_vars());
-            lb_mtr = Vector(0);
-            ub_mtr = Vector(0);
             soft_convertible.clear();
-            soft_weights = Vector(0);
+            constraint_count = 0;
             Q_mtr.setZero();
+            versions = ProblemVersion::fresh();
+            Q_dirty_blocks.clear();
+            Q_dirty_area = 0;
+            Q_fully_dirty = false;
             c_mtr.setZero();
             lbx_mtr.setConstant(this->num_vars(), std::numeric_limits<T>::lowest());
             ubx_mtr.setConstant(this->num_vars(), std::numeric_limits<T>::max());
@@ -195,9 +207,50 @@ class Problem {
         }
 
         inline Index num_constraints() const {
+            return constraint_count;
+        }
+
+        /*
+            Number of constraints the problem can hold before its
+            constraint storage is reallocated.
+        */
+        inline Index constraint_capacity() const {
             return A_mtr.rows();
         }
 
+        /*
+            Makes sure that at least rows constraints can be held without
+            reallocating the constraint storage. Throws if rows is more
+            than the compile time maximum number of constraints.
+        */
+        void reserve(Index rows) {
+            if(MaxConstraints != Eigen::Dynamic && rows > MaxConstraints) {
+                throw std::domain_error(
+                    std::string("Problem can hold at most ")
+                    + std::to_string(MaxConstraints)
+                    + std::string(" constraints, but ")
+                    + std::to_string(rows)
+                    + std::string(" are required.")
+                );
+            }
+
+            if(rows > constraint_capacity()) {
+                A_mtr.conservativeResize(rows, Eigen::NoChange);
+                ub_mtr.conservativeResize(rows);
+                lb_mtr.conservativeResize(rows);
+                soft_weights.conservativeResize(rows);
+            }
+            soft_convertible.reserve(rows);
+        }
+
+        inline bool is_soft_convertible(Index constraint_idx) const {
+            return soft_convertible[constraint_idx];
+        }
+
+        inline T soft_weight(Index constraint_idx) const {
+            return soft_weights(constraint_idx);
+        }
+
         /*
             Sets the constraint with index constraint_idx.
             After the operation, low <= coeff * x <= up is enforced by the
@@ -229,7 +282,48 @@ class Problem {
             A_mtr.row(constraint_idx) = coeff;
             ub_mtr(constraint_idx) = up;
             lb_mtr(constraint_idx) = low;
-            soft_convertible[constraint_idx] = soft_convertible;
+            soft_convertible[constraint_idx] = is_soft_convertible;
+            soft_weights(constraint_idx) = soft_weight;
+            versions.A = versions.limits = new_version_stamp();
+        }
+
+        /*
+            Sets the limits of the constraint with index constraint_idx
+            without changing its coefficients.
+        */
+        void set_constraint_limits(Index constraint_idx, T low, T up) {
+            if(constraint_idx >= num_constraints()) {
+                throw std::domain_error(
+                    std::string("constraint index out of range. ")
+                    + std::string("constraint_idx: ")
+                    + std::to_string(constraint_idx)
+                    + std::string(", num constraints: ")
+                    + std::to_string(num_constraints())
+                );
+            }
+
+            lb_mtr(constraint_idx) = low;
+            ub_mtr(constraint_idx) = up;
+            versions.limits = new_version_stamp();
+        }
+
+        /*
+            Sets whether the constraint with index constraint_idx is converted
+            to a soft constraint by convert_to_soft, and the weight it gets.
+        */
+        void set_soft_convertible(Index constraint_idx, bool is_soft_convertible,
+                                  T soft_weight = T(1)) {
+            if(constraint_idx >= num_constraints()) {
+                throw std::domain_error(
+                    std::string("constraint index out of range. ")
+                    + std::string("constraint_idx: ")
+                    + std::to_string(constraint_idx)
+                    + std::string(", num constraints: ")
+                    + std::to_string(num_constraints())
+                );
+            }
+
+            soft_convertible[constraint_idx] = is_soft_convertible;
             soft_weights(constraint_idx) = soft_weight;
         }
 
@@ -249,17 +343,57 @@ class Problem {
                 );
             }
 
-            A_mtr.conservativeResize(A_mtr.rows() + 1, Eigen::NoChange);
-            ub_mtr.conservativeResize(ub_mtr.rows() + 1, Eigen::NoChange);
-            lb_mtr.conservativeResize(lb_mtr.rows() + 1, Eigen::NoChange);
-            soft_weights.conservativeResize(soft_weights.rows() + 1,
-                    Eigen::NoChange);
+            grow_constraints(1);
 
-            A_mtr.row(A_mtr.rows() - 1) = coeff;
-            ub_mtr(ub_mtr.rows() - 1) = up;
-            lb_mtr(lb_mtr.rows() - 1) = low;
-            soft_weights(soft_weights.rows() - 1) = soft_weight;
+            A_mtr.row(constraint_count) = coeff;
+            ub_mtr(constraint_count) = up;
+            lb_mtr(constraint_count) = low;
+            soft_weights(constraint_count) = soft_weight;
             soft_convertible.push_back(is_soft_convertible);
+            constraint_count++;
+            versions.structure = versions.A = versions.limits = new_version_stamp();
+        }
+
+        /*
+            Adds a new constraint for each row of coeffs, where i^th
+            one enforces
+                low(i) <= coeffs.row(i) * x <= up(i)
+        */
+        void add_constraints(const ConstraintMatrix& coeffs, const ConstraintVector& low,
+                const ConstraintVector& up,
+                bool is_soft_convertible = false, T soft_weight = T(1)) {
+            if(coeffs.cols() != num_vars()) {
+                throw std::domain_error (
+                    std::string("Problem has ")
+                    + std::to_string(num_vars())
+                    + std::string(" variables, but the provided matrix for constraints has ")
+                    + std::to_string(coeffs.cols())
+                    + std::string(" columns.")
+                );
+            }
+
+            if(low.rows() != coeffs.rows() || up.rows() != coeffs.rows()) {
+                throw std::domain_error (
+                    std::string("provided matrix for constraints has ")
+                    + std::to_string(coeffs.rows())
+                    + std::string(" rows, but provided lower and upper bounds have ")
+                    + std::to_string(low.rows())
+                    + std::string(" and ")
+                    + std::to_string(up.rows())
+                    + std::string(" rows.")
+                );
+            }
+
+            Index rows = coeffs.rows();
+            grow_constraints(rows);
+
+            A_mtr.middleRows(constraint_count, rows) = coeffs;
+            lb_mtr.segment(constraint_count, rows) = low;
+            ub_mtr.segment(constraint_count, rows) = up;
+            soft_weights.segment(constraint_count, rows).setConstant(soft_weight);
+            soft_convertible.resize(constraint_count + rows, is_soft_convertible);
+            constraint_count += rows;
+            versions.structure = versions.A = versions.limits = new_version_stamp();
         }
 
         /*
@@ -278,11 +412,14 @@ class Problem {
 
             lbx_mtr(var_idx) = low;
             ubx_mtr(var_idx) = up;
+            versions.var_limits = new_version_stamp();
         }
 
         /*
             Adds given matrix to the Q of the problem.
             If given matrix is not symmetric, makes it symmetric first.
+            Additions are accumulated in the upper triangle of Q, the lower
+            triangle is brought up to date when Q() is read.
         */
         void add_Q(const Matrix& Q) {
             if(Q.rows() != Q_mtr.rows() || Q.cols() != Q_mtr.cols()) {
@@ -299,10 +436,7 @@ class Problem {
                             );
             }
 
-            Q_mtr += Q;
-
-            ensure_Q_symmetry();
-
+            accumulate_Q_block(0, 0, Q);
         }
 
         /*
@@ -310,15 +444,14 @@ class Problem {
         * block starts from row i and column j and spans Q.rows() rows
         * and Q.cols() columns
         */
-        void add_Q_block(Index i, Index j, const Matrix& Q) {
+        void add_Q_block(Index i, Index j, const BlockMatrix& Q) {
             if(i + Q.rows() > Q_mtr.rows() || j + Q.cols() > Q_mtr.cols()) {
                 throw std::domain_error(
                     std::string("given Q block matrix runs of the Q of the problem")
                 );
             }
 
-            Q_mtr.block(i, j, Q.rows(), Q.cols()) += Q;
-            ensure_Q_symmetry();
+            accumulate_Q_block(i, j, Q);
         }
 
         /*
@@ -326,60 +459,149 @@ class Problem {
             eigen values are allowed to be more than -tolerance.
         */
         bool is_Q_psd(T tolerance = 0) const {
-            // compute of Q is psd on the fly
-            Eigen::EigenSolver<Matrix> eigen_solver(Q_mtr, false);
-            const auto& eigen_values = eigen_solver.eigenvalues();
-
-            for(Index i = 0; i < eigen_values.rows(); i++) {
-                auto eigen_value = eigen_values(i);
-                if(eigen_value.real() < -tolerance) {
-                    return false;
-                }
-            }
-            return true;
+            return classify_Q(tolerance) != QDefiniteness::Indefinite;
         }
 
         /*
-            Regulatizes Q to be a PSD if it is not and the minimum eigenvalue is not less than
-            psd_tolerance
+            Regularizes a Q that is PSD up to psd_tolerance but not positive
+            definite. If the lower bound of the minimum eigenvalue estimated
+            with the given method is in [-psd_tolerance, 0), (psd_tolerance -
+            lower_bound) * I is added to Q once, so that the minimum eigenvalue
+            becomes at least psd_tolerance. Q is left as it is otherwise, in
+            particular when it is indefinite beyond psd_tolerance, so that a
+            nonconvex problem stays nonconvex. With the Exact method, a
+            positive definite Q is recognized by a Cholesky factorization
+            unless an estimate is requested. If estimate is not null, the
+            estimate used is written to it.
         */
-        void regularize_Q(T psd_tolerance = 0) {
-            Eigen::EigenSolver<Matrix> eigen_solver(Q_mtr, false);
-            const auto& eigen_values = eigen_solver.eigenvalues();
+        void regularize_Q(T psd_tolerance = 0,
+                          EigenvalueEstimation method = EigenvalueEstimation::Exact,
+                          EigenvalueEstimate<T>* estimate = nullptr) {
+            if(method == EigenvalueEstimation::Exact && estimate == nullptr && is_Q_pd()) {
+                return;
+            }
 
-            T min_eig = std::numeric_limits<T>::max();
-            for(Index i = 0; i < eigen_values.rows(); i++) {
-                auto eigen_value = eigen_values(i);
-                min_eig = std::min(min_eig, eigen_value.real());
+            EigenvalueEstimate<T> min_eig = estimate_Q_min_eigenvalue(method);
+            if(estimate != nullptr) {
+                *estimate = min_eig;
             }
-            // std::cout << std::endl;
-            while(min_eig < 0 && min_eig >= -psd_tolerance) {
-                Q_mtr += Matrix::Identity(num_vars(), num_vars()) * psd_tolerance;
 
-                Eigen::EigenSolver<Matrix> eigen_solver(Q_mtr, false);
-                const auto& eigen_values = eigen_solver.eigenvalues();
-                min_eig = std::numeric_limits<T>::max();
-                for(Index i = 0; i < eigen_values.rows(); i++) {
-                    auto eigen_value = eigen_values(i);
-                    min_eig = std::min(min_eig, eigen_value.real());
-                }
+            if(min_eig.lower_bound >= 0 || min_eig.lower_bound < -psd_tolerance) {
+                return;
+            }
+            T shift = psd_tolerance - min_eig.lower_bound;
+
+            Q_mtr.diagonal().array() += shift;
+            versions.Q = new_version_stamp();
+
+            // shifting Q shifts every eigenvalue by the same amount, so the
+            // exact minimum eigenvalue stays known.
+            Q_class_cache = QClassCache();
+            Q_class_cache.version = versions.Q;
+            if(method == EigenvalueEstimation::Exact) {
+                Q_class_cache.min_eig_known = true;
+                Q_class_cache.min_eig = min_eig.value + shift;
+            }
+        }
+
+        /*
+            Estimates the minimum eigenvalue of Q with the given method.
+            Lanczos and Gershgorin estimates only read the upper triangle of Q
+            and do not need a factorization, hence are preferable for large Q.
+        */
+        EigenvalueEstimate<T> estimate_Q_min_eigenvalue(
+                EigenvalueEstimation method = EigenvalueEstimation::Exact) const {
+            EigenvalueEstimate<T> estimate;
+            if(method == EigenvalueEstimation::Lanczos) {
+                estimate = lanczos_min_eigenvalue(Q_mtr);
+            } else if(method == EigenvalueEstimation::Gershgorin) {
+                estimate.value = estimate.lower_bound = gershgorin_lower_bound(Q_mtr);
+            } else {
+                estimate.value = estimate.lower_bound = Q_min_eigenvalue();
+                estimate.iterations = num_vars();
             }
+            return estimate;
         }
 
         /*
             return if Q is a PD matrix
         */
         bool is_Q_pd() const {
-            Eigen::EigenSolver<Matrix> eigen_solver(Q_mtr, false);
-            const auto& eigen_values = eigen_solver.eigenvalues();
+            return classify_Q() == QDefiniteness::PositiveDefinite;
+        }
 
-            for(Index i = 0; i < eigen_values.rows(); i++) {
-                auto eigen_value = eigen_values(i);
-                if(eigen_value.real() <= 0) {
-                    return false;
-                }
+        /*
+            Classifies Q as positive definite, positive semidefinite where
+            eigenvalues are allowed to be more than -tolerance, or indefinite.
+            Tries a Cholesky and then a pivoted LDLT factorization, and only
+            falls back to an eigenvalue decomposition if both fail. Results
+            are cached until Q is modified.
+        */
+        QDefiniteness classify_Q(T tolerance = 0) const {
+            refresh_Q_class_cache();
+
+            if(!Q_class_cache.llt_known) {
+                Eigen::LLT<Matrix, Eigen::Upper> llt(Q_mtr);
+                Q_class_cache.is_pd = llt.info() == Eigen::Success;
+                Q_class_cache.llt_known = true;
             }
-            return true;
+
+            if(Q_class_cache.is_pd) {
+                return QDefiniteness::PositiveDefinite;
+            }
+
+            if(Q_class_cache.min_eig_known) {
+                return Q_class_cache.min_eig > 0 ? QDefiniteness::PositiveDefinite
+                     : Q_class_cache.min_eig >= -tolerance ? QDefiniteness::PositiveSemidefinite
+                     : QDefiniteness::Indefinite;
+            }
+
+            if(!Q_class_cache.ldlt_known) {
+                Eigen::LDLT<Matrix, Eigen::Upper> ldlt(Q_mtr);
+                Q_class_cache.is_psd = ldlt.info() == Eigen::Success && ldlt.isPositive();
+                Q_class_cache.ldlt_known = true;
+            }
+
+            if(Q_class_cache.is_psd) {
+                return QDefiniteness::PositiveSemidefinite;
+            }
+
+            return Q_min_eigenvalue() >= -tolerance ? QDefiniteness::PositiveSemidefinite
+                                                    : QDefiniteness::Indefinite;
+        }
+
+        /*
+            Minimum eigenvalue of Q. Computed by a self adjoint eigenvalue
+            decomposition and cached until Q is modified.
+        */
+        T Q_min_eigenvalue() const {
+            refresh_Q_class_cache();
+
+            if(!Q_class_cache.min_eig_known) {
+                Eigen::SelfAdjointEigenSolver<Matrix> eigen_solver(Q(), Eigen::EigenvaluesOnly);
+                const auto& eigen_values = eigen_solver.eigenvalues();
+                Q_class_cache.min_eig = eigen_values.rows() == 0
+                                        ? std::numeric_limits<T>::max()
+                                        : eigen_values.minCoeff();
+                Q_class_cache.min_eig_known = true;
+            }
+
+            return Q_class_cache.min_eig;
+        }
+
+        /*
+            Version stamp of Q, which changes every time Q changes.
+        */
+        inline std::size_t Q_version() const {
+            return versions.Q;
+        }
+
+        /*
+            Versions of the parts of the problem, which engines compare
+            with the versions they last solved to update only what changed.
+        */
+        const ProblemVersion& version() const {
+            return versions;
         }
 
         /*
@@ -396,13 +618,14 @@ class Problem {
                             );
             }
             c_mtr += c;
+            versions.c = new_version_stamp();
         }
 
         /*
         * Adds given vector to the block of c of the problem where
         * block starts from row i and spans c.rows() rows
         */
-        void add_c_block(Index i, const Vector& c) {
+        void add_c_block(Index i, const BlockVector& c) {
             if(i + c.rows() > c_mtr.rows()) {
                 throw std::domain_error(
                     std::string("given c block is out of bounds of the original c")
@@ -410,10 +633,26 @@ class Problem {
             }
 
             c_mtr.block(i, 0, c.rows(), 1) += c;
+            versions.c = new_version_stamp();
         }
 
 
+        /*
+            Returns the symmetric Q. Mirrors the blocks of the upper triangle
+            that are modified since the last read to the lower triangle first,
+            hence concurrent calls on the same problem are not safe.
+        */
         const Matrix& Q() const {
+            mirror_Q_upper_triangle();
+            return Q_mtr;
+        }
+
+        /*
+            Returns Q where only the upper triangle, diagonal included, is
+            guaranteed to be up to date. Can be used instead of Q() when only
+            the upper triangle is consumed, to skip the symmetrization.
+        */
+        const Matrix& Q_upper() const {
             return Q_mtr;
         }
 
@@ -421,16 +660,16 @@ class Problem {
             return c_mtr;
         }
 
-        const Matrix& A() const {
-            return A_mtr;
+        ConstMatrixRows A() const {
+            return A_mtr.topRows(constraint_count);
         }
 
-        const Vector& lb() const {
-            return lb_mtr;
+        ConstVectorSegment lb() const {
+            return lb_mtr.head(constraint_count);
         }
 
-        const Vector& ub() const {
-            return ub_mtr;
+        ConstVectorSegment ub() const {
+            return ub_mtr.head(constraint_count);
         }
  
         const Vector& lbx() const {
@@ -442,20 +681,21 @@ class Problem {
         }
 
         /*
-            Cast problem into type S
+            Cast problem into type S. Infinite limits stay infinite.
         */
         template<class S>
-        Problem<S> cast() const {
-            Problem<S> new_problem;
-            new_problem.Q_mtr = Q_mtr.template cast<S>();
-            new_problem.A_mtr = A_mtr.template cast<S>();
+        Problem<S, NumVars, MaxConstraints> cast() const {
+            Problem<S, NumVars, MaxConstraints> new_problem;
+            new_problem.Q_mtr = Q().template cast<S>();
+            new_problem.A_mtr = A().template cast<S>();
             new_problem.c_mtr = c_mtr.template cast<S>();
-            new_problem.lb_mtr = lb_mtr.template cast<S>();
-            new_problem.ub_mtr = ub_mtr.template cast<S>();
-            new_problem.lbx_mtr = lbx_mtr.template cast<S>();
-            new_problem.ubx_mtr = ubx_mtr.template cast<S>();
+            new_problem.lb_mtr = problem_detail::cast_limits<S>(lb());
+            new_problem.ub_mtr = problem_detail::cast_limits<S>(ub());
+            new_problem.lbx_mtr = problem_detail::cast_limits<S>(lbx_mtr);
+            new_problem.ubx_mtr = problem_detail::cast_limits<S>(ubx_mtr);
             new_problem.soft_convertible = soft_convertible;
-            new_problem.soft_weights = soft_weights.template cast<S>();
+            new_problem.soft_weights = soft_weights.head(constraint_count).template cast<S>();
+            new_problem.constraint_count = constraint_count;
 
             return new_problem;
         }
@@ -497,14 +737,15 @@ class Problem {
                 );
             }
 
-            Vector constraint_mtr = A_mtr * solution;
-
-            for(int i = 0; i < num_constraints(); i++) {
-                if(lb_mtr(i) - tolerance > constraint_mtr(i)) {
+            // rows are evaluated one by one instead of forming A * solution,
+            // so that verifying does not allocate.
+            for(Index i = 0; i < num_constraints(); i++) {
+                T value = A_mtr.row(i).dot(solution);
+                if(lb_mtr(i) - tolerance > value) {
                     return false;
                 }
 
-                if(constraint_mtr(i) > ub_mtr(i) + tolerance) {
+                if(value > ub_mtr(i) + tolerance) {
                     return false;
                 }
             }
@@ -522,6 +763,10 @@ class Problem {
             return true;
         }
 
+        /*
+            Returns 1/2 solution^T Q solution + c^T solution. Only reads the
+            upper triangle of Q and does not allocate.
+        */
         T objective(const Vector& solution) const {
             if(solution.rows() != num_vars()) {
                 throw std::domain_error(
@@ -533,28 +778,231 @@ class Problem {
                 );
             }
 
-            return (solution.transpose() * Q() * solution + c().transpose() * solution)(0, 0);
+            // x^T Q x = sum_i x_i (Q_ii x_i + 2 sum_{j > i} Q_ij x_j)
+            T quadratic = 0;
+            Index n = num_vars();
+            for(Index i = 0; i < n; i++) {
+                T off_diagonal = Q_mtr.row(i).tail(n - i - 1).dot(solution.tail(n - i - 1));
+                quadratic += solution(i) * (Q_mtr(i, i) * solution(i) + 2 * off_diagonal);
+            }
+
+            return quadratic / 2 + c_mtr.dot(solution);
         }
 
+        template<typename S, int OtherVars, int OtherConstraints>
+        friend class Problem;
+        template<typename ProblemType>
+        friend class SoftConversion;
+        template<typename ProblemType>
+        friend class Scaling;
+        template<typename ProblemType, typename Low>
+        friend class MixedPrecision;
+        template<typename ProblemType>
+        friend class ParametricProblem;
+        template<typename ProblemType>
+        friend class ProblemBuilder;
         template<typename S>
-        friend std::ostream& operator<<(std::ostream& os, const Problem<S>& problem);
+        friend class ProblemReader;
+        template<typename S, int Vars, int Constraints>
+        friend std::ostream& operator<<(std::ostream& os, const Problem<S, Vars, Constraints>& problem);
         template<typename S>
         friend std::istream& operator>>(std::istream& is, Problem<S>& problem);
 
     private:
-        Problem() {} // for internal operations (like casting)
+        Problem(): constraint_count(0) {} // for internal operations (like casting)
 
-        Matrix Q_mtr, A_mtr;
-        Vector c_mtr, lb_mtr, ub_mtr, lbx_mtr, ubx_mtr;
+        // Q_mtr is mutable since Q() const brings its lower triangle up to date
+        mutable Matrix Q_mtr;
+        ConstraintMatrix A_mtr;
+        Vector c_mtr, lbx_mtr, ubx_mtr;
+        ConstraintVector lb_mtr, ub_mtr;
 
         // soft_convertible[i] is  true if and only if i^th constraint
         // must be converted to a soft constraint when convert_to_soft
         // is called. soft_weights[i] has the weight of the conversion.
-        Vector soft_weights; // must have size num_constraints
-        std::vector<bool> soft_convertible; // must have size num_constraints
+        ConstraintVector soft_weights; // must have size num_constraints
+        problem_detail::SoftFlags<MaxConstraints> soft_convertible; // must have size num_constraints
+
+        // blocks of Q_mtr whose upper triangle entries are modified after
+        // the last time the lower triangle is mirrored. If Q_fully_dirty
+        // is set, whole Q_mtr must be mirrored instead.
+        struct QBlock {
+            Index row, col, rows, cols;
+        };
+        mutable std::vector<QBlock> Q_dirty_blocks;
+        mutable Index Q_dirty_area = 0;
+        mutable bool Q_fully_dirty = false;
+
+        // versions holds the stamp of the last modification of each part.
+        // Q_class_cache holds the definiteness results computed for Q
+        // when the version of Q was equal to its version.
+        ProblemVersion versions = ProblemVersion::fresh();
+
+        struct QClassCache {
+            std::size_t version = 0;
+            bool llt_known = false, is_pd = false;
+            bool ldlt_known = false, is_psd = false;
+            bool min_eig_known = false;
+            T min_eig = 0;
+        };
+        mutable QClassCache Q_class_cache;
+
+        // first constraint_count rows of A_mtr, lb_mtr, ub_mtr and
+        // soft_weights hold the constraints, the rest is spare capacity.
+        Index constraint_count;
 
         static constexpr Eigen::NoChange_t no_change();
 
+        /*
+            Makes room for rows more constraints, growing the capacity
+            geometrically so that adding constraints one by one takes
+            amortized constant time per constraint.
+        */
+        void grow_constraints(Index rows) {
+            Index required = constraint_count + rows;
+            if(required > constraint_capacity()) {
+                // storage of fixed size problems is in the object, so it is
+                // grown to the maximum at once.
+                reserve(MaxConstraints == Eigen::Dynamic
+                        ? std::max(required, 2 * constraint_capacity())
+                        : std::max(required, Index(MaxConstraints)));
+            }
+        }
+
+        static void check_compile_time_sizes(Index N, Index M) {
+            if(NumVars != Eigen::Dynamic && N != NumVars) {
+                throw std::domain_error(
+                    std::string("Problem has ")
+                    + std::to_string(NumVars)
+                    + std::string(" variables at compile time, but ")
+                    + std::to_string(N)
+                    + std::string(" variables are requested.")
+                );
+            }
+
+            if(MaxConstraints != Eigen::Dynamic && M > MaxConstraints) {
+                throw std::domain_error(
+                    std::string("Problem can hold at most ")
+                    + std::to_string(MaxConstraints)
+                    + std::string(" constraints, but ")
+                    + std::to_string(M)
+                    + std::string(" constraints are requested.")
+                );
+            }
+        }
+
+        /*
+            Adds the symmetric part of Q to the block of Q_mtr starting from
+            row i and column j. The contribution of each off-diagonal entry is
+            split between (r, c) and (c, r), both of which live in the same
+            upper triangle entry, so only the upper triangle is written.
+        */
+        template<typename Derived>
+        void accumulate_Q_block(Index i, Index j, const Eigen::MatrixBase<Derived>& Q) {
+            versions.Q = new_version_stamp();
+
+            for(Index r = 0; r < Q.rows(); r++) {
+                for(Index c = 0; c < Q.cols(); c++) {
+                    Index row = i + r, col = j + c;
+                    if(row == col) {
+                        Q_mtr(row, col) += Q(r, c);
+                    } else {
+                        Q_mtr(std::min(row, col), std::max(row, col)) += Q(r, c) / 2;
+                    }
+                }
+            }
+
+            // fixed size Q is small enough to be mirrored as a whole, and
+            // keeping a list of blocks would allocate.
+            if(Q_fully_dirty || NumVars != Eigen::Dynamic) {
+                Q_fully_dirty = true;
+                return;
+            }
+
+            Q_dirty_blocks.push_back(QBlock{i, j, Q.rows(), Q.cols()});
+            Q_dirty_area += Q.rows() * Q.cols();
+
+            // once mirroring dirty blocks one by one would cost more than
+            // mirroring the whole matrix, mirror the whole matrix instead.
+            if(Q_dirty_area >= Q_mtr.size()) {
+                Q_dirty_blocks.clear();
+                Q_dirty_area = 0;
+                Q_fully_dirty = true;
+            }
+        }
+
+        void refresh_Q_class_cache() const {
+            if(Q_class_cache.version != versions.Q) {
+                Q_class_cache = QClassCache();
+                Q_class_cache.version = versions.Q;
+            }
+        }
+
+        /*
+            Copies the modified entries of the upper triangle of Q to the
+            lower triangle.
+        */
+        void mirror_Q_upper_triangle() const {
+            if(Q_fully_dirty) {
+                for(Index r = 0; r < Q_mtr.rows(); r++) {
+                    for(Index c = r + 1; c < Q_mtr.cols(); c++) {
+                        Q_mtr(c, r) = Q_mtr(r, c);
+                    }
+                }
+                Q_fully_dirty = false;
+                return;
+            }
+
+            for(const auto& block: Q_dirty_blocks) {
+                for(Index r = block.row; r < block.row + block.rows; r++) {
+                    for(Index c = block.col; c < block.col + block.cols; c++) {
+                        if(r > c) {
+                            Q_mtr(r, c) = Q_mtr(c, r);
+                        } else if(r < c) {
+                            Q_mtr(c, r) = Q_mtr(r, c);
+                        }
+                    }
+                }
+            }
+            Q_dirty_blocks.clear();
+            Q_dirty_area = 0;
+        }
+
+        /*
+            Resizes the storage for a problem with n variables and m
+            constraints that is about to be read into it. Constraint
+            storage is kept when it is large enough, so that reading
+            problems of similar sizes into the same object does not
+            reallocate.
+        */
+        void resize_for_load(Index n, Index m) {
+            Q_mtr.resize(n, n);
+            c_mtr.resize(n);
+            lbx_mtr.resize(n);
+            ubx_mtr.resize(n);
+            if(A_mtr.cols() != n || constraint_capacity() < m) {
+                A_mtr.resize(m, n);
+                lb_mtr.resize(m);
+                ub_mtr.resize(m);
+                soft_weights.resize(m);
+            }
+            soft_convertible.resize(m);
+            constraint_count = m;
+            versions = ProblemVersion::fresh();
+        }
+
+        /*
+            Symmetrizes a Q_mtr that is written entry by entry, and marks Q
+            as modified.
+        */
+        void finish_Q_load() {
+            ensure_Q_symmetry();
+            versions.Q = new_version_stamp();
+            Q_dirty_blocks.clear();
+            Q_dirty_area = 0;
+            Q_fully_dirty = false;
+        }
+
         void ensure_Q_symmetry() {
             for(Index i = 0; i < Q_mtr.rows(); i++) {
                 for (Index j = i+1; j < Q_mtr.cols(); j++) {
@@ -565,17 +1013,17 @@ class Problem {
 
 };
 
-template<typename T>
-std::ostream& operator<<(std::ostream& os, const Problem<T>& problem) {
+template<typename T, int NumVars, int MaxConstraints>
+std::ostream& operator<<(std::ostream& os, const Problem<T, NumVars, MaxConstraints>& problem) {
     auto before_precision = os.precision();
     
     os.precision(std::numeric_limits<T>::max_digits10);
 
-    int n = problem.A_mtr.cols(), m = problem.A_mtr.rows();
+    int n = problem.A_mtr.cols(), m = problem.num_constraints();
     os << std::fixed << n << " " << m << std::endl;
     for(int i = 0; i < n; i++) {
         for(int j = 0; j < n; j++) {
-            os << problem.Q_mtr(i, j) << " ";
+            os << problem.Q()(i, j) << " ";
         }
         os << std::endl;
     }
@@ -634,16 +1082,7 @@ template<typename T>
 std::istream& operator>>(std::istream& is, Problem<T>& problem) {
     int n,m;
     is >> n >> m;
-    // problem.variable_count = n;
-    problem.Q_mtr.resize(n, n);
-    problem.c_mtr.resize(n);
-    problem.lbx_mtr.resize(n);
-    problem.ubx_mtr.resize(n);
-    problem.A_mtr.resize(m, n);
-    problem.lb_mtr.resize(m);
-    problem.ub_mtr.resize(m);
-    problem.soft_weights.resize(m);
-    problem.soft_convertible.resize(m);
+    problem.resize_for_load(n, m);
 
     for(int i = 0; i < n; i++) {
         for(int j = 0; j < n; j++) {
@@ -651,7 +1090,7 @@ std::istream& operator>>(std::istream& is, Problem<T>& problem) {
         }
     }
 
-    problem.ensure_Q_symmetry();
+    problem.finish_Q_load();
 
 
     for(int i = 0; i < m; i++) {
@@ -697,7 +1136,31 @@ std::istream& operator>>(std::istream& is, Problem<T>& problem) {
     return is;
 }
 
+namespace problem_detail {
+
+/*
+    Problem with no variables, or with the compile time number of them if
+    it is fixed, as the initial value of problems kept by other classes.
+*/
+template<typename ProblemType>
+struct EmptyProblem {
+    static ProblemType make() {
+        return ProblemType(0);
+    }
+};
+
+template<typename T, int NumVars, int MaxConstraints>
+struct EmptyProblem<Problem<T, NumVars, MaxConstraints>> {
+    static Problem<T, NumVars, MaxConstraints> make() {
+        return Problem<T, NumVars, MaxConstraints>(NumVars == Eigen::Dynamic ? 0 : NumVars);
+    }
+};
+
+}
+
 }
 
 
-#endif
\ No newline at end of file
+#include "soft_conversion.hpp"
+
+#endif
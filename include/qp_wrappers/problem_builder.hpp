@@ -0,0 +1,622 @@
+#ifndef QPWRAPPERS_PROBLEM_BUILDER_HPP
+#define QPWRAPPERS_PROBLEM_BUILDER_HPP
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include "problem.hpp"
+#include "sparse_problem.hpp"
+#include "types.hpp"
+
+
+namespace QPWrappers {
+
+/*
+    The variables x(start), ..., x(start + size - 1) of a problem. Used in
+    an expression, it stands for the term I x of the segment.
+*/
+template<typename T>
+class Variables {
+    public:
+        using Scalar = T;
+        using Index = Eigen::Index;
+
+        Variables(Index start, Index size): first(start), count(size) {}
+
+        /*
+            Returns the variables from start to start + size - 1 of this segment.
+        */
+        Variables segment(Index start, Index size) const {
+            if(start < 0 || size < 0 || start + size > count) {
+                throw std::domain_error(
+                    std::string("segment [")
+                    + std::to_string(start)
+                    + std::string(", ")
+                    + std::to_string(start + size)
+                    + std::string(") runs off the ")
+                    + std::to_string(count)
+                    + std::string(" variables.")
+                );
+            }
+            return Variables(first + start, size);
+        }
+
+        inline Index start() const {
+            return first;
+        }
+
+        inline Index size() const {
+            return count;
+        }
+
+        inline Index rows() const {
+            return count;
+        }
+
+        template<typename F>
+        void for_each_entry(F f) const {
+            for(Index k = 0; k < count; k++) {
+                f(k, first + k, T(1));
+            }
+        }
+
+        template<typename F>
+        void for_each_gram_entry(F f) const {
+            for(Index k = 0; k < count; k++) {
+                f(first + k, first + k, T(1));
+            }
+        }
+
+        template<typename V, typename F>
+        void for_each_transposed(const V& r, F f) const {
+            for(Index k = 0; k < count; k++) {
+                f(first + k, r(k));
+            }
+        }
+
+    private:
+        Index first, count;
+};
+
+namespace builder_detail {
+
+inline void check_rows(Eigen::Index expected, Eigen::Index given, const char* what) {
+    if(expected != given) {
+        throw std::domain_error(
+            std::string("expression has ")
+            + std::to_string(expected)
+            + std::string(" rows, but ")
+            + std::string(what)
+            + std::string(" has ")
+            + std::to_string(given)
+            + std::string(".")
+        );
+    }
+}
+
+inline void check_cols(Eigen::Index cols, Eigen::Index vars) {
+    if(cols != vars) {
+        throw std::domain_error(
+            std::string("matrix has ")
+            + std::to_string(cols)
+            + std::string(" columns, but the variable segment has ")
+            + std::to_string(vars)
+            + std::string(" variables.")
+        );
+    }
+}
+
+/*
+    Term M x of a dense matrix M and a segment x. It refers to M, so
+    like Eigen expressions, it must be used in the statement it is
+    written in.
+
+    Terms visit the nonzero entries of M, the nonzero entries of the
+    upper triangle of M^T M and the entries of M^T r with the variable
+    indices of the problem, so that they can be added to its storage
+    without forming any of them.
+*/
+template<typename Derived>
+class DenseTerm {
+    public:
+        using Scalar = typename Derived::Scalar;
+        using Index = Eigen::Index;
+
+        DenseTerm(const Derived& M, const Variables<Scalar>& x): M(M), x(x) {
+            check_cols(M.cols(), x.size());
+        }
+
+        inline Index rows() const {
+            return M.rows();
+        }
+
+        template<typename F>
+        void for_each_entry(F f) const {
+            for(Index k = 0; k < M.rows(); k++) {
+                for(Index i = 0; i < M.cols(); i++) {
+                    Scalar value = M(k, i);
+                    if(value != Scalar(0)) {
+                        f(k, x.start() + i, value);
+                    }
+                }
+            }
+        }
+
+        template<typename F>
+        void for_each_gram_entry(F f) const {
+            for(Index i = 0; i < M.cols(); i++) {
+                for(Index j = i; j < M.cols(); j++) {
+                    Scalar value = M.col(i).dot(M.col(j));
+                    if(value != Scalar(0)) {
+                        f(x.start() + i, x.start() + j, value);
+                    }
+                }
+            }
+        }
+
+        template<typename V, typename F>
+        void for_each_transposed(const V& r, F f) const {
+            for(Index i = 0; i < M.cols(); i++) {
+                f(x.start() + i, M.col(i).dot(r));
+            }
+        }
+
+    private:
+        const Derived& M;
+        Variables<Scalar> x;
+};
+
+/*
+    Term M x of a sparse matrix M and a segment x. M^T M is formed as a
+    sparse matrix, and the entries of M^T r are visited once per nonzero
+    of M, since they are added rather than assigned.
+*/
+template<typename T, int Options, typename StorageIndex>
+class SparseTerm {
+    public:
+        using Scalar = T;
+        using Index = Eigen::Index;
+        using SparseMatrix = Eigen::SparseMatrix<T, Options, StorageIndex>;
+
+        SparseTerm(const SparseMatrix& M, const Variables<T>& x): M(M), x(x) {
+            check_cols(M.cols(), x.size());
+        }
+
+        inline Index rows() const {
+            return M.rows();
+        }
+
+        template<typename F>
+        void for_each_entry(F f) const {
+            for(Index k = 0; k < M.outerSize(); k++) {
+                for(typename SparseMatrix::InnerIterator it(M, k); it; ++it) {
+                    f(it.row(), x.start() + it.col(), it.value());
+                }
+            }
+        }
+
+        template<typename F>
+        void for_each_gram_entry(F f) const {
+            Eigen::SparseMatrix<T, Eigen::ColMajor> gram = M.transpose() * M;
+            for(Index k = 0; k < gram.outerSize(); k++) {
+                for(typename Eigen::SparseMatrix<T, Eigen::ColMajor>::InnerIterator it(gram, k); it; ++it) {
+                    if(it.row() <= it.col()) {
+                        f(x.start() + it.row(), x.start() + it.col(), it.value());
+                    }
+                }
+            }
+        }
+
+        template<typename V, typename F>
+        void for_each_transposed(const V& r, F f) const {
+            for(Index k = 0; k < M.outerSize(); k++) {
+                for(typename SparseMatrix::InnerIterator it(M, k); it; ++it) {
+                    f(x.start() + it.col(), it.value() * r(it.row()));
+                }
+            }
+        }
+
+    private:
+        const SparseMatrix& M;
+        Variables<T> x;
+};
+
+template<typename X>
+struct is_term: std::false_type {};
+
+template<typename T>
+struct is_term<Variables<T>>: std::true_type {};
+
+template<typename Derived>
+struct is_term<DenseTerm<Derived>>: std::true_type {};
+
+template<typename T, int Options, typename StorageIndex>
+struct is_term<SparseTerm<T, Options, StorageIndex>>: std::true_type {};
+
+template<typename Term, typename Result = void>
+using enable_if_term = typename std::enable_if<is_term<Term>::value, Result>::type;
+
+/*
+    Term + sign * r, where there is no r if it is null.
+*/
+template<typename Term, typename V>
+struct Affine {
+    Term term;
+    const V* offset;
+    typename Term::Scalar sign;
+};
+
+/*
+    weight * ||affine||^2
+*/
+template<typename Term, typename V>
+struct Squared {
+    Affine<Term, V> affine;
+    typename Term::Scalar weight;
+};
+
+/*
+    v^T x
+*/
+template<typename V, typename T>
+struct Linear {
+    using Scalar = T;
+
+    const V& v;
+    Variables<T> x;
+    T weight;
+};
+
+/*
+    Limits of a constraint, either a vector or the same scalar for every row.
+    Open limits are the scalar limits of the missing side of a one sided
+    constraint.
+*/
+template<typename T>
+struct ScalarLimit {
+    T value;
+
+    T operator()(Eigen::Index) const {
+        return value;
+    }
+
+    Eigen::Index rows(Eigen::Index expected) const {
+        return expected;
+    }
+};
+
+template<typename T>
+struct OpenLimit: ScalarLimit<T> {};
+
+template<typename V>
+struct VectorLimit {
+    const V& values;
+
+    typename V::Scalar operator()(Eigen::Index i) const {
+        return values(i);
+    }
+
+    Eigen::Index rows(Eigen::Index) const {
+        return values.rows();
+    }
+};
+
+/*
+    low <= term <= up
+*/
+template<typename Term, typename Low, typename Up>
+struct Bounded {
+    Term term;
+    Low low;
+    Up up;
+};
+
+template<typename Term>
+OpenLimit<typename Term::Scalar> open_low() {
+    return OpenLimit<typename Term::Scalar>{{std::numeric_limits<typename Term::Scalar>::lowest()}};
+}
+
+template<typename Term>
+OpenLimit<typename Term::Scalar> open_up() {
+    return OpenLimit<typename Term::Scalar>{{std::numeric_limits<typename Term::Scalar>::max()}};
+}
+
+}
+
+template<typename Derived>
+builder_detail::DenseTerm<Derived> operator*(const Eigen::MatrixBase<Derived>& M,
+                                             const Variables<typename Derived::Scalar>& x) {
+    return builder_detail::DenseTerm<Derived>(M.derived(), x);
+}
+
+template<typename T, int Options, typename StorageIndex>
+builder_detail::SparseTerm<T, Options, StorageIndex> operator*(const Eigen::SparseMatrix<T, Options, StorageIndex>& M,
+                                                               const Variables<T>& x) {
+    return builder_detail::SparseTerm<T, Options, StorageIndex>(M, x);
+}
+
+template<typename Term, typename V, typename = builder_detail::enable_if_term<Term>>
+builder_detail::Affine<Term, V> operator-(const Term& term, const Eigen::MatrixBase<V>& r) {
+    builder_detail::check_rows(term.rows(), r.rows(), "the subtracted vector");
+    return builder_detail::Affine<Term, V>{term, &r.derived(), typename Term::Scalar(-1)};
+}
+
+template<typename Term, typename V, typename = builder_detail::enable_if_term<Term>>
+builder_detail::Affine<Term, V> operator+(const Term& term, const Eigen::MatrixBase<V>& r) {
+    builder_detail::check_rows(term.rows(), r.rows(), "the added vector");
+    return builder_detail::Affine<Term, V>{term, &r.derived(), typename Term::Scalar(1)};
+}
+
+/*
+    ||term - r||^2 or ||term + r||^2
+*/
+template<typename Term, typename V>
+builder_detail::Squared<Term, V> squared(const builder_detail::Affine<Term, V>& affine) {
+    return builder_detail::Squared<Term, V>{affine, typename Term::Scalar(1)};
+}
+
+/*
+    ||term||^2
+*/
+template<typename Term, typename = builder_detail::enable_if_term<Term>>
+builder_detail::Squared<Term, typename Problem<typename Term::Scalar>::Vector> squared(const Term& term) {
+    using V = typename Problem<typename Term::Scalar>::Vector;
+    return builder_detail::Squared<Term, V>{builder_detail::Affine<Term, V>{term, nullptr, typename Term::Scalar(1)},
+                                            typename Term::Scalar(1)};
+}
+
+template<typename Term, typename V>
+builder_detail::Squared<Term, V> operator*(typename Term::Scalar weight, builder_detail::Squared<Term, V> squared) {
+    squared.weight *= weight;
+    return squared;
+}
+
+/*
+    v^T x
+*/
+template<typename V>
+builder_detail::Linear<V, typename V::Scalar> dot(const Eigen::MatrixBase<V>& v, const Variables<typename V::Scalar>& x) {
+    builder_detail::check_rows(x.size(), v.rows(), "the vector");
+    return builder_detail::Linear<V, typename V::Scalar>{v.derived(), x, typename V::Scalar(1)};
+}
+
+template<typename V, typename T>
+builder_detail::Linear<V, T> operator*(typename builder_detail::Linear<V, T>::Scalar weight, builder_detail::Linear<V, T> linear) {
+    linear.weight *= weight;
+    return linear;
+}
+
+template<typename Term, typename = builder_detail::enable_if_term<Term>>
+builder_detail::Bounded<Term, builder_detail::ScalarLimit<typename Term::Scalar>, builder_detail::OpenLimit<typename Term::Scalar>>
+operator<=(typename Term::Scalar low, const Term& term) {
+    return {term, {low}, builder_detail::open_up<Term>()};
+}
+
+template<typename V, typename Term, typename = builder_detail::enable_if_term<Term>>
+builder_detail::Bounded<Term, builder_detail::VectorLimit<V>, builder_detail::OpenLimit<typename Term::Scalar>>
+operator<=(const Eigen::MatrixBase<V>& low, const Term& term) {
+    return {term, {low.derived()}, builder_detail::open_up<Term>()};
+}
+
+template<typename Term, typename = builder_detail::enable_if_term<Term>>
+builder_detail::Bounded<Term, builder_detail::OpenLimit<typename Term::Scalar>, builder_detail::ScalarLimit<typename Term::Scalar>>
+operator<=(const Term& term, typename Term::Scalar up) {
+    return {term, builder_detail::open_low<Term>(), {up}};
+}
+
+template<typename Term, typename V, typename = builder_detail::enable_if_term<Term>>
+builder_detail::Bounded<Term, builder_detail::OpenLimit<typename Term::Scalar>, builder_detail::VectorLimit<V>>
+operator<=(const Term& term, const Eigen::MatrixBase<V>& up) {
+    return {term, builder_detail::open_low<Term>(), {up.derived()}};
+}
+
+/*
+    Upper limit of low <= term <= up, which is parsed as (low <= term) <= up.
+*/
+template<typename Term, typename Low>
+builder_detail::Bounded<Term, Low, builder_detail::ScalarLimit<typename Term::Scalar>>
+operator<=(const builder_detail::Bounded<Term, Low, builder_detail::OpenLimit<typename Term::Scalar>>& bounded,
+           typename Term::Scalar up) {
+    return {bounded.term, bounded.low, {up}};
+}
+
+template<typename Term, typename Low, typename V>
+builder_detail::Bounded<Term, Low, builder_detail::VectorLimit<V>>
+operator<=(const builder_detail::Bounded<Term, Low, builder_detail::OpenLimit<typename Term::Scalar>>& bounded,
+           const Eigen::MatrixBase<V>& up) {
+    return {bounded.term, bounded.low, {up.derived()}};
+}
+
+template<typename Term, typename = builder_detail::enable_if_term<Term>>
+builder_detail::Bounded<Term, builder_detail::ScalarLimit<typename Term::Scalar>, builder_detail::ScalarLimit<typename Term::Scalar>>
+operator==(const Term& term, typename Term::Scalar value) {
+    return {term, {value}, {value}};
+}
+
+template<typename Term, typename V, typename = builder_detail::enable_if_term<Term>>
+builder_detail::Bounded<Term, builder_detail::VectorLimit<V>, builder_detail::VectorLimit<V>>
+operator==(const Term& term, const Eigen::MatrixBase<V>& values) {
+    return {term, {values.derived()}, {values.derived()}};
+}
+
+/**
+    Adds costs and constraints written as expressions over the variables
+    to a Problem or SparseProblem, e.g.
+
+        ProblemBuilder<Problem<double>> builder(problem);
+        auto x = builder.variables();
+        builder.cost += w * squared(D * x.segment(k, 8) - r);
+        builder.cost += dot(g, x);
+        builder.constraint(lb <= G * x <= ub);
+
+    Expressions add their entries to the storage of the problem as they
+    are visited, without forming dense blocks or rows. w ||M x - r||^2
+    adds 2 w M^T M to Q and -2 w M^T r to c, dropping the constant, so
+    that it matches the 1/2 x^T Q x + c^T x objective of the problem.
+    Matrices of expressions can be dense Eigen expressions or sparse
+    matrices, and limits can be vectors or scalars.
+*/
+template<typename ProblemType>
+class ProblemBuilder {
+    public:
+        using T = typename ProblemType::Scalar;
+        using Index = Eigen::Index;
+
+        /*
+            Objective of the problem, which expressions are added to.
+        */
+        class Cost {
+            public:
+                template<typename Term, typename V>
+                Cost& operator+=(const builder_detail::Squared<Term, V>& squared) {
+                    builder.add_squared(squared);
+                    return *this;
+                }
+
+                template<typename V>
+                Cost& operator+=(const builder_detail::Linear<V, T>& linear) {
+                    builder.add_linear(linear);
+                    return *this;
+                }
+
+            private:
+                friend class ProblemBuilder;
+
+                explicit Cost(ProblemBuilder& builder): builder(builder) {}
+
+                ProblemBuilder& builder;
+        };
+
+        explicit ProblemBuilder(ProblemType& problem): cost(*this), problem(problem) {}
+
+        ProblemBuilder(const ProblemBuilder& rhs) = delete;
+        ProblemBuilder& operator=(const ProblemBuilder& rhs) = delete;
+
+        /*
+            All variables of the problem.
+        */
+        Variables<T> variables() const {
+            return Variables<T>(0, problem.num_vars());
+        }
+
+        /*
+            Adds a constraint for each row of the expression, i.e.
+            low(k) <= (M x)(k) <= up(k).
+        */
+        template<typename Term, typename Low, typename Up>
+        void constraint(const builder_detail::Bounded<Term, Low, Up>& bounded,
+                        bool is_soft_convertible = false, T soft_weight = T(1)) {
+            Index rows = bounded.term.rows();
+            builder_detail::check_rows(rows, bounded.low.rows(rows), "the lower limit");
+            builder_detail::check_rows(rows, bounded.up.rows(rows), "the upper limit");
+
+            Index first_row = problem.num_constraints();
+            append_rows(problem, rows, bounded.low, bounded.up, is_soft_convertible, soft_weight);
+            bounded.term.for_each_entry([&](Index k, Index var, T value) {
+                add_A_entry(problem, first_row + k, var, value);
+            });
+        }
+
+        Cost cost;
+
+    private:
+        template<typename Term, typename V>
+        void add_squared(const builder_detail::Squared<Term, V>& squared) {
+            const auto& affine = squared.affine;
+            T scale = 2 * squared.weight;
+
+            affine.term.for_each_gram_entry([&](Index i, Index j, T value) {
+                add_Q_entry(problem, i, j, scale * value);
+            });
+            if(affine.offset != nullptr) {
+                affine.term.for_each_transposed(*affine.offset, [&](Index var, T value) {
+                    problem.c_mtr(var) += scale * affine.sign * value;
+                });
+                problem.versions.c = new_version_stamp();
+            }
+            mark_Q_modified(problem);
+        }
+
+        template<typename V>
+        void add_linear(const builder_detail::Linear<V, T>& linear) {
+            for(Index i = 0; i < linear.x.size(); i++) {
+                problem.c_mtr(linear.x.start() + i) += linear.weight * linear.v(i);
+            }
+            problem.versions.c = new_version_stamp();
+        }
+
+        /*
+            Adds value to Q(i, j) and Q(j, i) for i <= j. The lower triangle
+            of a dense Q is written along with the upper triangle, which is
+            what it is mirrored from, so no block needs to be marked.
+        */
+        template<int NumVars, int MaxConstraints>
+        static void add_Q_entry(Problem<T, NumVars, MaxConstraints>& problem, Index i, Index j, T value) {
+            problem.Q_mtr(i, j) += value;
+            if(i != j) {
+                problem.Q_mtr(j, i) += value;
+            }
+        }
+
+        static void add_Q_entry(SparseProblem<T>& problem, Index i, Index j, T value) {
+            problem.Q_triplets.emplace_back(i, j, value);
+        }
+
+        template<int NumVars, int MaxConstraints>
+        static void mark_Q_modified(Problem<T, NumVars, MaxConstraints>& problem) {
+            problem.versions.Q = new_version_stamp();
+        }
+
+        static void mark_Q_modified(SparseProblem<T>& problem) {
+            problem.Q_dirty = true;
+            problem.versions.Q = new_version_stamp();
+        }
+
+        template<int NumVars, int MaxConstraints, typename Low, typename Up>
+        static void append_rows(Problem<T, NumVars, MaxConstraints>& problem, Index rows,
+                                const Low& low, const Up& up, bool is_soft_convertible, T soft_weight) {
+            problem.grow_constraints(rows);
+
+            Index first_row = problem.constraint_count;
+            problem.A_mtr.middleRows(first_row, rows).setZero();
+            for(Index k = 0; k < rows; k++) {
+                problem.lb_mtr(first_row + k) = low(k);
+                problem.ub_mtr(first_row + k) = up(k);
+            }
+            problem.soft_weights.segment(first_row, rows).setConstant(soft_weight);
+            problem.soft_convertible.resize(first_row + rows, is_soft_convertible);
+            problem.constraint_count += rows;
+            problem.versions.structure = problem.versions.A = problem.versions.limits = new_version_stamp();
+        }
+
+        template<typename Low, typename Up>
+        static void append_rows(SparseProblem<T>& problem, Index rows,
+                                const Low& low, const Up& up, bool is_soft_convertible, T soft_weight) {
+            for(Index k = 0; k < rows; k++) {
+                problem.lb_vec.push_back(low(k));
+                problem.ub_vec.push_back(up(k));
+            }
+            problem.soft_weights_vec.insert(problem.soft_weights_vec.end(), rows, soft_weight);
+            problem.soft_convertible.insert(problem.soft_convertible.end(), rows, is_soft_convertible);
+            problem.A_dirty = true;
+            problem.versions.structure = problem.versions.A = problem.versions.limits = new_version_stamp();
+        }
+
+        template<int NumVars, int MaxConstraints>
+        static void add_A_entry(Problem<T, NumVars, MaxConstraints>& problem, Index row, Index col, T value) {
+            problem.A_mtr(row, col) += value;
+        }
+
+        static void add_A_entry(SparseProblem<T>& problem, Index row, Index col, T value) {
+            problem.A_triplets.emplace_back(row, col, value);
+        }
+
+        ProblemType& problem;
+};
+
+}
+
+#endif
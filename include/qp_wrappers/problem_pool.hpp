@@ -0,0 +1,130 @@
+#ifndef QPWRAPPERS_PROBLEM_POOL_HPP
+#define QPWRAPPERS_PROBLEM_POOL_HPP
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace QPWrappers {
+
+/*
+    A thread safe pool of reusable problems of type ProblemType, which is
+    Problem or SparseProblem.
+
+    acquire(N, M) hands out a problem with N variables and no constraints
+    that can hold M constraints without reallocating. Problems return to
+    the pool when their handles are destroyed, and later acquire calls
+    with the same shape reuse them after a reset, which keeps their
+    storage. Hence a loop that builds and solves problems of a few shapes
+    stops allocating once the pool holds enough problems of each shape.
+
+    The pool must outlive the handles it hands out.
+*/
+template<typename ProblemType>
+class ProblemPool {
+    public:
+        using Index = typename ProblemType::Index;
+
+        /*
+            Deleter of handles, which gives the problem back to the pool.
+        */
+        class Release {
+            public:
+                Release(): pool(nullptr) {}
+
+                Release(ProblemPool* pool, std::pair<Index, Index> shape): pool(pool), shape(shape) {}
+
+                void operator()(ProblemType* problem) const {
+                    pool->release(shape, problem);
+                }
+
+            private:
+                ProblemPool* pool;
+                std::pair<Index, Index> shape;
+        };
+
+        using Handle = std::unique_ptr<ProblemType, Release>;
+
+        ProblemPool() = default;
+
+        ProblemPool(const ProblemPool& rhs) = delete;
+        ProblemPool& operator=(const ProblemPool& rhs) = delete;
+
+        /*
+            Returns a problem with N variables, no constraints, objective 0
+            and no variable limits that can hold at least M constraints
+            without reallocating.
+        */
+        Handle acquire(Index N, Index M = 0) {
+            std::pair<Index, Index> shape(N, M);
+            std::unique_ptr<ProblemType> problem;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                Shelf& shelf = shelves[shape];
+                if(shelf.free.empty()) {
+                    // the shelf can take back every problem of its shape
+                    // without growing when they are released.
+                    shelf.free.reserve(++shelf.created);
+                } else {
+                    problem = std::move(shelf.free.back());
+                    shelf.free.pop_back();
+                }
+            }
+
+            if(problem) {
+                problem->reset();
+            } else {
+                problem.reset(new ProblemType(N));
+                problem->reserve(M);
+            }
+
+            return Handle(problem.release(), Release(this, shape));
+        }
+
+        /*
+            Number of problems in the pool waiting to be acquired.
+        */
+        std::size_t available() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::size_t count = 0;
+            for(const auto& shelf : shelves) {
+                count += shelf.second.free.size();
+            }
+            return count;
+        }
+
+        /*
+            Frees the problems waiting in the pool. Problems acquired
+            before still return to the pool when released.
+        */
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            for(auto& shelf : shelves) {
+                shelf.second.created -= shelf.second.free.size();
+                shelf.second.free.clear();
+            }
+        }
+
+    private:
+        // problems of one shape, free ones are waiting to be acquired.
+        // created is the number of problems of the shape that exist.
+        struct Shelf {
+            std::vector<std::unique_ptr<ProblemType>> free;
+            std::size_t created = 0;
+        };
+
+        void release(std::pair<Index, Index> shape, ProblemType* problem) {
+            std::lock_guard<std::mutex> lock(mutex);
+            shelves[shape].free.emplace_back(problem);
+        }
+
+        std::map<std::pair<Index, Index>, Shelf> shelves;
+        mutable std::mutex mutex;
+};
+
+}
+
+#endif
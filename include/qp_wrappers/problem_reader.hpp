@@ -0,0 +1,351 @@
+#ifndef QPWRAPPERS_PROBLEM_READER_HPP
+#define QPWRAPPERS_PROBLEM_READER_HPP
+
+#include <charconv>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "problem.hpp"
+
+
+namespace QPWrappers {
+
+namespace problem_reader_detail {
+
+/*
+    Splits a stream into whitespace separated tokens, reading it in large
+    chunks, and converts tokens to numbers with std::from_chars.
+*/
+class TokenStream {
+    public:
+        explicit TokenStream(std::istream& stream, std::size_t chunk_size = 1 << 20):
+                is(stream),
+                buffer(chunk_size) {}
+
+        /*
+            Skips whitespace. Returns false if the stream ends before
+            the next token.
+        */
+        bool skip_whitespace() {
+            while(true) {
+                while(begin < end && is_space(buffer[begin])) {
+                    begin++;
+                }
+                if(begin < end) {
+                    return true;
+                }
+                if(!fill()) {
+                    return false;
+                }
+            }
+        }
+
+        template<typename V>
+        V read() {
+            const char* first;
+            const char* last;
+            next_token(first, last);
+
+            // operator<< never writes a leading plus, but from_chars
+            // rejects it, so it is skipped for hand written files.
+            if(*first == '+' && last - first > 1) {
+                first++;
+            }
+
+            V value;
+            auto result = std::from_chars(first, last, value);
+            if(result.ec != std::errc() || result.ptr != last) {
+                throw std::domain_error(
+                    std::string("malformed number ")
+                    + std::string(first, std::min<std::ptrdiff_t>(last - first, 64))
+                );
+            }
+            return value;
+        }
+
+    private:
+        std::istream& is;
+        std::vector<char> buffer;
+        std::size_t begin = 0, end = 0;
+        bool eof = false;
+
+        static bool is_space(char c) {
+            return c == ' ' || c == '\n' || c == '\t' || c == '\r'
+                   || c == '\v' || c == '\f';
+        }
+
+        /*
+            Moves the unread part of the buffer to its front and reads more
+            after it, growing the buffer if the unread part fills it.
+            Returns false if nothing more can be read.
+        */
+        bool fill() {
+            if(eof) {
+                return false;
+            }
+
+            std::size_t unread = end - begin;
+            std::memmove(buffer.data(), buffer.data() + begin, unread);
+            begin = 0;
+            end = unread;
+            if(end == buffer.size()) {
+                buffer.resize(2 * buffer.size());
+            }
+
+            is.read(buffer.data() + end, buffer.size() - end);
+            std::size_t count = is.gcount();
+            end += count;
+            if(count == 0 || !is) {
+                eof = true;
+            }
+            return count > 0;
+        }
+
+        void next_token(const char*& first, const char*& last) {
+            if(!skip_whitespace()) {
+                throw std::domain_error("stream ended in the middle of a problem");
+            }
+
+            std::size_t token_end = begin;
+            while(true) {
+                while(token_end < end && !is_space(buffer[token_end])) {
+                    token_end++;
+                }
+                if(token_end < end || eof) {
+                    break;
+                }
+                // the token may continue in the part of the stream not yet read
+                std::size_t scanned = token_end - begin;
+                if(!fill()) {
+                    break;
+                }
+                token_end = begin + scanned;
+            }
+
+            first = buffer.data() + begin;
+            last = buffer.data() + token_end;
+            begin = token_end;
+        }
+};
+
+}
+
+/**
+    Reads a sequence of problems written one after the other in the text
+    format of operator<<, e.g. from a log file or a pipe.
+
+    next fills the given Problem in place, reusing its storage when the
+    sizes allow. If prefetching is enabled, the next problem is parsed on
+    a background thread while the caller works on the current one, and
+    next hands it over by swapping it with the given Problem, whose storage
+    is then reused for the problem after.
+*/
+template<typename T>
+class ProblemReader {
+    public:
+        explicit ProblemReader(std::istream& is, bool prefetch = true):
+                tokens(is),
+                pending(0),
+                prefetching(prefetch) {
+            start();
+        }
+
+        explicit ProblemReader(const std::string& path, bool prefetch = true):
+                owned_stream(new std::ifstream(path, std::ios::binary)),
+                tokens(*owned_stream),
+                pending(0),
+                prefetching(prefetch) {
+            if(!*owned_stream) {
+                throw std::runtime_error(std::string("could not open ") + path);
+            }
+            start();
+        }
+
+        ProblemReader(const ProblemReader&) = delete;
+        ProblemReader& operator=(const ProblemReader&) = delete;
+
+        ~ProblemReader() {
+            if(worker.joinable()) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stop = true;
+                }
+                state_changed.notify_all();
+                worker.join();
+            }
+        }
+
+        /*
+            Reads the next problem into problem. Returns false, leaving
+            problem as it is, if there are no more problems. Throws
+            std::domain_error if the stream does not hold a valid problem.
+        */
+        bool next(Problem<T>& problem) {
+            if(!prefetching) {
+                bool has_problem = parse(problem);
+                problems_read += has_problem;
+                return has_problem;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            state_changed.wait(lock, [this]() {
+                return state == State::Ready;
+            });
+
+            if(error) {
+                std::exception_ptr parse_error = error;
+                error = nullptr;
+                pending_available = false;
+                std::rethrow_exception(parse_error);
+            }
+
+            if(!pending_available) {
+                return false;
+            }
+
+            std::swap(problem, pending);
+            problems_read++;
+            state = State::Requested;
+            lock.unlock();
+            state_changed.notify_all();
+            return true;
+        }
+
+        /*
+            Number of problems returned by next so far.
+        */
+        std::size_t count() const {
+            return problems_read;
+        }
+
+    private:
+        enum class State {
+            Requested,
+            Ready
+        };
+
+        std::unique_ptr<std::istream> owned_stream;
+        problem_reader_detail::TokenStream tokens;
+
+        // problem parsed ahead by the worker, guarded by mutex
+        // unless state is Ready.
+        Problem<T> pending;
+        bool pending_available = false;
+        std::exception_ptr error;
+
+        bool prefetching;
+        std::size_t problems_read = 0;
+
+        std::thread worker;
+        std::mutex mutex;
+        std::condition_variable state_changed;
+        State state = State::Requested;
+        bool stop = false;
+
+        void start() {
+            if(prefetching) {
+                worker = std::thread([this]() {
+                    work();
+                });
+            }
+        }
+
+        void work() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while(true) {
+                state_changed.wait(lock, [this]() {
+                    return stop || state == State::Requested;
+                });
+                if(stop) {
+                    return;
+                }
+
+                lock.unlock();
+                bool has_problem = false;
+                std::exception_ptr parse_error;
+                try {
+                    has_problem = parse(pending);
+                } catch(...) {
+                    parse_error = std::current_exception();
+                }
+                lock.lock();
+
+                pending_available = has_problem;
+                error = parse_error;
+                state = State::Ready;
+                state_changed.notify_all();
+            }
+        }
+
+        /*
+            Same as operator>>, but parses with std::from_chars.
+        */
+        bool parse(Problem<T>& problem) {
+            using Index = Eigen::Index;
+
+            if(!tokens.skip_whitespace()) {
+                return false;
+            }
+
+            Index n = tokens.read<Index>(), m = tokens.read<Index>();
+            if(n < 0 || m < 0) {
+                throw std::domain_error("problem has negative size");
+            }
+            problem.resize_for_load(n, m);
+
+            for(Index i = 0; i < n; i++) {
+                for(Index j = 0; j < n; j++) {
+                    problem.Q_mtr(i, j) = tokens.read<T>();
+                }
+            }
+
+            problem.finish_Q_load();
+
+            for(Index i = 0; i < m; i++) {
+                for(Index j = 0; j < n; j++) {
+                    problem.A_mtr(i, j) = tokens.read<T>();
+                }
+            }
+
+            for(Index i = 0; i < m; i++) {
+                problem.lb_mtr(i) = tokens.read<T>();
+            }
+
+            for(Index i = 0; i < m; i++) {
+                problem.ub_mtr(i) = tokens.read<T>();
+            }
+
+            for(Index i = 0; i < n; i++) {
+                problem.lbx_mtr(i) = tokens.read<T>();
+            }
+
+            for(Index i = 0; i < n; i++) {
+                problem.ubx_mtr(i) = tokens.read<T>();
+            }
+
+            for(Index i = 0; i < n; i++) {
+                problem.c_mtr(i) = tokens.read<T>();
+            }
+
+            for(Index i = 0; i < m; i++) {
+                problem.soft_weights(i) = tokens.read<T>();
+            }
+
+            for(Index i = 0; i < m; i++) {
+                problem.soft_convertible[i] = tokens.read<int>() != 0;
+            }
+
+            return true;
+        }
+};
+
+}
+
+#endif
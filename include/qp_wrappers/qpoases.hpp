@@ -2,8 +2,11 @@
 #define QPWRAPPERS_qpOASES_HPP
 
 #include "problem.hpp"
+#include "sparse_problem.hpp"
 #include "types.hpp"
 #include <iostream>
+#include <memory>
+#include <vector>
 #include <qpOASES/QProblem.hpp>
 
 namespace QPWrappers {
@@ -12,14 +15,15 @@ namespace QPWrappers {
         /*
             A QP engine that solves consecutive QP instances where the result of the previous
             instance used as an initial guess to the next one unless an initial guess
-            is provided.
+            is provided. If only c and the limits changed since the previous instance,
+            it is solved by a qpOASES hotstart on the kept working set.
         */
         template<typename T>
         class Engine {
             static_assert(std::is_same<T, ::qpOASES::real_t>::value);
 
             public:
-                Engine(): psd_tolerance(0), nWSR(10000), initialized(false) {
+                Engine(): initialized(false), out_of_time(false), hotstartable(false), psd_tolerance(0), nWSR(10000) {
                     options.setToDefault();
                     options.printLevel = ::qpOASES::PL_NONE;
                 }
@@ -44,88 +48,282 @@ namespace QPWrappers {
                     nWSR = nwsr;
                 }
 
+                /*
+                    Time budget of each init or next call in seconds, 0 for no
+                    budget. It is given to qpOASES as its cputime limit. A solve
+                    that runs out of it returns OptReturnType::TimeLimit and
+                    loads the current homotopy iterate to result, and the next
+                    call hotstarts from there if only c and the limits changed.
+                */
+                void setTimeBudget(double seconds) {
+                    budget.set(seconds);
+                }
+
                 /*
                     Solve the first intance of the set of problems.
                     Load solution result to result.
                 */
-                OptReturnType init(const Problem<T>& problem, typename Problem<T>::Vector& result) {
-                    ::qpOASES::QProblem qpoases_problem = create_qpoases_problem(problem);
-
-                    auto return_value = qpoases_problem.init(
-                        problem.Q().data(),
-                        problem.c().data(),
-                        problem.A().data(),
-                        problem.lbx().data(),
-                        problem.ubx().data(),
-                        problem.lb().data(),
-                        problem.ub().data(),
-                        nWSR,
-                        NULL
-                    );
+                template<int NumVars, int MaxConstraints>
+                OptReturnType init(const Problem<T, NumVars, MaxConstraints>& problem, typename Problem<T>::Vector& result) {
+                    return solve(problem, result, NULL);
+                }
 
-                    OptReturnType ret_val = load_and_return_optimization_result(return_value, qpoases_problem, problem, result);
+                /*
+                    Sparse version of init. Q and A are handed to qpOASES as
+                    sparse matrices without a dense copy.
+                */
+                OptReturnType init(const SparseProblem<T>& problem, typename Problem<T>::Vector& result) {
+                    return solve(problem, result, NULL);
+                }
 
-                    if(ret_val == OptReturnType::Optimal) {
-                        initialized = true;
-                        previous_result = result;
-                    } else {
+                /*
+                    Solve the next problem of the set of problems. Initializes the engine if not initialized before.
+                    If initialized, uses the previous result as the starting point.
+                */
+                template<int NumVars, int MaxConstraints>
+                OptReturnType next(const Problem<T, NumVars, MaxConstraints>& problem, typename Problem<T>::Vector& result) {
+                    if(!initialized || problem.num_vars() != previous_result.rows()) {
                         initialized = false;
+                        return init(problem, result);
                     }
 
-                    return ret_val;
+                    if(can_hotstart(problem)) {
+                        return hotstart(problem, result);
+                    }
+
+                    return solve(problem, result, previous_result.data());
                 }
 
                 /*
-                    Solve the next problem of the set of problems. Initializes the engine if not initialized before.
-                    If initialized, uses the previous result as the starting point.
+                    Sparse version of next.
                 */
-                OptReturnType next(const Problem<T>& problem, typename Problem<T>::Vector& result) {
+                OptReturnType next(const SparseProblem<T>& problem, typename Problem<T>::Vector& result) {
                     if(!initialized || problem.num_vars() != previous_result.rows()) {
                         initialized = false;
                         return init(problem, result);
                     }
 
-                    ::qpOASES::QProblem qpoases_problem = create_qpoases_problem(problem);
+                    if(can_hotstart(problem)) {
+                        return hotstart(problem, result);
+                    }
 
-                    auto return_value = qpoases_problem.init(
-                        problem.Q().data(),
+                    return solve(problem, result, previous_result.data());
+                }
+
+                /*
+                    Solve the next problem of the set of problems with the given initial guess.
+                */
+                template<int NumVars, int MaxConstraints>
+                OptReturnType next(const Problem<T, NumVars, MaxConstraints>& problem, typename Problem<T>::Vector& result, const typename Problem<T>::Vector& initial_guess) {
+                    previous_result = initial_guess;
+                    initialized = true;
+                    hotstartable = false;
+
+                    return next(problem, result);
+                }
+
+                /*
+                    Sparse version of next with the given initial guess.
+                */
+                OptReturnType next(const SparseProblem<T>& problem, typename Problem<T>::Vector& result, const typename Problem<T>::Vector& initial_guess) {
+                    previous_result = initial_guess;
+                    initialized = true;
+                    hotstartable = false;
+
+                    return next(problem, result);
+                }
+
+                void setFeasibilityTolerance(T val) {}
+
+                /*
+                    Statistics of the last init or next call.
+                */
+                const SolveStatistics& statistics() const {
+                    return last_statistics;
+                }
+
+            private:
+                /*
+                    Solves the problem starting from x_opt if it is not NULL, and loads
+                    the result. Engine is initialized if the problem is solved optimally
+                    or stopped by the time budget from scratch, and the previous result
+                    is updated on every such solve.
+                    start is the start of the init or next call, which the time
+                    budget is counted from.
+                */
+                template<typename ProblemType>
+                OptReturnType solve(const ProblemType& problem, typename Problem<T>::Vector& result, const T* x_opt,
+                                    SolveClock::time_point start = SolveClock::now()) {
+                    last_statistics = SolveStatistics();
+                    call_start = start;
+
+                    qpoases_problem = create_qpoases_problem(problem);
+
+                    auto return_value = init_qpoases_problem(problem, x_opt);
+                    last_statistics.setup_time = seconds_since(start) - last_statistics.solve_time;
+
+                    OptReturnType ret_val = load_and_return_optimization_result(return_value, problem, result);
+                    budget.record(last_statistics, call_start);
+
+                    hotstartable = ret_val == OptReturnType::Optimal || ret_val == OptReturnType::TimeLimit;
+                    if(hotstartable) {
+                        initialized = true;
+                        previous_result = result;
+                        solved_version = problem.version();
+                    } else if(x_opt == NULL) {
+                        initialized = false;
+                    }
+
+                    return ret_val;
+                }
+
+                /*
+                    True if the problem differs only in c and the limits from the
+                    last one that was solved optimally or stopped by the time
+                    budget. The qpOASES instance holding the matrices and the
+                    working set of that problem can then be reused.
+                */
+                template<typename ProblemType>
+                bool can_hotstart(const ProblemType& problem) const {
+                    return hotstartable
+                        && problem.num_constraints() == qpoases_problem.getNC()
+                        && ProblemChanges(solved_version, problem.version()).only_vectors();
+                }
+
+                /*
+                    Solves the problem with a qpOASES hotstart from the last solution.
+                    Falls back to solving from the previous result if the hotstart
+                    fails, since qpOASES leaves the instance in an unusable state then.
+                */
+                template<typename ProblemType>
+                OptReturnType hotstart(const ProblemType& problem, typename Problem<T>::Vector& result) {
+                    last_statistics = SolveStatistics();
+                    call_start = SolveClock::now();
+
+                    ::qpOASES::int_t nwsr = nWSR;
+                    ::qpOASES::real_t cputime;
+                    SolveClock::time_point solve_start = SolveClock::now();
+                    auto return_value = qpoases_problem.hotstart(
                         problem.c().data(),
-                        problem.A().data(),
                         problem.lbx().data(),
                         problem.ubx().data(),
                         problem.lb().data(),
                         problem.ub().data(),
-                        nWSR,
-                        NULL,
-                        previous_result.data()
+                        nwsr,
+                        time_limit(cputime)
                     );
+                    record_solve(solve_start, nwsr);
 
-                    OptReturnType ret_val = load_and_return_optimization_result(return_value, qpoases_problem, problem, result);
+                    OptReturnType ret_val = load_and_return_optimization_result(return_value, problem, result);
+                    budget.record(last_statistics, call_start);
 
-                    if(ret_val == OptReturnType::Optimal) {
-                        previous_result = result;
+                    // solving again would only run further past the budget
+                    if(ret_val != OptReturnType::Optimal && ret_val != OptReturnType::TimeLimit) {
+                        hotstartable = false;
+                        return solve(problem, result, previous_result.data(), call_start);
                     }
 
+                    previous_result = result;
+                    solved_version = problem.version();
                     return ret_val;
                 }
 
                 /*
-                    Solve the next problem of the set of problems with the given initial guess.
+                    qpOASES keeps pointers to the Hessian and constraint matrix data
+                    instead of copying them, so they are copied to members that live
+                    as long as qpoases_problem does.
                 */
-                OptReturnType next(const Problem<T>& problem, typename Problem<T>::Vector& result, const typename Problem<T>::Vector& initial_guess) {
-                    previous_result = initial_guess;
-                    initialized = true;
+                template<int NumVars, int MaxConstraints>
+                ::qpOASES::returnValue init_qpoases_problem(const Problem<T, NumVars, MaxConstraints>& problem, const T* x_opt) {
+                    H_dense = problem.Q();
+                    A_dense = problem.A();
+
+                    ::qpOASES::int_t nwsr = nWSR;
+                    ::qpOASES::real_t cputime;
+                    SolveClock::time_point solve_start = SolveClock::now();
+                    auto return_value = qpoases_problem.init(
+                        H_dense.data(),
+                        problem.c().data(),
+                        A_dense.data(),
+                        problem.lbx().data(),
+                        problem.ubx().data(),
+                        problem.lb().data(),
+                        problem.ub().data(),
+                        nwsr,
+                        time_limit(cputime),
+                        x_opt
+                    );
+                    record_solve(solve_start, nwsr);
+                    return return_value;
+                }
 
-                    return next(problem, result);
+                /*
+                    qpOASES expects both triangles of the Hessian, so the full
+                    symmetric Q is expanded from the stored upper triangle in O(nnz).
+                */
+                ::qpOASES::returnValue init_qpoases_problem(const SparseProblem<T>& problem, const T* x_opt) {
+                    Q_full = problem.Q().template selfadjointView<Eigen::Upper>();
+                    Q_full.makeCompressed();
+                    A_values = problem.A();
+                    A_values.makeCompressed();
+
+                    Q_rows.assign(Q_full.innerIndexPtr(), Q_full.innerIndexPtr() + Q_full.nonZeros());
+                    Q_cols.assign(Q_full.outerIndexPtr(), Q_full.outerIndexPtr() + Q_full.outerSize() + 1);
+                    A_rows.assign(A_values.innerIndexPtr(), A_values.innerIndexPtr() + A_values.nonZeros());
+                    A_cols.assign(A_values.outerIndexPtr(), A_values.outerIndexPtr() + A_values.outerSize() + 1);
+
+                    H_sparse.reset(new ::qpOASES::SymSparseMat(problem.num_vars(), problem.num_vars(), Q_rows.data(), Q_cols.data(), Q_full.valuePtr()));
+                    H_sparse->createDiagInfo();
+                    A_sparse.reset(new ::qpOASES::SparseMatrix(problem.num_constraints(), problem.num_vars(), A_rows.data(), A_cols.data(), A_values.valuePtr()));
+
+                    ::qpOASES::int_t nwsr = nWSR;
+                    ::qpOASES::real_t cputime;
+                    SolveClock::time_point solve_start = SolveClock::now();
+                    auto return_value = qpoases_problem.init(
+                        H_sparse.get(),
+                        problem.c().data(),
+                        A_sparse.get(),
+                        problem.lbx().data(),
+                        problem.ubx().data(),
+                        problem.lb().data(),
+                        problem.ub().data(),
+                        nwsr,
+                        time_limit(cputime),
+                        x_opt
+                    );
+                    record_solve(solve_start, nwsr);
+                    return return_value;
                 }
 
-                void setFeasibilityTolerance(T val) {}
+                /*
+                    Sets cputime to the budget left in the call and returns a
+                    pointer to it for qpOASES, or NULL without a budget.
+                */
+                ::qpOASES::real_t* time_limit(::qpOASES::real_t& cputime) const {
+                    if(!budget.active()) {
+                        return NULL;
+                    }
+                    cputime = budget.remaining(seconds_since(call_start));
+                    return &cputime;
+                }
+
+                /*
+                    qpOASES overwrites nwsr with the number of working set
+                    recalculations it performed. It stops with
+                    RET_MAX_NWSR_REACHED when it runs out of time as well, which
+                    is told apart by performing fewer than nWSR of them.
+                */
+                void record_solve(SolveClock::time_point solve_start, ::qpOASES::int_t nwsr) {
+                    last_statistics.solve_time = seconds_since(solve_start);
+                    last_statistics.iterations = nwsr;
+                    out_of_time = budget.active() && nwsr < nWSR;
+                }
 
-            private:
                 /*
                     Creates the qpOASES problem instance according to options stored, and the type of the problem
                 */
-                ::qpOASES::QProblem create_qpoases_problem(const Problem<T>& problem) {
+                template<typename ProblemType>
+                ::qpOASES::QProblem create_qpoases_problem(const ProblemType& problem) {
                     ::qpOASES::QProblem qpoases_problem;
 
                     if(problem.is_Q_pd()) {
@@ -147,9 +345,9 @@ namespace QPWrappers {
                     Loads solution from qpoases problem instance to the result if it is solved in the given
                     qpoases_problem.
                 */
-                OptReturnType load_and_return_optimization_result(::qpOASES::returnValue return_value, 
-                                                               const ::qpOASES::QProblem& qpoases_problem, 
-                                                               const Problem<T>& problem,
+                template<typename ProblemType>
+                OptReturnType load_and_return_optimization_result(::qpOASES::returnValue return_value,
+                                                               const ProblemType& problem,
                                                                typename Problem<T>::Vector& result) 
                 {
                     if(return_value == ::qpOASES::SUCCESSFUL_RETURN) {
@@ -157,6 +355,15 @@ namespace QPWrappers {
                         qpoases_problem.getPrimalSolution(result.data());
                         return OptReturnType::Optimal;
                     } else if (return_value == ::qpOASES::RET_MAX_NWSR_REACHED) {
+                        // the homotopy iterate is the solution of a problem
+                        // on the way from the previous one to this one.
+                        if(out_of_time) {
+                            result.resize(problem.num_vars());
+                            if(qpoases_problem.getPrimalSolution(result.data()) == ::qpOASES::SUCCESSFUL_RETURN) {
+                                return OptReturnType::TimeLimit;
+                            }
+                            return OptReturnType::Unknown;
+                        }
                         return OptReturnType::Error;
                     } else if(return_value == ::qpOASES::RET_INIT_FAILED) {
                         return OptReturnType::Infeasible;
@@ -167,6 +374,26 @@ namespace QPWrappers {
 
                 bool initialized;
                 typename Problem<T>::Vector previous_result;
+                SolveStatistics last_statistics;
+
+                // budget of each call, the start of the current call, and
+                // whether the last qpOASES call ran out of time.
+                TimeBudget budget;
+                SolveClock::time_point call_start;
+                bool out_of_time;
+
+                // instance of the last problem solved optimally or stopped by
+                // the time budget, valid for a hotstart while hotstartable is set.
+                ::qpOASES::QProblem qpoases_problem;
+                ProblemVersion solved_version;
+                bool hotstartable;
+
+                // matrix data qpoases_problem points to
+                Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> H_dense, A_dense;
+                typename SparseProblem<T>::SparseMatrix Q_full, A_values;
+                std::vector<::qpOASES::sparse_int_t> Q_rows, Q_cols, A_rows, A_cols;
+                std::unique_ptr<::qpOASES::SymSparseMat> H_sparse;
+                std::unique_ptr<::qpOASES::SparseMatrix> A_sparse;
 
                 T psd_tolerance;
                 ::qpOASES::int_t nWSR;
@@ -0,0 +1,549 @@
+#ifndef QPWRAPPERS_QPS_READER_HPP
+#define QPWRAPPERS_QPS_READER_HPP
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <charconv>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "problem.hpp"
+#include "sparse_problem.hpp"
+
+
+namespace QPWrappers {
+
+/*
+    Parts of a QPS or MPS file that do not fit in a Problem.
+    The objective of the file is
+        1/2 x^T Q x + c^T x + objective_constant
+    of the problem. A maximization problem is read as the minimization
+    of the negated objective, in which case maximize is set.
+*/
+template<typename T>
+struct QPSInfo {
+    std::string name;
+    T objective_constant = 0;
+    bool maximize = false;
+    std::vector<std::string> variable_names;
+    std::vector<std::string> constraint_names;
+};
+
+namespace qps_reader_detail {
+
+/*
+    Contents of a QPS file, with Q and A as triplets. Each Q triplet is
+    added as in SparseProblem::add_Q_entry, i.e. an off-diagonal value is
+    split evenly between Q(i, j) and Q(j, i).
+*/
+template<typename T>
+struct QPSData {
+    QPSInfo<T> info;
+    std::vector<Eigen::Triplet<T>> Q_entries, A_entries;
+    std::vector<T> c, lbx, ubx, lb, ub;
+};
+
+/*
+    Values at least this large in magnitude mean infinity in MPS files.
+*/
+template<typename T>
+T to_limit(T value) {
+    if(value >= T(1e20)) {
+        return std::numeric_limits<T>::max();
+    } else if(value <= T(-1e20)) {
+        return std::numeric_limits<T>::lowest();
+    }
+    return value;
+}
+
+template<typename T>
+class QPSParser {
+    public:
+        explicit QPSParser(std::istream& stream): is(stream) {}
+
+        QPSData<T> parse() {
+            std::string line;
+            while(std::getline(is, line)) {
+                line_number++;
+                if(!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                tokenize(line);
+                if(tokens.empty() || tokens[0][0] == '*') {
+                    continue;
+                }
+
+                if(!std::isspace(static_cast<unsigned char>(line[0]))) {
+                    if(start_section()) {
+                        break;
+                    }
+                    continue;
+                }
+
+                parse_data_line();
+            }
+
+            finish();
+            return std::move(data);
+        }
+
+    private:
+        enum class Section {
+            None,
+            ObjSense,
+            Rows,
+            Columns,
+            Rhs,
+            Ranges,
+            Bounds,
+            QuadObj,
+            QMatrix
+        };
+
+        enum class RowType {
+            Objective,
+            Free,
+            Equal,
+            Less,
+            Greater
+        };
+
+        struct Row {
+            RowType type;
+            // index of the constraint, or -1 for objective and free rows
+            Eigen::Index constraint;
+            T rhs = 0;
+            T range = 0;
+            bool has_range = false;
+        };
+
+        std::istream& is;
+        std::size_t line_number = 0;
+        std::vector<std::string> tokens;
+        Section section = Section::None;
+        QPSData<T> data;
+
+        std::vector<Row> rows;
+        std::unordered_map<std::string, std::size_t> row_index;
+        std::unordered_map<std::string, Eigen::Index> column_index;
+        // variables have the bounds [0, infinity) unless BOUNDS says otherwise
+        std::vector<bool> lower_bound_set;
+        bool has_objective = false;
+
+        void tokenize(const std::string& line) {
+            tokens.clear();
+            std::istringstream line_stream(line);
+            std::string token;
+            while(line_stream >> token) {
+                tokens.push_back(token);
+            }
+        }
+
+        [[noreturn]] void fail(const std::string& message) const {
+            throw std::domain_error(
+                std::string("QPS line ")
+                + std::to_string(line_number)
+                + std::string(": ")
+                + message
+            );
+        }
+
+        T number(const std::string& token) const {
+            const char* first = token.data();
+            const char* last = token.data() + token.size();
+            if(first != last && *first == '+') {
+                first++;
+            }
+
+            T value;
+            auto result = std::from_chars(first, last, value);
+            if(result.ec != std::errc() || result.ptr != last) {
+                fail(std::string("malformed number ") + token);
+            }
+            return value;
+        }
+
+        /*
+            Returns true at ENDATA.
+        */
+        bool start_section() {
+            const std::string& keyword = tokens[0];
+            if(keyword == "NAME") {
+                data.info.name = tokens.size() > 1 ? tokens[1] : std::string();
+                section = Section::None;
+            } else if(keyword == "OBJSENSE") {
+                section = Section::ObjSense;
+                if(tokens.size() > 1) {
+                    set_sense(tokens[1]);
+                }
+            } else if(keyword == "ROWS") {
+                section = Section::Rows;
+            } else if(keyword == "COLUMNS") {
+                section = Section::Columns;
+            } else if(keyword == "RHS") {
+                section = Section::Rhs;
+            } else if(keyword == "RANGES") {
+                section = Section::Ranges;
+            } else if(keyword == "BOUNDS") {
+                section = Section::Bounds;
+            } else if(keyword == "QUADOBJ") {
+                section = Section::QuadObj;
+            } else if(keyword == "QMATRIX" || keyword == "QSECTION") {
+                section = Section::QMatrix;
+            } else if(keyword == "ENDATA") {
+                return true;
+            } else {
+                fail(std::string("unsupported section ") + keyword);
+            }
+            return false;
+        }
+
+        void set_sense(const std::string& sense) {
+            if(sense == "MAX" || sense == "MAXIMIZE") {
+                data.info.maximize = true;
+            } else if(sense == "MIN" || sense == "MINIMIZE") {
+                data.info.maximize = false;
+            } else {
+                fail(std::string("unknown objective sense ") + sense);
+            }
+        }
+
+        void parse_data_line() {
+            switch(section) {
+                case Section::ObjSense:
+                    set_sense(tokens[0]);
+                    break;
+                case Section::Rows:
+                    add_row();
+                    break;
+                case Section::Columns:
+                    add_column_entries();
+                    break;
+                case Section::Rhs:
+                case Section::Ranges:
+                    add_row_values();
+                    break;
+                case Section::Bounds:
+                    add_bound();
+                    break;
+                case Section::QuadObj:
+                case Section::QMatrix:
+                    add_Q_entry();
+                    break;
+                default:
+                    fail("data line outside of a section");
+            }
+        }
+
+        void add_row() {
+            if(tokens.size() < 2) {
+                fail("row needs a type and a name");
+            }
+
+            Row row;
+            row.constraint = -1;
+            const std::string& type = tokens[0];
+            if(type == "N") {
+                row.type = has_objective ? RowType::Free : RowType::Objective;
+                has_objective = true;
+            } else if(type == "E" || type == "L" || type == "G") {
+                row.type = type == "E" ? RowType::Equal
+                           : type == "L" ? RowType::Less : RowType::Greater;
+                row.constraint = data.info.constraint_names.size();
+                data.info.constraint_names.push_back(tokens[1]);
+            } else {
+                fail(std::string("unknown row type ") + type);
+            }
+
+            row_index[tokens[1]] = rows.size();
+            rows.push_back(row);
+        }
+
+        Row& find_row(const std::string& name) {
+            auto it = row_index.find(name);
+            if(it == row_index.end()) {
+                fail(std::string("unknown row ") + name);
+            }
+            return rows[it->second];
+        }
+
+        Eigen::Index find_column(const std::string& name) {
+            auto it = column_index.find(name);
+            if(it == column_index.end()) {
+                fail(std::string("unknown column ") + name);
+            }
+            return it->second;
+        }
+
+        void add_column_entries() {
+            // integrality markers are skipped, integer variables are
+            // read as continuous ones.
+            if(tokens.size() >= 2 && tokens[1] == "'MARKER'") {
+                return;
+            }
+            if(tokens.size() != 3 && tokens.size() != 5) {
+                fail("column line needs a name and one or two row value pairs");
+            }
+
+            Eigen::Index column;
+            auto it = column_index.find(tokens[0]);
+            if(it == column_index.end()) {
+                column = data.info.variable_names.size();
+                column_index[tokens[0]] = column;
+                data.info.variable_names.push_back(tokens[0]);
+                data.c.push_back(0);
+                data.lbx.push_back(0);
+                data.ubx.push_back(std::numeric_limits<T>::max());
+                lower_bound_set.push_back(false);
+            } else {
+                column = it->second;
+            }
+
+            for(std::size_t k = 1; k + 1 < tokens.size(); k += 2) {
+                const Row& row = find_row(tokens[k]);
+                T value = number(tokens[k + 1]);
+                if(row.type == RowType::Objective) {
+                    data.c[column] += value;
+                } else if(row.type != RowType::Free) {
+                    data.A_entries.emplace_back(row.constraint, column, value);
+                }
+            }
+        }
+
+        /*
+            RHS and RANGES lines, with an optional set name first.
+        */
+        void add_row_values() {
+            std::size_t first = tokens.size() % 2 == 1 ? 1 : 0;
+            if(tokens.size() - first != 2 && tokens.size() - first != 4) {
+                fail("line needs one or two row value pairs");
+            }
+
+            for(std::size_t k = first; k + 1 < tokens.size(); k += 2) {
+                Row& row = find_row(tokens[k]);
+                T value = number(tokens[k + 1]);
+                if(section == Section::Ranges) {
+                    row.range = value;
+                    row.has_range = true;
+                } else if(row.type == RowType::Objective) {
+                    // the objective row holds -constant on the right hand side
+                    data.info.objective_constant = -value;
+                } else {
+                    row.rhs = value;
+                }
+            }
+        }
+
+        void add_bound() {
+            const std::string& type = tokens[0];
+            bool needs_value = type == "LO" || type == "UP" || type == "FX"
+                               || type == "LI" || type == "UI";
+            bool takes_no_value = type == "FR" || type == "MI" || type == "PL"
+                                  || type == "BV";
+            if(!needs_value && !takes_no_value) {
+                fail(std::string("unsupported bound type ") + type);
+            }
+
+            // the set name is optional in free MPS
+            std::size_t with_set = needs_value ? 4 : 3;
+            std::size_t column_token;
+            if(tokens.size() >= with_set) {
+                column_token = 2;
+            } else if(tokens.size() == with_set - 1) {
+                column_token = 1;
+            } else {
+                fail("bound line has too few fields");
+            }
+
+            Eigen::Index column = find_column(tokens[column_token]);
+            T value = needs_value ? number(tokens[column_token + 1]) : T(0);
+            T& lower = data.lbx[column];
+            T& upper = data.ubx[column];
+
+            if(type == "LO" || type == "LI") {
+                lower = to_limit(value);
+                lower_bound_set[column] = true;
+            } else if(type == "UP" || type == "UI") {
+                upper = to_limit(value);
+                // a negative upper bound with the default lower bound of 0
+                // makes the lower bound minus infinity, as in most readers.
+                if(value < 0 && !lower_bound_set[column] && lower == T(0)) {
+                    lower = std::numeric_limits<T>::lowest();
+                }
+            } else if(type == "FX") {
+                lower = upper = value;
+                lower_bound_set[column] = true;
+            } else if(type == "FR") {
+                lower = std::numeric_limits<T>::lowest();
+                upper = std::numeric_limits<T>::max();
+                lower_bound_set[column] = true;
+            } else if(type == "MI") {
+                lower = std::numeric_limits<T>::lowest();
+                lower_bound_set[column] = true;
+            } else if(type == "PL") {
+                upper = std::numeric_limits<T>::max();
+            } else {
+                lower = 0;
+                upper = 1;
+                lower_bound_set[column] = true;
+            }
+        }
+
+        /*
+            QUADOBJ lists each off-diagonal entry of one triangle, QMATRIX
+            lists both Q(i, j) and Q(j, i).
+        */
+        void add_Q_entry() {
+            if(tokens.size() != 3) {
+                fail("quadratic objective line needs two columns and a value");
+            }
+
+            Eigen::Index i = find_column(tokens[0]), j = find_column(tokens[1]);
+            T value = number(tokens[2]);
+            if(i != j && section == Section::QuadObj) {
+                value *= 2;
+            }
+            data.Q_entries.emplace_back(i, j, value);
+        }
+
+        /*
+            Turns right hand sides and ranges into constraint limits, and
+            negates the objective of a maximization problem.
+        */
+        void finish() {
+            std::size_t m = data.info.constraint_names.size();
+            data.lb.resize(m);
+            data.ub.resize(m);
+
+            for(const Row& row: rows) {
+                if(row.constraint < 0) {
+                    continue;
+                }
+
+                T rhs = to_limit(row.rhs);
+                T range = std::abs(row.range);
+                T& lower = data.lb[row.constraint];
+                T& upper = data.ub[row.constraint];
+                if(row.type == RowType::Equal) {
+                    lower = upper = rhs;
+                    if(row.has_range && row.range > 0) {
+                        upper = to_limit(rhs + range);
+                    } else if(row.has_range) {
+                        lower = to_limit(rhs - range);
+                    }
+                } else if(row.type == RowType::Less) {
+                    upper = rhs;
+                    lower = row.has_range ? to_limit(rhs - range)
+                                          : std::numeric_limits<T>::lowest();
+                } else {
+                    lower = rhs;
+                    upper = row.has_range ? to_limit(rhs + range)
+                                          : std::numeric_limits<T>::max();
+                }
+            }
+
+            if(data.info.maximize) {
+                for(T& value: data.c) {
+                    value = -value;
+                }
+                for(Eigen::Triplet<T>& entry: data.Q_entries) {
+                    entry = Eigen::Triplet<T>(entry.row(), entry.col(), -entry.value());
+                }
+                data.info.objective_constant = -data.info.objective_constant;
+            }
+        }
+};
+
+}
+
+/*
+    Reads a QP in QPS format, i.e. free or fixed MPS with a QUADOBJ,
+    QMATRIX or QSECTION section for Q, into problem, and returns what
+    does not fit in it. Integrality markers are ignored.
+    Throws std::domain_error if the stream is not a valid QPS file.
+*/
+template<typename T>
+QPSInfo<T> read_qps(std::istream& is, SparseProblem<T>& problem) {
+    using Index = Eigen::Index;
+    using Vector = typename SparseProblem<T>::Vector;
+
+    qps_reader_detail::QPSData<T> data = qps_reader_detail::QPSParser<T>(is).parse();
+    Index n = data.c.size(), m = data.lb.size();
+
+    problem = SparseProblem<T>(n);
+    problem.add_Q_triplets(data.Q_entries.begin(), data.Q_entries.end());
+    problem.add_c(Eigen::Map<const Vector>(data.c.data(), n));
+    for(Index i = 0; i < n; i++) {
+        problem.set_var_limits(i, data.lbx[i], data.ubx[i]);
+    }
+
+    typename SparseProblem<T>::SparseMatrix A(m, n);
+    A.setFromTriplets(data.A_entries.begin(), data.A_entries.end());
+    problem.add_constraints(
+        A,
+        Eigen::Map<const Vector>(data.lb.data(), m),
+        Eigen::Map<const Vector>(data.ub.data(), m)
+    );
+
+    return std::move(data.info);
+}
+
+/*
+    Dense version of read_qps.
+*/
+template<typename T>
+QPSInfo<T> read_qps(std::istream& is, Problem<T>& problem) {
+    using Index = Eigen::Index;
+    using Matrix = typename Problem<T>::Matrix;
+    using Vector = typename Problem<T>::Vector;
+
+    qps_reader_detail::QPSData<T> data = qps_reader_detail::QPSParser<T>(is).parse();
+    Index n = data.c.size(), m = data.lb.size();
+
+    problem = Problem<T>(n);
+
+    // add_Q symmetrizes, so an off-diagonal triplet goes to Q(i, j) only
+    // to be split between Q(i, j) and Q(j, i) as in add_Q_entry.
+    Matrix Q = Matrix::Zero(n, n);
+    for(const Eigen::Triplet<T>& entry: data.Q_entries) {
+        Q(entry.row(), entry.col()) += entry.value();
+    }
+    problem.add_Q(Q);
+    problem.add_c(Eigen::Map<const Vector>(data.c.data(), n));
+    for(Index i = 0; i < n; i++) {
+        problem.set_var_limits(i, data.lbx[i], data.ubx[i]);
+    }
+
+    Matrix A = Matrix::Zero(m, n);
+    for(const Eigen::Triplet<T>& entry: data.A_entries) {
+        A(entry.row(), entry.col()) += entry.value();
+    }
+    problem.add_constraints(
+        A,
+        Eigen::Map<const Vector>(data.lb.data(), m),
+        Eigen::Map<const Vector>(data.ub.data(), m)
+    );
+
+    return std::move(data.info);
+}
+
+/*
+    Reads the QPS file at path.
+*/
+template<typename ProblemType>
+QPSInfo<typename ProblemType::Scalar> read_qps(const std::string& path, ProblemType& problem) {
+    std::ifstream file(path);
+    if(!file) {
+        throw std::runtime_error(std::string("could not open ") + path);
+    }
+    return read_qps(file, problem);
+}
+
+}
+
+#endif
@@ -0,0 +1,413 @@
+#ifndef QPWRAPPERS_SCALING_HPP
+#define QPWRAPPERS_SCALING_HPP
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "problem.hpp"
+#include "sparse_problem.hpp"
+#include "types.hpp"
+
+
+namespace QPWrappers {
+
+/**
+    Diagonally scaled version of a Problem or SparseProblem.
+
+    With variable scaling D, constraint scaling E and cost scaling gamma,
+    the scaled problem has
+        Q' = gamma D Q D, c' = gamma D c, A' = E A D,
+        lb' = E lb, ub' = E ub, lbx' = D^-1 lbx, ubx' = D^-1 ubx,
+    so that x = D x' maps its solutions back. D and E are found by Ruiz
+    equilibration, which repeatedly divides each column of [Q; A] and each
+    row of A by the square root of its largest absolute entry, and gamma
+    makes the mean column of Q' and c' of unit size. Soft convertible
+    constraints are not row scaled and their weights are scaled by gamma,
+    so that converting the scaled problem to soft gives the same penalties.
+
+    D, E and gamma are kept and reused by later calls to scale as long as
+    the problem has the same sizes and nonzero count, and the columns and
+    rows scaled with D and E and the cost size gamma is chosen from are
+    within a factor reuse_ratio of the sizes they had when the factors were
+    computed. Otherwise they are computed again. Parts of the scaled problem
+    are marked changed only if the factors or the parts of problem they
+    come from changed, so an update of c alone changes only the scaled c.
+*/
+template<typename ProblemType>
+class Scaling {
+    public:
+        using T = typename ProblemType::Scalar;
+        using Index = Eigen::Index;
+        using Vector = typename Problem<T>::Vector;
+
+        explicit Scaling(int iterations = 10, T reuse_ratio = T(4)):
+                iterations(iterations),
+                reuse_ratio(reuse_ratio),
+                scaled(problem_detail::EmptyProblem<ProblemType>::make()) {}
+
+        /*
+            Scales problem and returns the scaled problem, which stays valid
+            until the next call.
+        */
+        const ProblemType& scale(const ProblemType& problem) {
+            // brings the cached parts of the problem up to date, so that
+            // they are copied along with the rest.
+            problem.Q();
+            problem.A();
+
+            bool same_structure = has_factors
+                                  && problem.num_vars() == D.rows()
+                                  && problem.num_constraints() == E.rows()
+                                  && nonzeros(problem) == factor_nonzeros;
+            scaled = problem;
+            scaled.Q_class_cache = {};
+
+            factors_reused = false;
+            if(same_structure) {
+                apply(D, E);
+                scaled.c_mtr.array() *= D.array();
+                compute_norms();
+                factors_reused = norms_match() && close(cost_norm(), reference_cost_norm);
+                if(!factors_reused) {
+                    scaled = problem;
+                    scaled.Q_class_cache = {};
+                }
+            }
+            if(!factors_reused) {
+                equilibrate();
+                scaled.c_mtr.array() *= D.array();
+                reference_cost_norm = cost_norm();
+                gamma = step(reference_cost_norm);
+                gamma *= gamma;
+                factor_nonzeros = nonzeros(problem);
+                has_factors = true;
+            }
+
+            scale_cost();
+            scale_limits();
+
+            // parts of the scaled problem change with the parts of problem
+            // they come from, and with the factors they are scaled by.
+            ProblemChanges changed = ProblemChanges::none();
+            changed.Q = changed.c = changed.A = !factors_reused;
+            changed.limits = changed.var_limits = !factors_reused;
+            scaled.versions = scaled_versions.derive(problem.version(), changed);
+            return scaled;
+        }
+
+        const ProblemType& problem() const {
+            return scaled;
+        }
+
+        /*
+            True if the last call to scale reused the previous D, E and gamma.
+        */
+        bool reused() const {
+            return factors_reused;
+        }
+
+        /*
+            Forgets D, E and gamma, so that the next call to scale computes them.
+        */
+        void clear() {
+            has_factors = false;
+        }
+
+        const Vector& variable_scaling() const {
+            return D;
+        }
+
+        const Vector& constraint_scaling() const {
+            return E;
+        }
+
+        T cost_scaling() const {
+            return gamma;
+        }
+
+        /*
+            Maps a solution of the scaled problem to the original problem.
+        */
+        void unscale(const Vector& scaled_solution, Vector& solution) const {
+            solution = D.cwiseProduct(scaled_solution);
+        }
+
+        /*
+            Maps constraint duals y and variable limit duals z of the scaled
+            problem to the original problem, for
+                Q x + c + A^T y + z = 0.
+        */
+        void unscale_duals(const Vector& scaled_y, const Vector& scaled_z,
+                           Vector& y, Vector& z) const {
+            y = E.cwiseProduct(scaled_y) / gamma;
+            z = scaled_z.cwiseQuotient(D) / gamma;
+        }
+
+        /*
+            Maps a point of the original problem, e.g. an initial guess,
+            to the scaled problem.
+        */
+        void scale_solution(const Vector& solution, Vector& scaled_solution) const {
+            scaled_solution = solution.cwiseQuotient(D);
+        }
+
+        /*
+            init, next and next with an initial guess of engine on the scaled
+            problem, writing the unscaled solution, or the unscaled iterate
+            on TimeLimit, to result.
+        */
+        template<typename Engine>
+        OptReturnType init(Engine& engine, const ProblemType& problem, Vector& result) {
+            OptReturnType status = engine.init(scale(problem), scaled_result);
+            return finish(status, result);
+        }
+
+        template<typename Engine>
+        OptReturnType next(Engine& engine, const ProblemType& problem, Vector& result) {
+            OptReturnType status = engine.next(scale(problem), scaled_result);
+            return finish(status, result);
+        }
+
+        template<typename Engine>
+        OptReturnType next(Engine& engine, const ProblemType& problem, Vector& result,
+                           const Vector& initial_guess) {
+            const ProblemType& scaled_problem = scale(problem);
+            scale_solution(initial_guess, scaled_guess);
+            OptReturnType status = engine.next(scaled_problem, scaled_result, scaled_guess);
+            return finish(status, result);
+        }
+
+    private:
+        // column and row sizes below min_norm are left unscaled, and sizes
+        // above max_norm are scaled as if they were max_norm.
+        static constexpr double min_norm = 1e-4;
+        static constexpr double max_norm = 1e4;
+        static constexpr double convergence_tolerance = 1e-3;
+
+        int iterations;
+        T reuse_ratio;
+
+        ProblemType scaled;
+        DerivedVersion scaled_versions;
+
+        bool has_factors = false, factors_reused = false;
+        Index factor_nonzeros = 0;
+        Vector D, E;
+        T gamma = 1;
+
+        // largest absolute entries of the columns of Q and A and of the
+        // rows of A of the scaled problem, and the column, row and cost
+        // sizes that D, E and gamma were computed for.
+        Vector Q_col_norms, A_col_norms, A_row_norms;
+        Vector reference_col_norms, reference_row_norms;
+        T reference_cost_norm = 0;
+
+        // step of one equilibration iteration, and engine solution buffers
+        Vector delta, epsilon, scaled_result, scaled_guess;
+
+        OptReturnType finish(OptReturnType status, Vector& result) const {
+            if(status == OptReturnType::Optimal || status == OptReturnType::Feasible
+               || status == OptReturnType::TimeLimit) {
+                unscale(scaled_result, result);
+            }
+            return status;
+        }
+
+        static bool is_infinite(T value) {
+            return value == std::numeric_limits<T>::lowest()
+                   || value == std::numeric_limits<T>::max();
+        }
+
+        static T step(T norm) {
+            if(norm < T(min_norm)) {
+                return T(1);
+            }
+            return T(1) / std::sqrt(std::min(norm, T(max_norm)));
+        }
+
+        void equilibrate() {
+            Index n = scaled.num_vars(), m = scaled.num_constraints();
+            D.setOnes(n);
+            E.setOnes(m);
+            delta.resize(n);
+            epsilon.resize(m);
+
+            for(int iteration = 0; iteration < iterations; iteration++) {
+                compute_norms();
+                for(Index j = 0; j < n; j++) {
+                    delta(j) = step(std::max(Q_col_norms(j), A_col_norms(j)));
+                }
+                for(Index i = 0; i < m; i++) {
+                    epsilon(i) = scaled.is_soft_convertible(i) ? T(1) : step(A_row_norms(i));
+                }
+
+                apply(delta, epsilon);
+                D.array() *= delta.array();
+                E.array() *= epsilon.array();
+
+                T change = 0;
+                if(n > 0) {
+                    change = (T(1) - delta.array()).abs().maxCoeff();
+                }
+                if(m > 0) {
+                    change = std::max(change, (T(1) - epsilon.array()).abs().maxCoeff());
+                }
+                if(change < T(convergence_tolerance)) {
+                    break;
+                }
+            }
+
+            compute_norms();
+            reference_col_norms = Q_col_norms.cwiseMax(A_col_norms);
+            reference_row_norms = A_row_norms;
+        }
+
+        /*
+            True if the column and row sizes of the problem scaled with the
+            previous D and E are close to those D and E were computed for.
+        */
+        bool norms_match() const {
+            for(Index j = 0; j < reference_col_norms.rows(); j++) {
+                if(!close(std::max(Q_col_norms(j), A_col_norms(j)), reference_col_norms(j))) {
+                    return false;
+                }
+            }
+            for(Index i = 0; i < reference_row_norms.rows(); i++) {
+                if(!scaled.is_soft_convertible(i) && !close(A_row_norms(i), reference_row_norms(i))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool close(T norm, T reference) const {
+            if(norm < T(min_norm) || reference < T(min_norm)) {
+                return norm < T(min_norm) && reference < T(min_norm);
+            }
+            return norm <= reuse_ratio * reference && reference <= reuse_ratio * norm;
+        }
+
+        /*
+            Size of the cost gamma is chosen from, the larger of the mean
+            column of Q and of D c. Expects Q_col_norms of the D scaled Q
+            and c already scaled by D.
+        */
+        T cost_norm() const {
+            Index n = scaled.num_vars();
+            T mean_Q_norm = n > 0 ? Q_col_norms.sum() / n : T(0);
+            T c_norm = n > 0 ? scaled.c_mtr.cwiseAbs().maxCoeff() : T(0);
+            return std::max(mean_Q_norm, c_norm);
+        }
+
+        /*
+            Scales Q and the D scaled c by gamma.
+        */
+        void scale_cost() {
+            scaled.Q_mtr *= gamma;
+            scaled.c_mtr *= gamma;
+        }
+
+        void scale_limits() {
+            for(Index j = 0; j < scaled.num_vars(); j++) {
+                T low = scaled.lbx()(j), up = scaled.ubx()(j);
+                scaled.set_var_limits(j, is_infinite(low) ? low : low / D(j),
+                                      is_infinite(up) ? up : up / D(j));
+            }
+            for(Index i = 0; i < scaled.num_constraints(); i++) {
+                T low = scaled.lb()(i), up = scaled.ub()(i);
+                scaled.set_constraint_limits(i, is_infinite(low) ? low : low * E(i),
+                                             is_infinite(up) ? up : up * E(i));
+                if(scaled.is_soft_convertible(i)) {
+                    scaled.set_soft_convertible(i, true, gamma * scaled.soft_weight(i));
+                }
+            }
+        }
+
+        template<int NumVars, int MaxConstraints>
+        static Index nonzeros(const Problem<T, NumVars, MaxConstraints>&) {
+            return 0;
+        }
+
+        static Index nonzeros(const SparseProblem<T>& problem) {
+            return problem.Q().nonZeros() + problem.A().nonZeros();
+        }
+
+        void compute_norms() {
+            Index n = scaled.num_vars(), m = scaled.num_constraints();
+            Q_col_norms.setZero(n);
+            A_col_norms.setZero(n);
+            A_row_norms.setZero(m);
+            compute_norms(scaled);
+        }
+
+        template<int NumVars, int MaxConstraints>
+        void compute_norms(const Problem<T, NumVars, MaxConstraints>& problem) {
+            Index n = problem.num_vars(), m = problem.num_constraints();
+            if(n == 0) {
+                return;
+            }
+            Q_col_norms = problem.Q_mtr.cwiseAbs().colwise().maxCoeff().transpose();
+            if(m > 0) {
+                auto A = problem.A_mtr.topRows(m);
+                A_col_norms = A.cwiseAbs().colwise().maxCoeff().transpose();
+                A_row_norms = A.cwiseAbs().rowwise().maxCoeff();
+            }
+        }
+
+        void compute_norms(const SparseProblem<T>& problem) {
+            using SparseMatrix = typename SparseProblem<T>::SparseMatrix;
+            // Q holds only the upper triangle of the symmetric Q
+            for(Index j = 0; j < problem.Q_mtr.outerSize(); j++) {
+                for(typename SparseMatrix::InnerIterator it(problem.Q_mtr, j); it; ++it) {
+                    T value = std::abs(it.value());
+                    Q_col_norms(j) = std::max(Q_col_norms(j), value);
+                    Q_col_norms(it.row()) = std::max(Q_col_norms(it.row()), value);
+                }
+            }
+            for(Index j = 0; j < problem.A_mtr.outerSize(); j++) {
+                for(typename SparseMatrix::InnerIterator it(problem.A_mtr, j); it; ++it) {
+                    T value = std::abs(it.value());
+                    A_col_norms(j) = std::max(A_col_norms(j), value);
+                    A_row_norms(it.row()) = std::max(A_row_norms(it.row()), value);
+                }
+            }
+        }
+
+        /*
+            Q = diag(col) Q diag(col), A = diag(row) A diag(col).
+        */
+        void apply(const Vector& col, const Vector& row) {
+            apply(scaled, col, row);
+        }
+
+        template<int NumVars, int MaxConstraints>
+        static void apply(Problem<T, NumVars, MaxConstraints>& problem,
+                          const Vector& col, const Vector& row) {
+            Index m = problem.num_constraints();
+            problem.Q_mtr = col.asDiagonal() * problem.Q_mtr * col.asDiagonal();
+            if(m > 0) {
+                auto A = problem.A_mtr.topRows(m);
+                A = row.asDiagonal() * A * col.asDiagonal();
+            }
+        }
+
+        static void apply(SparseProblem<T>& problem, const Vector& col, const Vector& row) {
+            using SparseMatrix = typename SparseProblem<T>::SparseMatrix;
+            for(Index j = 0; j < problem.Q_mtr.outerSize(); j++) {
+                for(typename SparseMatrix::InnerIterator it(problem.Q_mtr, j); it; ++it) {
+                    it.valueRef() *= col(it.row()) * col(j);
+                }
+            }
+            for(Index j = 0; j < problem.A_mtr.outerSize(); j++) {
+                for(typename SparseMatrix::InnerIterator it(problem.A_mtr, j); it; ++it) {
+                    it.valueRef() *= row(it.row()) * col(j);
+                }
+            }
+        }
+};
+
+}
+
+#endif
@@ -0,0 +1,477 @@
+#ifndef QPWRAPPERS_SOFT_CONVERSION_HPP
+#define QPWRAPPERS_SOFT_CONVERSION_HPP
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include "problem.hpp"
+
+
+namespace QPWrappers {
+
+template<typename T>
+class SparseProblem;
+
+namespace soft_detail {
+
+/*
+    Type of the converted problem. The slack variables and rows do not fit
+    the compile time sizes of a fixed size Problem, so it is converted to a
+    dynamic size one.
+*/
+template<typename ProblemType>
+struct ConvertedType;
+
+template<typename S, int NumVars, int MaxConstraints>
+struct ConvertedType<Problem<S, NumVars, MaxConstraints>> {
+    using type = Problem<S>;
+};
+
+template<typename S>
+struct ConvertedType<SparseProblem<S>> {
+    using type = SparseProblem<S>;
+};
+
+}
+
+/**
+    Soft constraint version of a Problem or SparseProblem.
+
+    The first num_vars() variables of the converted problem are the original
+    variables and the rest are the slack variables. A soft convertible
+    equality constraint a^T x = b with weight w is moved to the objective as
+    the penalty w (a^T x - b)^2. A soft convertible inequality constraint
+    gets a nonnegative slack variable with cost w for each of its finite
+    limits, i.e. a^T x + s >= lb and a^T x - s <= ub. Other constraints are
+    carried as they are. A fixed size Problem is converted to a dynamic
+    size one.
+
+    The conversion touches only the nonzero entries of Q and A, apart from
+    filling the dense storage of a dense Problem. The converted problem is
+    kept, so that when only lb and ub of the base problem change it can be
+    brought up to date by refresh_bounds in O(num_constraints) plus the
+    number of nonzeros of the soft equality constraints.
+*/
+template<typename ProblemType>
+class SoftConversion {
+    public:
+        using T = typename ProblemType::Scalar;
+        using Converted = typename soft_detail::ConvertedType<ProblemType>::type;
+        using Vector = typename Converted::Vector;
+        using Index = Eigen::Index;
+        using ConstVectorSegment = typename Vector::ConstSegmentReturnType;
+
+        // returned as the slack or row index of a constraint that has none
+        static constexpr Index none = -1;
+
+        explicit SoftConversion(const ProblemType& base): converted(0) {
+            rebuild(base);
+        }
+
+        /*
+            Converts base from scratch.
+        */
+        void rebuild(const ProblemType& base) {
+            Index num_slacks = plan(base);
+            assemble(base, num_slacks);
+        }
+
+        /*
+            Brings the converted problem up to date after lb and ub of base
+            are changed. Q, c, A, lbx, ubx, and the soft constraint settings
+            of base are assumed to be unchanged since the last conversion.
+            If a constraint changed between being an equality and an
+            inequality, or one of its limits became finite or infinite,
+            the layout of the converted problem changes and the problem
+            is rebuilt instead.
+        */
+        void refresh_bounds(const ProblemType& base) {
+            if(base.num_constraints() != static_cast<Index>(constraints.size())) {
+                rebuild(base);
+                return;
+            }
+
+            for(Index i = 0; i < base.num_constraints(); i++) {
+                if(kind_of(base, i) != constraints[i].kind) {
+                    rebuild(base);
+                    return;
+                }
+            }
+
+            for(Index i = 0; i < base.num_constraints(); i++) {
+                ConstraintMap& constraint = constraints[i];
+                T low = base.lb()(i), up = base.ub()(i);
+
+                switch(constraint.kind) {
+                    case Kind::Hard:
+                        converted.set_constraint_limits(constraint.lower_row, low, up);
+                        break;
+                    case Kind::Penalty:
+                        if(low != constraint.penalty_target) {
+                            T scale = -2 * base.soft_weight(i) * (low - constraint.penalty_target);
+                            for(Index k = constraint.penalty_begin; k < constraint.penalty_end; k++) {
+                                converted.c_mtr(penalty_cols[k]) += scale * penalty_values[k];
+                            }
+                            converted.versions.c = new_version_stamp();
+                            constraint.penalty_target = low;
+                        }
+                        break;
+                    default:
+                        if(constraint.lower_row != none) {
+                            converted.set_constraint_limits(constraint.lower_row, low,
+                                                            std::numeric_limits<T>::max());
+                        }
+                        if(constraint.upper_row != none) {
+                            converted.set_constraint_limits(constraint.upper_row,
+                                                            std::numeric_limits<T>::lowest(), up);
+                        }
+                        break;
+                }
+            }
+        }
+
+        const Converted& problem() const & {
+            return converted;
+        }
+
+        Converted problem() && {
+            return std::move(converted);
+        }
+
+        inline Index num_original_vars() const {
+            return original_var_count;
+        }
+
+        inline Index num_slack_vars() const {
+            return converted.num_vars() - original_var_count;
+        }
+
+        /*
+            Original variables in a solution of the converted problem.
+        */
+        ConstVectorSegment original_variables(const Vector& soft_solution) const {
+            return soft_solution.head(original_var_count);
+        }
+
+        /*
+            Slack variables in a solution of the converted problem.
+        */
+        ConstVectorSegment slack_variables(const Vector& soft_solution) const {
+            return soft_solution.tail(num_slack_vars());
+        }
+
+        /*
+            Index of the variable of the converted problem that is the slack
+            of the lower / upper limit of constraint constraint_idx of the
+            base problem, or none if the limit has no slack.
+        */
+        inline Index lower_slack_index(Index constraint_idx) const {
+            return constraints[constraint_idx].lower_slack;
+        }
+
+        inline Index upper_slack_index(Index constraint_idx) const {
+            return constraints[constraint_idx].upper_slack;
+        }
+
+        /*
+            Slack of the lower / upper limit of constraint constraint_idx in
+            a solution of the converted problem, 0 if the limit has no slack.
+        */
+        T lower_slack(const Vector& soft_solution, Index constraint_idx) const {
+            Index idx = lower_slack_index(constraint_idx);
+            return idx == none ? T(0) : soft_solution(idx);
+        }
+
+        T upper_slack(const Vector& soft_solution, Index constraint_idx) const {
+            Index idx = upper_slack_index(constraint_idx);
+            return idx == none ? T(0) : soft_solution(idx);
+        }
+
+        /*
+            Row of the converted problem that enforces the lower / upper limit
+            of constraint constraint_idx of the base problem, or none if the
+            constraint is moved to the objective or the limit is infinite.
+            Both are the same row for a constraint that is not soft convertible.
+        */
+        inline Index lower_row(Index constraint_idx) const {
+            return constraints[constraint_idx].lower_row;
+        }
+
+        inline Index upper_row(Index constraint_idx) const {
+            return constraints[constraint_idx].upper_row;
+        }
+
+    private:
+        using RowMajorSparseMatrix = Eigen::SparseMatrix<T, Eigen::RowMajor>;
+
+        // Hard: carried as it is. Penalty: soft equality constraint moved to
+        // the objective. LowerSlack, UpperSlack, BothSlacks: soft inequality
+        // constraint with a slack for its finite limits. Dropped: soft
+        // inequality constraint with no finite limit.
+        enum class Kind {
+            Hard,
+            Penalty,
+            LowerSlack,
+            UpperSlack,
+            BothSlacks,
+            Dropped
+        };
+
+        struct ConstraintMap {
+            Kind kind = Kind::Hard;
+            Index lower_row = none, upper_row = none;
+            Index lower_slack = none, upper_slack = none;
+
+            // for penalties, the entries of the constraint row are
+            // penalty_cols / penalty_values in [penalty_begin, penalty_end),
+            // and penalty_target is the lb the objective is built for.
+            Index penalty_begin = 0, penalty_end = 0;
+            T penalty_target = 0;
+        };
+
+        Converted converted;
+        Index original_var_count = 0;
+        Index converted_row_count = 0;
+        std::vector<ConstraintMap> constraints;
+        std::vector<Index> penalty_cols;
+        std::vector<T> penalty_values;
+
+        static Kind kind_of(const ProblemType& base, Index i) {
+            if(!base.is_soft_convertible(i)) {
+                return Kind::Hard;
+            }
+
+            T low = base.lb()(i), up = base.ub()(i);
+            if(low == up) {
+                return Kind::Penalty;
+            }
+
+            bool has_lower = low != std::numeric_limits<T>::lowest();
+            bool has_upper = up != std::numeric_limits<T>::max();
+            if(has_lower && has_upper) {
+                return Kind::BothSlacks;
+            } else if(has_lower) {
+                return Kind::LowerSlack;
+            } else if(has_upper) {
+                return Kind::UpperSlack;
+            }
+            return Kind::Dropped;
+        }
+
+        /*
+            Decides the rows and slack variables of each constraint,
+            returns the number of slack variables.
+        */
+        Index plan(const ProblemType& base) {
+            original_var_count = base.num_vars();
+            constraints.assign(base.num_constraints(), ConstraintMap());
+
+            Index row = 0, slack = base.num_vars();
+            for(Index i = 0; i < base.num_constraints(); i++) {
+                ConstraintMap& constraint = constraints[i];
+                constraint.kind = kind_of(base, i);
+
+                switch(constraint.kind) {
+                    case Kind::Hard:
+                        constraint.lower_row = constraint.upper_row = row++;
+                        break;
+                    case Kind::Penalty:
+                    case Kind::Dropped:
+                        break;
+                    default:
+                        if(constraint.kind != Kind::UpperSlack) {
+                            constraint.lower_row = row++;
+                            constraint.lower_slack = slack++;
+                        }
+                        if(constraint.kind != Kind::LowerSlack) {
+                            constraint.upper_row = row++;
+                            constraint.upper_slack = slack++;
+                        }
+                        break;
+                }
+            }
+
+            converted_row_count = row;
+            return slack - base.num_vars();
+        }
+
+        template<typename S, int NumVars, int MaxConstraints>
+        static RowMajorSparseMatrix constraint_rows(const Problem<S, NumVars, MaxConstraints>& base) {
+            return base.A().sparseView();
+        }
+
+        template<typename S>
+        static RowMajorSparseMatrix constraint_rows(const SparseProblem<S>& base) {
+            return base.A();
+        }
+
+        /*
+            Records the entries of the soft equality constraints and returns
+            the penalties they add to the upper triangle of Q as triplets.
+        */
+        std::vector<Eigen::Triplet<T>> collect_penalties(const ProblemType& base,
+                                                        const RowMajorSparseMatrix& rows) {
+            penalty_cols.clear();
+            penalty_values.clear();
+            std::vector<Eigen::Triplet<T>> Q_additions;
+
+            for(Index i = 0; i < base.num_constraints(); i++) {
+                ConstraintMap& constraint = constraints[i];
+                if(constraint.kind != Kind::Penalty) {
+                    continue;
+                }
+
+                constraint.penalty_begin = static_cast<Index>(penalty_cols.size());
+                for(typename RowMajorSparseMatrix::InnerIterator it(rows, i); it; ++it) {
+                    penalty_cols.push_back(it.col());
+                    penalty_values.push_back(it.value());
+                }
+                constraint.penalty_end = static_cast<Index>(penalty_cols.size());
+                constraint.penalty_target = base.lb()(i);
+
+                // inner indices of a row major sparse matrix are sorted,
+                // so (a, b) with a <= b is in the upper triangle.
+                T weight = 2 * base.soft_weight(i);
+                for(Index a = constraint.penalty_begin; a < constraint.penalty_end; a++) {
+                    for(Index b = a; b < constraint.penalty_end; b++) {
+                        Q_additions.emplace_back(penalty_cols[a], penalty_cols[b],
+                                weight * penalty_values[a] * penalty_values[b]);
+                    }
+                }
+            }
+
+            return Q_additions;
+        }
+
+        /*
+            Fills c, lbx, and ubx of the converted problem.
+        */
+        void assemble_vectors(const ProblemType& base, Converted& result) const {
+            Index n = base.num_vars();
+
+            result.c_mtr.head(n) = base.c();
+            result.lbx_mtr.head(n) = base.lbx();
+            result.ubx_mtr.head(n) = base.ubx();
+            result.lbx_mtr.tail(result.num_vars() - n).setZero();
+
+            for(Index i = 0; i < base.num_constraints(); i++) {
+                const ConstraintMap& constraint = constraints[i];
+                if(constraint.kind == Kind::Penalty) {
+                    T scale = -2 * base.soft_weight(i) * constraint.penalty_target;
+                    for(Index k = constraint.penalty_begin; k < constraint.penalty_end; k++) {
+                        result.c_mtr(penalty_cols[k]) += scale * penalty_values[k];
+                    }
+                }
+                if(constraint.lower_slack != none) {
+                    result.c_mtr(constraint.lower_slack) = base.soft_weight(i);
+                }
+                if(constraint.upper_slack != none) {
+                    result.c_mtr(constraint.upper_slack) = base.soft_weight(i);
+                }
+            }
+        }
+
+        /*
+            Calls f(row, low, up, slack, slack_coeff) for each row of the
+            converted problem, where slack is none for rows without a slack.
+        */
+        template<typename F>
+        void for_each_row(const ProblemType& base, F f) const {
+            for(Index i = 0; i < base.num_constraints(); i++) {
+                const ConstraintMap& constraint = constraints[i];
+                if(constraint.kind == Kind::Hard) {
+                    f(i, constraint.lower_row, base.lb()(i), base.ub()(i), none, T(0));
+                    continue;
+                }
+                if(constraint.lower_row != none) {
+                    f(i, constraint.lower_row, base.lb()(i), std::numeric_limits<T>::max(),
+                      constraint.lower_slack, T(1));
+                }
+                if(constraint.upper_row != none) {
+                    f(i, constraint.upper_row, std::numeric_limits<T>::lowest(), base.ub()(i),
+                      constraint.upper_slack, T(-1));
+                }
+            }
+        }
+
+        template<typename S, int NumVars, int MaxConstraints>
+        void assemble(const Problem<S, NumVars, MaxConstraints>& base, Index num_slacks) {
+            Index n = base.num_vars();
+            RowMajorSparseMatrix rows = constraint_rows(base);
+            std::vector<Eigen::Triplet<T>> Q_additions = collect_penalties(base, rows);
+
+            Problem<S> result(n + num_slacks, converted_row_count);
+
+            // the accumulator of the result holds the upper triangle of Q,
+            // its lower triangle is mirrored when it is read.
+            result.Q_mtr.topLeftCorner(n, n) = base.Q_upper();
+            for(const auto& triplet: Q_additions) {
+                result.Q_mtr(triplet.row(), triplet.col()) += triplet.value();
+            }
+            result.Q_fully_dirty = true;
+            result.versions.Q = new_version_stamp();
+
+            assemble_vectors(base, result);
+
+            result.A_mtr.setZero();
+            result.soft_weights.setConstant(T(1));
+            for_each_row(base, [&](Index i, Index row, T low, T up, Index slack, T slack_coeff) {
+                for(typename RowMajorSparseMatrix::InnerIterator it(rows, i); it; ++it) {
+                    result.A_mtr(row, it.col()) = it.value();
+                }
+                if(slack != none) {
+                    result.A_mtr(row, slack) = slack_coeff;
+                }
+                result.lb_mtr(row) = low;
+                result.ub_mtr(row) = up;
+            });
+
+            converted = std::move(result);
+        }
+
+        template<typename S>
+        void assemble(const SparseProblem<S>& base, Index num_slacks) {
+            using SparseMatrix = typename SparseProblem<S>::SparseMatrix;
+
+            Index n = base.num_vars();
+            RowMajorSparseMatrix rows = constraint_rows(base);
+            std::vector<Eigen::Triplet<T>> Q_additions = collect_penalties(base, rows);
+
+            SparseProblem<S> result(n + num_slacks, converted_row_count);
+
+            result.Q_mtr = base.Q();
+            result.Q_mtr.conservativeResize(n + num_slacks, n + num_slacks);
+            if(!Q_additions.empty()) {
+                SparseMatrix addition(n + num_slacks, n + num_slacks);
+                addition.setFromTriplets(Q_additions.begin(), Q_additions.end());
+                result.Q_mtr += addition;
+            }
+            result.Q_mtr.makeCompressed();
+            result.versions.Q = new_version_stamp();
+
+            assemble_vectors(base, result);
+
+            std::vector<Eigen::Triplet<T>> A_entries;
+            A_entries.reserve(rows.nonZeros() + num_slacks);
+            for_each_row(base, [&](Index i, Index row, T low, T up, Index slack, T slack_coeff) {
+                for(typename RowMajorSparseMatrix::InnerIterator it(rows, i); it; ++it) {
+                    A_entries.emplace_back(row, it.col(), it.value());
+                }
+                if(slack != none) {
+                    A_entries.emplace_back(row, slack, slack_coeff);
+                }
+                result.lb_vec[row] = low;
+                result.ub_vec[row] = up;
+            });
+            result.A_mtr.setFromTriplets(A_entries.begin(), A_entries.end());
+            result.A_mtr.makeCompressed();
+
+            converted = std::move(result);
+        }
+};
+
+}
+
+#endif
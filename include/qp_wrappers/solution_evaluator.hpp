@@ -0,0 +1,262 @@
+#ifndef QPWRAPPERS_SOLUTION_EVALUATOR_HPP
+#define QPWRAPPERS_SOLUTION_EVALUATOR_HPP
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "problem.hpp"
+#include "sparse_problem.hpp"
+
+
+namespace QPWrappers {
+
+/*
+    Quality of a solution of a problem. Violations are the largest amounts
+    by which a limit is exceeded, 0 if none is.
+    Dual quantities are only computed if duals are given, for which
+        Q x + c + A^T y + z = 0
+    holds at optimality, where y(i) is positive if the upper limit of
+    constraint i is active and negative if its lower limit is, and z is
+    the same for the variable limits.
+*/
+template<typename T>
+struct SolutionQuality {
+    T objective = 0;
+    T max_constraint_violation = 0;
+    T max_bound_violation = 0;
+
+    bool has_duals = false;
+    T dual_residual = 0;
+    T complementarity = 0;
+
+    T max_primal_violation() const {
+        return std::max(max_constraint_violation, max_bound_violation);
+    }
+};
+
+namespace solution_evaluator_detail {
+
+template<typename T, int NumVars, int MaxConstraints>
+const typename Problem<T, NumVars, MaxConstraints>::Matrix&
+Q_upper(const Problem<T, NumVars, MaxConstraints>& problem) {
+    return problem.Q_upper();
+}
+
+template<typename T>
+const typename SparseProblem<T>::SparseMatrix& Q_upper(const SparseProblem<T>& problem) {
+    return problem.Q();
+}
+
+}
+
+/**
+    Evaluates solutions of a Problem or SparseProblem, optionally with
+    their duals, without allocating once its buffers are sized.
+
+    Products with Q and A are written to buffers kept by the evaluator,
+    which are only resized when the problem or batch size grows. A batch of
+    solutions, one per column, is evaluated with one matrix product for
+    each of Q and A instead of one matrix vector product per solution.
+    The problem is held by reference and is read at each evaluation.
+*/
+template<typename ProblemType>
+class SolutionEvaluator {
+    public:
+        using Scalar = typename ProblemType::Scalar;
+        using Index = Eigen::Index;
+        using Vector = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+        using Matrix = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+        using Quality = SolutionQuality<Scalar>;
+
+        explicit SolutionEvaluator(const ProblemType& problem): problem(problem) {
+            reserve(1);
+        }
+
+        /*
+            Sizes the buffers for batches of up to batch_size solutions of
+            the current problem.
+        */
+        void reserve(Index batch_size) {
+            Index n = problem.num_vars(), m = problem.num_constraints();
+            if(Qx.rows() < n || Qx.cols() < batch_size) {
+                Qx.resize(n, batch_size);
+                residual.resize(n, batch_size);
+            }
+            if(Ax.rows() < m || Ax.cols() < batch_size) {
+                Ax.resize(m, batch_size);
+            }
+        }
+
+        void evaluate(const Eigen::Ref<const Vector>& x, Quality& quality) {
+            check_sizes(x.rows(), 1);
+            evaluate_products(x);
+            evaluate_primal(x, Qx.col(0).head(x.rows()), Ax.col(0).head(problem.num_constraints()), quality);
+        }
+
+        /*
+            Evaluates x with the constraint duals y and variable limit duals z.
+        */
+        void evaluate(const Eigen::Ref<const Vector>& x, const Eigen::Ref<const Vector>& y,
+                      const Eigen::Ref<const Vector>& z, Quality& quality) {
+            check_sizes(x.rows(), 1);
+            check_dual_sizes(y.rows(), z.rows(), 1, 1);
+            evaluate_products(x);
+            evaluate_dual_products(y, z);
+            evaluate_primal(x, Qx.col(0).head(x.rows()), Ax.col(0).head(problem.num_constraints()), quality);
+            evaluate_dual(x, y, z, Ax.col(0).head(problem.num_constraints()),
+                          residual.col(0).head(x.rows()), quality);
+        }
+
+        /*
+            Evaluates each column of X as a solution, and writes the quality
+            of column j to qualities[j].
+        */
+        void evaluate_batch(const Eigen::Ref<const Matrix>& X, std::vector<Quality>& qualities) {
+            check_sizes(X.rows(), X.cols());
+            evaluate_products(X);
+
+            qualities.resize(X.cols());
+            for(Index j = 0; j < X.cols(); j++) {
+                evaluate_primal(X.col(j), Qx.col(j).head(X.rows()),
+                                Ax.col(j).head(problem.num_constraints()), qualities[j]);
+            }
+        }
+
+        /*
+            Batch version of evaluate with duals, where column j of Y and Z
+            are the duals of column j of X.
+        */
+        void evaluate_batch(const Eigen::Ref<const Matrix>& X, const Eigen::Ref<const Matrix>& Y,
+                            const Eigen::Ref<const Matrix>& Z, std::vector<Quality>& qualities) {
+            check_sizes(X.rows(), X.cols());
+            check_dual_sizes(Y.rows(), Z.rows(), Y.cols(), Z.cols());
+            evaluate_products(X);
+            evaluate_dual_products(Y, Z);
+
+            qualities.resize(X.cols());
+            for(Index j = 0; j < X.cols(); j++) {
+                auto Ax_j = Ax.col(j).head(problem.num_constraints());
+                evaluate_primal(X.col(j), Qx.col(j).head(X.rows()), Ax_j, qualities[j]);
+                evaluate_dual(X.col(j), Y.col(j), Z.col(j), Ax_j,
+                              residual.col(j).head(X.rows()), qualities[j]);
+            }
+        }
+
+    private:
+        const ProblemType& problem;
+
+        // Qx and residual hold a solution per column in their top n rows,
+        // Ax in its top m rows.
+        Matrix Qx, Ax, residual;
+
+        void check_sizes(Index rows, Index cols) {
+            if(rows != problem.num_vars()) {
+                throw std::domain_error(
+                    std::string("Problem has ")
+                    + std::to_string(problem.num_vars())
+                    + std::string(" variables, but given solution has ")
+                    + std::to_string(rows)
+                    + std::string(" rows.")
+                );
+            }
+            reserve(cols);
+        }
+
+        void check_dual_sizes(Index y_rows, Index z_rows, Index y_cols, Index z_cols) const {
+            if(y_rows != problem.num_constraints() || z_rows != problem.num_vars()) {
+                throw std::domain_error(
+                    std::string("Problem has ")
+                    + std::to_string(problem.num_constraints())
+                    + std::string(" constraints and ")
+                    + std::to_string(problem.num_vars())
+                    + std::string(" variables, but given duals have ")
+                    + std::to_string(y_rows)
+                    + std::string(" and ")
+                    + std::to_string(z_rows)
+                    + std::string(" rows.")
+                );
+            }
+            if(y_cols != z_cols) {
+                throw std::domain_error("constraint and variable limit duals have different batch sizes");
+            }
+        }
+
+        template<typename Solutions>
+        void evaluate_products(const Solutions& X) {
+            Index n = X.rows(), k = X.cols(), m = problem.num_constraints();
+            Qx.topLeftCorner(n, k).noalias() =
+                solution_evaluator_detail::Q_upper(problem).template selfadjointView<Eigen::Upper>() * X;
+            Ax.topLeftCorner(m, k).noalias() = problem.A() * X;
+        }
+
+        /*
+            residual = Q X + c + A^T Y + Z, reusing Q X.
+        */
+        template<typename Duals>
+        void evaluate_dual_products(const Duals& Y, const Duals& Z) {
+            Index n = Z.rows(), k = Z.cols();
+            auto R = residual.topLeftCorner(n, k);
+            R = Qx.topLeftCorner(n, k) + Z;
+            R.colwise() += problem.c();
+            R.noalias() += problem.A().transpose() * Y;
+        }
+
+        template<typename Solution, typename Products, typename ConstraintValues>
+        void evaluate_primal(const Solution& x, const Products& Qx_j,
+                             const ConstraintValues& Ax_j, Quality& quality) const {
+            quality.objective = x.dot(Qx_j) / 2 + problem.c().dot(x);
+            quality.max_bound_violation = max_violation(x, problem.lbx(), problem.ubx());
+            quality.max_constraint_violation = max_violation(Ax_j, problem.lb(), problem.ub());
+            quality.has_duals = false;
+        }
+
+        template<typename Solution, typename Duals, typename ConstraintValues, typename Residual>
+        void evaluate_dual(const Solution& x, const Duals& y, const Duals& z,
+                           const ConstraintValues& Ax_j, const Residual& residual_j,
+                           Quality& quality) const {
+            quality.has_duals = true;
+            quality.dual_residual = residual_j.size() == 0 ? Scalar(0)
+                                    : residual_j.cwiseAbs().maxCoeff();
+            quality.complementarity = std::max(
+                max_complementarity(Ax_j, y, problem.lb(), problem.ub()),
+                max_complementarity(x, z, problem.lbx(), problem.ubx())
+            );
+        }
+
+        template<typename Values, typename Lower, typename Upper>
+        static Scalar max_violation(const Values& values, const Lower& lower, const Upper& upper) {
+            if(values.size() == 0) {
+                return 0;
+            }
+            return std::max(Scalar(0), (lower - values).cwiseMax(values - upper).maxCoeff());
+        }
+
+        /*
+            Largest |multiplier * distance to the limit it belongs to|, which
+            is infinite if a multiplier is nonzero for an infinite limit.
+        */
+        template<typename Values, typename Duals, typename Lower, typename Upper>
+        static Scalar max_complementarity(const Values& values, const Duals& duals,
+                                          const Lower& lower, const Upper& upper) {
+            Scalar result = 0;
+            for(Index i = 0; i < values.size(); i++) {
+                Scalar dual = duals(i);
+                Scalar limit = dual > 0 ? upper(i) : lower(i);
+                if(dual == Scalar(0)) {
+                    continue;
+                }
+                if(limit == std::numeric_limits<Scalar>::max()
+                   || limit == std::numeric_limits<Scalar>::lowest()) {
+                    return std::numeric_limits<Scalar>::infinity();
+                }
+                result = std::max(result, std::abs(dual * (limit - values(i))));
+            }
+            return result;
+        }
+};
+
+}
+
+#endif
@@ -0,0 +1,1057 @@
+#ifndef QPWRAPPERS_SPARSE_PROBLEM_HPP
+#define QPWRAPPERS_SPARSE_PROBLEM_HPP
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <limits>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "problem.hpp"
+#include "types.hpp"
+
+
+namespace QPWrappers {
+
+/**
+    Sparse counterpart of Problem. Defines the same quadratic program
+         minimize 1/2 x^T Q x + c^T x
+         subject to
+           lb <= Ax <= ub
+           lbx <= x <= ubx
+    where Q is a symmetric matrix of which only the upper triangle is stored,
+    and A is stored in compressed sparse column format. Both matrices are
+    accumulated as triplets and compressed the next time they are read.
+*/
+template<typename T>
+class SparseProblem {
+    public:
+        using Scalar = T;
+        using Matrix = typename Problem<T>::Matrix;
+        using Vector = typename Problem<T>::Vector;
+        using RowVector = typename Problem<T>::RowVector;
+        using SparseMatrix = Eigen::SparseMatrix<T, Eigen::ColMajor>;
+        using SparseRowVector = Eigen::SparseVector<T, Eigen::RowMajor>;
+        using Triplet = Eigen::Triplet<T>;
+        using Index = Eigen::Index;
+        using VectorMap = Eigen::Map<const Vector>;
+
+        /*
+            Construct a QP with N variables with M constraints.
+            Each of the M constraints starts as an empty row with no lower
+            and upper limit, and can be set by set_constraint.
+        */
+        SparseProblem(Index N, Index M = 0):
+                Q_mtr(N, N),
+                A_mtr(M, N),
+                Q_dirty(false),
+                A_dirty(false),
+                lb_vec(M, std::numeric_limits<T>::lowest()),
+                ub_vec(M, std::numeric_limits<T>::max()),
+                soft_weights_vec(M, T(1)),
+                soft_convertible(M, false) {
+            c_mtr.setConstant(N, 0);
+            lbx_mtr.setConstant(N, std::numeric_limits<T>::lowest());
+            ubx_mtr.setConstant(N, std::numeric_limits<T>::max());
+        }
+
+        /*
+            Construct the sparse version of the given dense problem.
+            Only the nonzero entries of Q and A are carried.
+        */
+        explicit SparseProblem(const Problem<T>& problem):
+                SparseProblem(problem.num_vars()) {
+            add_Q(problem.Q());
+            reserve(problem.num_constraints());
+
+            for(Index i = 0; i < problem.num_constraints(); i++) {
+                add_constraint(problem.A().row(i), problem.lb()(i),
+                               problem.ub()(i), problem.is_soft_convertible(i),
+                               problem.soft_weight(i));
+            }
+
+            c_mtr = problem.c();
+            lbx_mtr = problem.lbx();
+            ubx_mtr = problem.ubx();
+        }
+
+        /*
+         * Converts the problem to the version with soft constraints
+         * where first num_vars() variables are the original variables
+         * and the rest are the slack variables.
+         * Use SoftConversion directly to keep the converted problem
+         * around and map its solutions back.
+         */
+        SparseProblem<T> convert_to_soft() const {
+            return SoftConversion<SparseProblem<T>>(*this).problem();
+        }
+
+        /*
+        * Resets the problem so that there is no constraint, objective is 0, and
+        * there is no upper and lower limit. Triplet, matrix and constraint
+        * storage is kept, so rebuilding a problem of the same size does not
+        * reallocate.
+        */
+        void reset() {
+            Q_triplets.clear();
+            A_triplets.clear();
+            Q_mtr.setZero();
+            A_mtr.resize(0, num_vars());
+            Q_dirty = A_dirty = false;
+            versions = ProblemVersion::fresh();
+            lb_vec.clear();
+            ub_vec.clear();
+            soft_weights_vec.clear();
+            soft_convertible.clear();
+            c_mtr.setZero();
+            lbx_mtr.setConstant(num_vars(), std::numeric_limits<T>::lowest());
+            ubx_mtr.setConstant(num_vars(), std::numeric_limits<T>::max());
+        }
+
+        inline bool is_ubx_unbounded(Index var_idx) const {
+            return ubx_mtr(var_idx) == std::numeric_limits<T>::max();
+        }
+
+        inline bool is_lbx_unbounded(Index var_idx) const {
+            return lbx_mtr(var_idx) == std::numeric_limits<T>::lowest();
+        }
+
+        inline Index num_vars() const {
+            return c_mtr.rows();
+        }
+
+        inline Index num_constraints() const {
+            return static_cast<Index>(lb_vec.size());
+        }
+
+        inline bool is_soft_convertible(Index constraint_idx) const {
+            return soft_convertible[constraint_idx];
+        }
+
+        inline T soft_weight(Index constraint_idx) const {
+            return soft_weights_vec[constraint_idx];
+        }
+
+        /*
+            Sets the constraint with index constraint_idx.
+            After the operation, low <= coeff * x <= up is enforced by the
+            row with index constraint_idx of A, lb, and ub.
+        */
+        void set_constraint(Index constraint_idx, const RowVector& coeff,
+                            T low, T up, bool is_soft_convertible = false,
+                            T soft_weight = T(1)) {
+            check_row_size(coeff.cols());
+            check_constraint_index(constraint_idx);
+
+            clear_row(constraint_idx);
+            add_row_entries(constraint_idx, coeff);
+            set_row_limits(constraint_idx, low, up, is_soft_convertible, soft_weight);
+        }
+
+        /*
+            Sparse row version of set_constraint.
+        */
+        void set_constraint(Index constraint_idx, const SparseRowVector& coeff,
+                            T low, T up, bool is_soft_convertible = false,
+                            T soft_weight = T(1)) {
+            check_row_size(coeff.cols());
+            check_constraint_index(constraint_idx);
+
+            clear_row(constraint_idx);
+            add_row_entries(constraint_idx, coeff);
+            set_row_limits(constraint_idx, low, up, is_soft_convertible, soft_weight);
+        }
+
+        /*
+            Sets the limits of the constraint with index constraint_idx
+            without changing its coefficients.
+        */
+        void set_constraint_limits(Index constraint_idx, T low, T up) {
+            check_constraint_index(constraint_idx);
+
+            lb_vec[constraint_idx] = low;
+            ub_vec[constraint_idx] = up;
+            versions.limits = new_version_stamp();
+        }
+
+        /*
+            Sets whether the constraint with index constraint_idx is converted
+            to a soft constraint by convert_to_soft, and the weight it gets.
+        */
+        void set_soft_convertible(Index constraint_idx, bool is_soft_convertible,
+                                  T soft_weight = T(1)) {
+            check_constraint_index(constraint_idx);
+
+            soft_convertible[constraint_idx] = is_soft_convertible;
+            soft_weights_vec[constraint_idx] = soft_weight;
+        }
+
+        /*
+            Adds a new constraint which enforces
+                low <= coeff * x <= up
+            Only the nonzero entries of coeff are stored.
+        */
+        void add_constraint(const RowVector& coeff, T low, T up,
+                bool is_soft_convertible = false, T soft_weight = T(1)) {
+            check_row_size(coeff.cols());
+
+            Index constraint_idx = append_row(low, up, is_soft_convertible, soft_weight);
+            add_row_entries(constraint_idx, coeff);
+        }
+
+        /*
+            Sparse row version of add_constraint.
+        */
+        void add_constraint(const SparseRowVector& coeff, T low, T up,
+                bool is_soft_convertible = false, T soft_weight = T(1)) {
+            check_row_size(coeff.cols());
+
+            Index constraint_idx = append_row(low, up, is_soft_convertible, soft_weight);
+            add_row_entries(constraint_idx, coeff);
+        }
+
+        /*
+            Adds a new constraint for each row of coeffs, where i^th
+            one enforces
+                low(i) <= coeffs.row(i) * x <= up(i)
+            Only the nonzero entries of coeffs are stored.
+        */
+        void add_constraints(const Matrix& coeffs, const Vector& low, const Vector& up,
+                bool is_soft_convertible = false, T soft_weight = T(1)) {
+            check_block_size(coeffs.rows(), coeffs.cols(), low.rows(), up.rows());
+
+            Index first_row = num_constraints();
+            append_rows(low, up, is_soft_convertible, soft_weight);
+            for(Index i = 0; i < coeffs.rows(); i++) {
+                for(Index j = 0; j < coeffs.cols(); j++) {
+                    if(coeffs(i, j) != T(0)) {
+                        A_triplets.emplace_back(first_row + i, j, coeffs(i, j));
+                    }
+                }
+            }
+        }
+
+        /*
+            Sparse version of add_constraints.
+        */
+        void add_constraints(const SparseMatrix& coeffs, const Vector& low, const Vector& up,
+                bool is_soft_convertible = false, T soft_weight = T(1)) {
+            check_block_size(coeffs.rows(), coeffs.cols(), low.rows(), up.rows());
+
+            Index first_row = num_constraints();
+            append_rows(low, up, is_soft_convertible, soft_weight);
+            A_triplets.reserve(A_triplets.size() + coeffs.nonZeros());
+            for(Index k = 0; k < coeffs.outerSize(); k++) {
+                for(typename SparseMatrix::InnerIterator it(coeffs, k); it; ++it) {
+                    A_triplets.emplace_back(first_row + it.row(), it.col(), it.value());
+                }
+            }
+        }
+
+        /*
+            Makes sure that at least rows constraints can be held without
+            reallocating the constraint storage.
+        */
+        void reserve(Index rows) {
+            lb_vec.reserve(rows);
+            ub_vec.reserve(rows);
+            soft_weights_vec.reserve(rows);
+            soft_convertible.reserve(rows);
+        }
+
+        /*
+            Adds value to the coefficient of variable var_idx in the constraint
+            with index constraint_idx, i.e. to A(constraint_idx, var_idx).
+        */
+        void add_constraint_entry(Index constraint_idx, Index var_idx, T value) {
+            check_constraint_index(constraint_idx);
+            check_var_index(var_idx);
+
+            A_triplets.emplace_back(constraint_idx, var_idx, value);
+            A_dirty = true;
+            versions.A = new_version_stamp();
+        }
+
+        /*
+            Sets the limits of variable with index var_idx. Enforces
+                low <= x[var_idx] <= up
+        */
+        void set_var_limits(Index var_idx, T low, T up) {
+            check_var_index(var_idx);
+
+            lbx_mtr(var_idx) = low;
+            ubx_mtr(var_idx) = up;
+            versions.var_limits = new_version_stamp();
+        }
+
+        /*
+            Adds value to Q(i, j). Since Q is symmetric, the value is split
+            evenly between Q(i, j) and Q(j, i) when i != j.
+        */
+        void add_Q_entry(Index i, Index j, T value) {
+            check_var_index(i);
+            check_var_index(j);
+
+            if(i == j) {
+                Q_triplets.emplace_back(i, j, value);
+            } else {
+                Q_triplets.emplace_back(std::min(i, j), std::max(i, j), value / 2);
+            }
+            Q_dirty = true;
+            versions.Q = new_version_stamp();
+        }
+
+        /*
+            Adds each (row, col, value) triplet in [begin, end) to Q
+            as in add_Q_entry.
+        */
+        template<typename Iterator>
+        void add_Q_triplets(Iterator begin, Iterator end) {
+            for(; begin != end; ++begin) {
+                add_Q_entry(begin->row(), begin->col(), begin->value());
+            }
+        }
+
+        /*
+            Adds given matrix to the Q of the problem.
+            If given matrix is not symmetric, makes it symmetric first.
+        */
+        void add_Q(const Matrix& Q) {
+            if(Q.rows() != num_vars() || Q.cols() != num_vars()) {
+                throw std::domain_error(
+                            std::string("Q of the problem is ")
+                            + std::to_string(num_vars())
+                            + std::string("x")
+                            + std::to_string(num_vars())
+                            + std::string(" but Q of size ")
+                            + std::to_string(Q.rows())
+                            + std::string("x")
+                            + std::to_string(Q.cols())
+                            + std::string(" was provided to add to it.")
+                            );
+            }
+
+            add_Q_block(0, 0, Q);
+        }
+
+        /*
+        * Adds given matrix to the block of Q of the problem where
+        * block starts from row i and column j and spans Q.rows() rows
+        * and Q.cols() columns. Zero entries of the block are skipped.
+        */
+        void add_Q_block(Index i, Index j, const Matrix& Q) {
+            if(i + Q.rows() > num_vars() || j + Q.cols() > num_vars()) {
+                throw std::domain_error(
+                    std::string("given Q block matrix runs of the Q of the problem")
+                );
+            }
+
+            for(Index r = 0; r < Q.rows(); r++) {
+                for(Index c = 0; c < Q.cols(); c++) {
+                    if(Q(r, c) != T(0)) {
+                        add_Q_entry(i + r, j + c, Q(r, c));
+                    }
+                }
+            }
+        }
+
+        /*
+            Sparse version of add_Q_block.
+        */
+        void add_Q_block(Index i, Index j, const SparseMatrix& Q) {
+            if(i + Q.rows() > num_vars() || j + Q.cols() > num_vars()) {
+                throw std::domain_error(
+                    std::string("given Q block matrix runs of the Q of the problem")
+                );
+            }
+
+            for(Index k = 0; k < Q.outerSize(); k++) {
+                for(typename SparseMatrix::InnerIterator it(Q, k); it; ++it) {
+                    add_Q_entry(i + it.row(), j + it.col(), it.value());
+                }
+            }
+        }
+
+        /*
+            return if Q is a PSD matrix
+            eigen values are allowed to be more than -tolerance.
+            Checked by a sparse Cholesky factorization of Q shifted by tolerance.
+        */
+        bool is_Q_psd(T tolerance = 0) const {
+            return classify_Q(tolerance) != QDefiniteness::Indefinite;
+        }
+
+        /*
+            return if Q is a PD matrix
+        */
+        bool is_Q_pd() const {
+            return classify_Q() == QDefiniteness::PositiveDefinite;
+        }
+
+        /*
+            Classifies Q as positive definite, positive semidefinite where
+            eigenvalues are allowed to be more than -tolerance, or indefinite.
+            Results are cached until Q is modified.
+        */
+        QDefiniteness classify_Q(T tolerance = 0) const {
+            if(Q_class_cache.version != versions.Q) {
+                Q_class_cache = QClassCache();
+                Q_class_cache.version = versions.Q;
+            }
+
+            if(!Q_class_cache.pd_known) {
+                Q_class_cache.is_pd = is_shifted_Q_pd(0);
+                Q_class_cache.pd_known = true;
+            }
+
+            if(Q_class_cache.is_pd) {
+                return QDefiniteness::PositiveDefinite;
+            }
+
+            if(!Q_class_cache.psd_known || Q_class_cache.psd_tolerance != tolerance) {
+                Q_class_cache.is_psd = is_shifted_Q_pd(tolerance + psd_shift_epsilon());
+                Q_class_cache.psd_tolerance = tolerance;
+                Q_class_cache.psd_known = true;
+            }
+
+            return Q_class_cache.is_psd ? QDefiniteness::PositiveSemidefinite
+                                        : QDefiniteness::Indefinite;
+        }
+
+        /*
+            Version stamp of Q, which changes every time Q changes.
+        */
+        inline std::size_t Q_version() const {
+            return versions.Q;
+        }
+
+        /*
+            Versions of the parts of the problem, which engines compare
+            with the versions they last solved to update only what changed.
+            Pending entries are added to Q and A first, so that changes of
+            their sparsity patterns show up in the structure version.
+        */
+        const ProblemVersion& version() const {
+            compress_Q();
+            compress_A();
+            return versions;
+        }
+
+        /*
+            Regularizes a Q that is PSD up to psd_tolerance but not positive
+            definite. If the lower bound of the minimum eigenvalue estimated
+            with the given method is in [-psd_tolerance, 0), (psd_tolerance -
+            lower_bound) * I is added to Q once, so that the minimum eigenvalue
+            becomes at least psd_tolerance. Q is left as it is otherwise, in
+            particular when it is indefinite beyond psd_tolerance, so that a
+            nonconvex problem stays nonconvex. With the Exact method, a
+            positive definite Q is recognized by a sparse Cholesky
+            factorization unless an estimate is requested. If estimate is not
+            null, the estimate used is written to it.
+        */
+        void regularize_Q(T psd_tolerance = 0,
+                          EigenvalueEstimation method = EigenvalueEstimation::Exact,
+                          EigenvalueEstimate<T>* estimate = nullptr) {
+            if(method == EigenvalueEstimation::Exact && estimate == nullptr && is_Q_pd()) {
+                return;
+            }
+
+            EigenvalueEstimate<T> min_eig = estimate_Q_min_eigenvalue(method);
+            if(estimate != nullptr) {
+                *estimate = min_eig;
+            }
+
+            if(min_eig.lower_bound >= 0 || min_eig.lower_bound < -psd_tolerance) {
+                return;
+            }
+            T shift = psd_tolerance - min_eig.lower_bound;
+
+            for(Index i = 0; i < num_vars(); i++) {
+                Q_triplets.emplace_back(i, i, shift);
+            }
+            Q_dirty = true;
+            versions.Q = new_version_stamp();
+        }
+
+        /*
+            Estimates the minimum eigenvalue of Q with the given method.
+            The Exact method computes a dense eigenvalue decomposition of Q,
+            Lanczos and Gershgorin work on the sparse upper triangle directly.
+        */
+        EigenvalueEstimate<T> estimate_Q_min_eigenvalue(
+                EigenvalueEstimation method = EigenvalueEstimation::Exact) const {
+            EigenvalueEstimate<T> estimate;
+            if(method == EigenvalueEstimation::Lanczos) {
+                estimate = lanczos_min_eigenvalue(Q());
+            } else if(method == EigenvalueEstimation::Gershgorin) {
+                estimate.value = estimate.lower_bound = gershgorin_lower_bound(Q());
+            } else {
+                Matrix Q_dense = Matrix(Q()).template selfadjointView<Eigen::Upper>();
+                Eigen::SelfAdjointEigenSolver<Matrix> eigen_solver(Q_dense, Eigen::EigenvaluesOnly);
+                estimate.value = estimate.lower_bound = num_vars() == 0
+                                 ? std::numeric_limits<T>::max()
+                                 : eigen_solver.eigenvalues().minCoeff();
+                estimate.iterations = num_vars();
+            }
+            return estimate;
+        }
+
+        /*
+            Adds given vector to c of the problem.
+        */
+        void add_c(const Vector& c) {
+            if(c.rows() != c_mtr.rows()) {
+                throw std::domain_error(
+                            std::string("c of the problem has ")
+                            + std::to_string(c_mtr.rows())
+                            + std::string(" columns, but the provided c has")
+                            + std::to_string(c.rows())
+                            + std::string(" rows.")
+                            );
+            }
+            c_mtr += c;
+            versions.c = new_version_stamp();
+        }
+
+        /*
+        * Adds given vector to the block of c of the problem where
+        * block starts from row i and spans c.rows() rows
+        */
+        void add_c_block(Index i, const Vector& c) {
+            if(i + c.rows() > c_mtr.rows()) {
+                throw std::domain_error(
+                    std::string("given c block is out of bounds of the original c")
+                );
+            }
+
+            c_mtr.block(i, 0, c.rows(), 1) += c;
+            versions.c = new_version_stamp();
+        }
+
+        /*
+            Upper triangle of Q in compressed sparse column format.
+        */
+        const SparseMatrix& Q() const {
+            compress_Q();
+            return Q_mtr;
+        }
+
+        const Vector& c() const {
+            return c_mtr;
+        }
+
+        /*
+            A in compressed sparse column format.
+        */
+        const SparseMatrix& A() const {
+            compress_A();
+            return A_mtr;
+        }
+
+        VectorMap lb() const {
+            return VectorMap(lb_vec.data(), num_constraints());
+        }
+
+        VectorMap ub() const {
+            return VectorMap(ub_vec.data(), num_constraints());
+        }
+
+        const Vector& lbx() const {
+            return lbx_mtr;
+        }
+
+        const Vector& ubx() const {
+            return ubx_mtr;
+        }
+
+        /*
+            Cast problem into type S. Infinite limits stay infinite.
+        */
+        template<class S>
+        SparseProblem<S> cast() const {
+            SparseProblem<S> new_problem(num_vars());
+            new_problem.Q_mtr = Q().template cast<S>();
+            new_problem.A_mtr = A().template cast<S>();
+            new_problem.c_mtr = c_mtr.template cast<S>();
+            new_problem.lb_vec.resize(lb_vec.size());
+            new_problem.ub_vec.resize(ub_vec.size());
+            std::transform(lb_vec.begin(), lb_vec.end(), new_problem.lb_vec.begin(),
+                           problem_detail::cast_limit<S, T>);
+            std::transform(ub_vec.begin(), ub_vec.end(), new_problem.ub_vec.begin(),
+                           problem_detail::cast_limit<S, T>);
+            new_problem.lbx_mtr = problem_detail::cast_limits<S>(lbx_mtr);
+            new_problem.ubx_mtr = problem_detail::cast_limits<S>(ubx_mtr);
+            new_problem.soft_convertible = soft_convertible;
+            new_problem.soft_weights_vec.assign(soft_weights_vec.begin(),
+                                                soft_weights_vec.end());
+
+            return new_problem;
+        }
+
+        /*
+            Simply check if constraints are consistent.
+            Basically checks if any lower bound is more than any upper bound.
+        */
+        bool is_consistent() const {
+            for(Index i = 0; i < num_vars(); i++) {
+                if(ubx_mtr(i) < lbx_mtr(i)) {
+                    return false;
+                }
+            }
+
+            for(Index i = 0; i < num_constraints(); i++) {
+                if(ub_vec[i] < lb_vec[i]) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        /*
+            Verifies that solution is consistent with the constraints,
+            that is it doesn't violate any constraint under the given tolarance.
+            Violation by tolerance amount is accepted
+        */
+        bool verify(const Vector& solution, T tolerance = 0) const {
+            check_solution_size(solution.rows());
+
+            Vector constraint_mtr = A() * solution;
+
+            for(Index i = 0; i < num_constraints(); i++) {
+                if(lb_vec[i] - tolerance > constraint_mtr(i)) {
+                    return false;
+                }
+
+                if(constraint_mtr(i) > ub_vec[i] + tolerance) {
+                    return false;
+                }
+            }
+
+            for(Index i = 0; i < num_vars(); i++) {
+                if(lbx_mtr(i) - tolerance > solution(i)) {
+                    return false;
+                }
+
+                if(solution(i) > ubx_mtr(i) + tolerance) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        /*
+            Returns 1/2 solution^T Q solution + c^T solution.
+        */
+        T objective(const Vector& solution) const {
+            check_solution_size(solution.rows());
+
+            Vector Q_solution = Q().template selfadjointView<Eigen::Upper>() * solution;
+            return solution.dot(Q_solution) / 2 + c_mtr.dot(solution);
+        }
+
+        template<typename S>
+        friend class SparseProblem;
+        template<typename ProblemType>
+        friend class SoftConversion;
+        template<typename ProblemType>
+        friend class Scaling;
+        template<typename ProblemType, typename Low>
+        friend class MixedPrecision;
+        template<typename ProblemType>
+        friend class ParametricProblem;
+        template<typename ProblemType>
+        friend class ProblemBuilder;
+        template<typename S>
+        friend std::ostream& operator<<(std::ostream& os, const SparseProblem<S>& problem);
+        template<typename S>
+        friend std::istream& operator>>(std::istream& is, SparseProblem<S>& problem);
+
+    private:
+        // Q_mtr holds the upper triangle of Q, A_mtr holds A. Entries added
+        // since the last read are kept in the triplet lists until then.
+        mutable SparseMatrix Q_mtr, A_mtr;
+        mutable std::vector<Triplet> Q_triplets, A_triplets;
+        mutable bool Q_dirty, A_dirty;
+
+        Vector c_mtr, lbx_mtr, ubx_mtr;
+        std::vector<T> lb_vec, ub_vec;
+
+        // versions holds the stamp of the last modification of each part,
+        // and is mutable since adding pending entries may change the
+        // structure. Q_class_cache holds the definiteness results computed
+        // for Q when the version of Q was equal to its version.
+        mutable ProblemVersion versions = ProblemVersion::fresh();
+
+        struct QClassCache {
+            std::size_t version = 0;
+            bool pd_known = false, is_pd = false;
+            bool psd_known = false, is_psd = false;
+            T psd_tolerance = 0;
+        };
+        mutable QClassCache Q_class_cache;
+
+        // soft_convertible[i] is  true if and only if i^th constraint
+        // must be converted to a soft constraint when convert_to_soft
+        // is called. soft_weights_vec[i] has the weight of the conversion.
+        std::vector<T> soft_weights_vec; // must have size num_constraints
+        std::vector<bool> soft_convertible; // must have size num_constraints
+
+        void compress_Q() const {
+            if(!Q_dirty) {
+                return;
+            }
+
+            SparseMatrix addition(num_vars(), num_vars());
+            addition.setFromTriplets(Q_triplets.begin(), Q_triplets.end());
+            Index previous_nonzeros = Q_mtr.nonZeros();
+            Q_mtr += addition;
+            Q_mtr.makeCompressed();
+            // the pattern of a sum is the union of the patterns
+            if(Q_mtr.nonZeros() != previous_nonzeros) {
+                versions.structure = new_version_stamp();
+            }
+            Q_triplets.clear();
+            Q_dirty = false;
+        }
+
+        void compress_A() const {
+            if(!A_dirty) {
+                return;
+            }
+
+            SparseMatrix addition(num_constraints(), num_vars());
+            addition.setFromTriplets(A_triplets.begin(), A_triplets.end());
+            Index previous_nonzeros = A_mtr.nonZeros();
+            A_mtr.conservativeResize(num_constraints(), num_vars());
+            A_mtr += addition;
+            A_mtr.makeCompressed();
+            if(A_mtr.nonZeros() != previous_nonzeros) {
+                versions.structure = new_version_stamp();
+            }
+            A_triplets.clear();
+            A_dirty = false;
+        }
+
+        /*
+            Returns if Q + shift * I is positive definite according to
+            a sparse Cholesky factorization.
+        */
+        bool is_shifted_Q_pd(T shift) const {
+            SparseMatrix identity(num_vars(), num_vars());
+            identity.setIdentity();
+            SparseMatrix shifted = Q() + shift * identity;
+
+            Eigen::SimplicialLLT<SparseMatrix, Eigen::Upper> llt(shifted);
+            return llt.info() == Eigen::Success;
+        }
+
+        /*
+            Cholesky factorization cannot succeed on a singular PSD matrix,
+            so the PSD check shifts Q by a rounding error sized amount.
+        */
+        T psd_shift_epsilon() const {
+            T max_abs = 0;
+            const SparseMatrix& Q_upper = Q();
+            for(Index k = 0; k < Q_upper.outerSize(); k++) {
+                for(typename SparseMatrix::InnerIterator it(Q_upper, k); it; ++it) {
+                    max_abs = std::max(max_abs, std::abs(it.value()));
+                }
+            }
+            return std::max(max_abs, T(1)) * num_vars()
+                   * std::numeric_limits<T>::epsilon();
+        }
+
+        Index append_row(T low, T up, bool is_soft_convertible, T soft_weight) {
+            lb_vec.push_back(low);
+            ub_vec.push_back(up);
+            soft_weights_vec.push_back(soft_weight);
+            soft_convertible.push_back(is_soft_convertible);
+            A_dirty = true;
+            versions.structure = versions.A = versions.limits = new_version_stamp();
+            return num_constraints() - 1;
+        }
+
+        void append_rows(const Vector& low, const Vector& up,
+                         bool is_soft_convertible, T soft_weight) {
+            lb_vec.insert(lb_vec.end(), low.data(), low.data() + low.rows());
+            ub_vec.insert(ub_vec.end(), up.data(), up.data() + up.rows());
+            soft_weights_vec.insert(soft_weights_vec.end(), low.rows(), soft_weight);
+            soft_convertible.insert(soft_convertible.end(), low.rows(), is_soft_convertible);
+            A_dirty = true;
+            versions.structure = versions.A = versions.limits = new_version_stamp();
+        }
+
+        void set_row_limits(Index constraint_idx, T low, T up,
+                            bool is_soft_convertible, T soft_weight) {
+            lb_vec[constraint_idx] = low;
+            ub_vec[constraint_idx] = up;
+            soft_convertible[constraint_idx] = is_soft_convertible;
+            soft_weights_vec[constraint_idx] = soft_weight;
+            versions.A = versions.limits = new_version_stamp();
+        }
+
+        void add_row_entries(Index constraint_idx, const RowVector& coeff) {
+            for(Index j = 0; j < coeff.cols(); j++) {
+                if(coeff(j) != T(0)) {
+                    A_triplets.emplace_back(constraint_idx, j, coeff(j));
+                }
+            }
+            A_dirty = true;
+        }
+
+        void add_row_entries(Index constraint_idx, const SparseRowVector& coeff) {
+            for(typename SparseRowVector::InnerIterator it(coeff); it; ++it) {
+                A_triplets.emplace_back(constraint_idx, it.index(), it.value());
+            }
+            A_dirty = true;
+        }
+
+        /*
+            Zeros the entries of a row, keeping them in the sparsity pattern
+            so that setting a row with the same pattern keeps the structure.
+        */
+        void clear_row(Index constraint_idx) {
+            compress_A();
+            for(Index j = 0; j < A_mtr.outerSize(); j++) {
+                for(typename SparseMatrix::InnerIterator it(A_mtr, j); it; ++it) {
+                    if(it.row() == constraint_idx) {
+                        it.valueRef() = T(0);
+                    }
+                }
+            }
+        }
+
+        void check_row_size(Index cols) const {
+            if(cols != num_vars()) {
+                throw std::domain_error(
+                    std::string("Problem has ")
+                    + std::to_string(num_vars())
+                    + std::string(" variables, but the provided row vector for constraint has ")
+                    + std::to_string(cols)
+                    + std::string(" columns.")
+                );
+            }
+        }
+
+        void check_block_size(Index rows, Index cols, Index low_rows, Index up_rows) const {
+            if(cols != num_vars()) {
+                throw std::domain_error (
+                    std::string("Problem has ")
+                    + std::to_string(num_vars())
+                    + std::string(" variables, but the provided matrix for constraints has ")
+                    + std::to_string(cols)
+                    + std::string(" columns.")
+                );
+            }
+
+            if(low_rows != rows || up_rows != rows) {
+                throw std::domain_error (
+                    std::string("provided matrix for constraints has ")
+                    + std::to_string(rows)
+                    + std::string(" rows, but provided lower and upper bounds have ")
+                    + std::to_string(low_rows)
+                    + std::string(" and ")
+                    + std::to_string(up_rows)
+                    + std::string(" rows.")
+                );
+            }
+        }
+
+        void check_constraint_index(Index constraint_idx) const {
+            if(constraint_idx >= num_constraints()) {
+                throw std::domain_error(
+                    std::string("constraint index out of range. ")
+                    + std::string("constraint_idx: ")
+                    + std::to_string(constraint_idx)
+                    + std::string(", num constraints: ")
+                    + std::to_string(num_constraints())
+                );
+            }
+        }
+
+        void check_var_index(Index var_idx) const {
+            if(var_idx >= num_vars()) {
+                throw std::domain_error(
+                    std::string("Problem has ")
+                    + std::to_string(num_vars())
+                    + std::string(" variables, but variable with index ")
+                    + std::to_string(var_idx)
+                    + std::string(" is used.")
+                );
+            }
+        }
+
+        void check_solution_size(Index rows) const {
+            if(rows != num_vars()) {
+                throw std::domain_error(
+                    std::string("Problem has ")
+                    + std::to_string(num_vars())
+                    + std::string(" variables, but given solution has ")
+                    + std::to_string(rows)
+                    + std::string(" rows.")
+                );
+            }
+        }
+};
+
+/*
+    Writes the problem in the same text format as Problem, so that
+    the two can read each other's output.
+*/
+template<typename T>
+std::ostream& operator<<(std::ostream& os, const SparseProblem<T>& problem) {
+    using Index = typename SparseProblem<T>::Index;
+    auto before_precision = os.precision();
+
+    os.precision(std::numeric_limits<T>::max_digits10);
+
+    Index n = problem.num_vars(), m = problem.num_constraints();
+    os << std::fixed << n << " " << m << std::endl;
+
+    typename SparseProblem<T>::Matrix row(1, n);
+    typename SparseProblem<T>::SparseMatrix Q_full
+        = problem.Q().template selfadjointView<Eigen::Upper>();
+    Eigen::SparseMatrix<T, Eigen::RowMajor> Q_rows = Q_full;
+    Eigen::SparseMatrix<T, Eigen::RowMajor> A_rows = problem.A();
+
+    for(Index i = 0; i < n; i++) {
+        row = Q_rows.row(i);
+        for(Index j = 0; j < n; j++) {
+            os << row(0, j) << " ";
+        }
+        os << std::endl;
+    }
+
+    for(Index i = 0; i < m; i++) {
+        row = A_rows.row(i);
+        for(Index j = 0; j < n; j++) {
+            os << row(0, j) << " ";
+        }
+        os << std::endl;
+    }
+
+    for(Index i = 0; i < m; i++) {
+        os << problem.lb_vec[i] << " ";
+    }
+    os << std::endl;
+
+
+    for(Index i = 0; i < m; i++) {
+        os << problem.ub_vec[i] << " ";
+    }
+
+    os << std::endl;
+
+    for(Index i = 0; i < n; i++) {
+        os << problem.lbx_mtr(i) << " ";
+    }
+    os << std::endl;
+
+
+    for(Index i = 0; i < n; i++) {
+        os << problem.ubx_mtr(i) << " ";
+    }
+    os << std::endl;
+
+    for(Index i = 0; i < n; i++) {
+        os << problem.c_mtr(i) << " ";
+    }
+    os << std::endl;
+
+    for(Index i = 0; i < m; i++) {
+        os << problem.soft_weights_vec[i] << " ";
+    }
+    os << std::endl;
+
+    for(Index i = 0; i < m; i++) {
+        os << problem.soft_convertible[i] << " ";
+    }
+    os << std::endl;
+
+    os.precision(before_precision);
+
+    return os;
+}
+
+/*
+    Reads a problem written in the text format of Problem. Zero entries
+    of Q and A are dropped while reading.
+*/
+template<typename T>
+std::istream& operator>>(std::istream& is, SparseProblem<T>& problem) {
+    using Index = typename SparseProblem<T>::Index;
+    Index n, m;
+    is >> n >> m;
+
+    problem = SparseProblem<T>(n);
+
+    T value;
+    for(Index i = 0; i < n; i++) {
+        for(Index j = 0; j < n; j++) {
+            is >> value;
+            if(value != T(0)) {
+                problem.add_Q_entry(i, j, value);
+            }
+        }
+    }
+
+    problem.lb_vec.resize(m);
+    problem.ub_vec.resize(m);
+    problem.soft_weights_vec.resize(m);
+    problem.soft_convertible.resize(m);
+
+    for(Index i = 0; i < m; i++) {
+        for(Index j = 0; j < n; j++) {
+            is >> value;
+            if(value != T(0)) {
+                problem.A_triplets.emplace_back(i, j, value);
+            }
+        }
+    }
+    problem.A_dirty = true;
+
+    for(Index i = 0; i < m; i++) {
+        is >> problem.lb_vec[i];
+    }
+
+
+    for(Index i = 0; i < m; i++) {
+        is >> problem.ub_vec[i];
+    }
+
+
+    for(Index i = 0; i < n; i++) {
+        is >> problem.lbx_mtr(i);
+    }
+
+
+    for(Index i = 0; i < n; i++) {
+        is >> problem.ubx_mtr(i);
+    }
+
+    for(Index i = 0; i < n; i++) {
+        is >> problem.c_mtr(i);
+    }
+
+    for(Index i = 0; i < m; i++) {
+        is >> problem.soft_weights_vec[i];
+    }
+
+    for(Index i = 0; i < m; i++) {
+        bool a;
+        is >> a;
+        problem.soft_convertible[i] = a;
+    }
+
+
+    return is;
+}
+
+}
+
+
+#endif
@@ -2,6 +2,10 @@
 #define QPWRAPPERS_TYPES_HPP
 
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 
 namespace QPWrappers {
 
@@ -12,12 +16,181 @@ enum class OptReturnType {
     Infeasible,
     Error,
     Unknown,
-    InfeasibleOrUnbounded
+    InfeasibleOrUnbounded,
+    TimeLimit
 };
 
+/*
+    Statistics of the last solve of an engine. setup_time is the time spent
+    building the problem data of the underlying solver, solve_time is the
+    time spent in its optimization call, both in seconds. iterations is the
+    iteration count the solver reports, which is the number of working set
+    recalculations for active set solvers.
+    overrun is the time by which the call exceeded the time budget of the
+    engine, in seconds, and 0 without a budget.
+*/
+struct SolveStatistics {
+    double setup_time = 0;
+    double solve_time = 0;
+    long long iterations = 0;
+    double overrun = 0;
+};
+
+using SolveClock = std::chrono::steady_clock;
+
+inline double seconds_since(SolveClock::time_point start) {
+    return std::chrono::duration<double>(SolveClock::now() - start).count();
 }
 
-std::ostream& operator<<(std::ostream& os,
+/*
+    Time budget of the solves of an engine in seconds. A budget of 0 or
+    less means no budget. Engines stop a solve that runs out of its budget
+    and return OptReturnType::TimeLimit with the best iterate found so far,
+    or OptReturnType::Unknown if they found none.
+*/
+class TimeBudget {
+    public:
+        void set(double seconds) {
+            budget = seconds > 0 ? seconds : 0;
+        }
+
+        bool active() const {
+            return budget > 0;
+        }
+
+        double seconds() const {
+            return budget;
+        }
+
+        /*
+            Budget left after elapsed seconds, which is at least a small
+            positive amount so that it can be given to solvers that treat 0
+            as no limit.
+        */
+        double remaining(double elapsed) const {
+            return std::max(budget - elapsed, 1e-6);
+        }
+
+        /*
+            Sets the overrun of statistics of a call started at start.
+        */
+        void record(SolveStatistics& statistics, SolveClock::time_point start) const {
+            if(active()) {
+                statistics.overrun = std::max(seconds_since(start) - budget, 0.0);
+            }
+        }
+
+    private:
+        double budget = 0;
+};
+
+/*
+    Returns a stamp that no earlier call returned.
+*/
+inline std::size_t new_version_stamp() {
+    static std::atomic<std::size_t> last_stamp(0);
+    return ++last_stamp;
+}
+
+/*
+    Version of each part of a problem, which is the stamp taken when the
+    part was last modified. Stamps are unique across problems, so a part is
+    unchanged since a version was read if and only if its stamp is the
+    same, even when the version was read from another problem. Copies of a
+    problem have the versions of the original.
+    structure changes with the number of variables or constraints and with
+    the sparsity pattern of Q or A, limits are lb and ub, and var_limits
+    are lbx and ubx. Soft constraint settings are not tracked.
+*/
+struct ProblemVersion {
+    std::size_t structure, Q, A, c, limits, var_limits;
+
+    static ProblemVersion fresh() {
+        std::size_t stamp = new_version_stamp();
+        return ProblemVersion{stamp, stamp, stamp, stamp, stamp, stamp};
+    }
+};
+
+/*
+    Parts of a problem that changed between two of its versions, used by
+    engines to choose between updating vectors, refactorizing matrices
+    with the same sparsity pattern and setting up from scratch.
+*/
+struct ProblemChanges {
+    bool structure = true, Q = true, A = true, c = true, limits = true, var_limits = true;
+
+    // everything changed
+    ProblemChanges() = default;
+
+    ProblemChanges(const ProblemVersion& before, const ProblemVersion& after):
+            structure(before.structure != after.structure),
+            Q(before.Q != after.Q),
+            A(before.A != after.A),
+            c(before.c != after.c),
+            limits(before.limits != after.limits),
+            var_limits(before.var_limits != after.var_limits) {}
+
+    static ProblemChanges none() {
+        ProblemChanges changes;
+        changes.structure = changes.Q = changes.A = false;
+        changes.c = changes.limits = changes.var_limits = false;
+        return changes;
+    }
+
+    bool any() const {
+        return structure || Q || A || c || limits || var_limits;
+    }
+
+    /*
+        True if at most c and the limits changed.
+    */
+    bool only_vectors() const {
+        return !structure && !Q && !A;
+    }
+};
+
+/*
+    Versions of a problem derived from another one, e.g. a scaled or cast
+    copy, such that a part of the derived problem keeps its stamp as long
+    as the part of the source problem it comes from does.
+*/
+class DerivedVersion {
+    public:
+        /*
+            Returns the versions of the derived problem given the versions
+            of its source. Parts set in changed are taken as changed even if
+            they did not change in the source.
+        */
+        const ProblemVersion& derive(const ProblemVersion& source,
+                                     const ProblemChanges& changed = ProblemChanges::none()) {
+            ProblemChanges source_changes = has_last ? ProblemChanges(last_source, source)
+                                                     : ProblemChanges();
+            std::size_t stamp = new_version_stamp();
+            auto update = [stamp](std::size_t& part, bool source_changed, bool part_changed) {
+                if(source_changed || part_changed) {
+                    part = stamp;
+                }
+            };
+            update(last_derived.structure, source_changes.structure, changed.structure);
+            update(last_derived.Q, source_changes.Q, changed.Q);
+            update(last_derived.A, source_changes.A, changed.A);
+            update(last_derived.c, source_changes.c, changed.c);
+            update(last_derived.limits, source_changes.limits, changed.limits);
+            update(last_derived.var_limits, source_changes.var_limits, changed.var_limits);
+
+            last_source = source;
+            has_last = true;
+            return last_derived;
+        }
+
+    private:
+        bool has_last = false;
+        ProblemVersion last_source{}, last_derived{};
+};
+
+}
+
+inline std::ostream& operator<<(std::ostream& os,
         QPWrappers::OptReturnType ret_type) {
     using namespace QPWrappers;
     switch(ret_type) {
@@ -42,6 +215,9 @@ std::ostream& operator<<(std::ostream& os,
         case OptReturnType::InfeasibleOrUnbounded:
             os << "InfeasibleOrUnbounded";
             break;
+        case OptReturnType::TimeLimit:
+            os << "TimeLimit";
+            break;
     }
 
     return os;